@@ -0,0 +1,288 @@
+// Execution benchmark of the tree and the flat representations of a program.
+// Usage: mython_ast_bench [number of statements in thousands]
+// A generated program executes every statement once, so the run time is dominated by walking
+// the nodes rather than by any hot loop. Build in Release mode to get meaningful numbers
+
+#include "flat_ast.h"
+#include "lexer.h"
+#include "optimizer.h"
+#include "parse.h"
+#include "program_cache.h"
+#include "statement.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+
+using namespace std;
+
+namespace {
+
+const int RUNS = 5;
+
+// Every statement uses its own constants and one of a thousand variables, method calls
+// update a field of an object
+string MakeProgram(size_t statement_count) {
+	ostringstream program;
+	program << "class Counter:\n"
+			"  def __init__():\n"
+			"    self.total = 0\n"
+			"\n"
+			"  def add(n):\n"
+			"    self.total = self.total + n\n"
+			"\n"
+			"c = Counter()\n";
+	for (size_t i = 0; i < statement_count; ++i) {
+		const size_t var = i % 1000;
+		program << "v" << var << " = " << i % 1000 << " * 3 + " << var << " - " << i % 97
+				<< " / 7\n";
+		program << "if v" << var << " > " << i % 1500 << " and not v" << var << " == 0:\n"
+				<< "  c.add(v" << var << ")\n"
+				<< "else:\n"
+				<< "  c.add(1)\n";
+	}
+	program << "print c.total\n";
+	return program.str();
+}
+
+// A library of classes with many methods, the program calls a method of one class
+string MakeLibrary(size_t class_count) {
+	ostringstream program;
+	for (size_t i = 0; i < class_count; ++i) {
+		program << "class Lib" << i << ":\n";
+		for (size_t j = 0; j < 10; ++j) {
+			program << "  def m" << j << "(a, b):\n"
+					"    x = a * " << j << " + b\n"
+					"    if x > " << i << " and not x == b:\n"
+					"      return x - a / 2\n"
+					"    return 'value ' + str(x)\n"
+					"\n";
+		}
+	}
+	program << "l = Lib0()\nprint l.m1(2, 3)\n";
+	return program.str();
+}
+
+// Long expressions of every precedence level with parentheses and calls, parsing them is
+// dominated by the expression parser
+string MakeExpressions(size_t statement_count) {
+	ostringstream program;
+	program << "class Point:\n"
+			"  def __init__(x, y):\n"
+			"    self.x = x\n"
+			"    self.y = y\n"
+			"\n"
+			"  def dot(other):\n"
+			"    return self.x * other.x + self.y * other.y\n"
+			"\n"
+			"p = Point(1, 2)\n";
+	for (size_t i = 0; i < statement_count; ++i) {
+		const size_t var = i % 100;
+		program << "e" << var << " = (" << i % 10 << " + p.x * (" << i % 7 << " - -p.y)) / (1 + "
+				<< i % 5 << " * 2) - p.dot(Point(" << i % 3 << ", p.x + 1))\n";
+		program << "b" << var << " = not e" << var << " < " << i % 11 << " or e" << var
+				<< " + 1 >= (p.y - 3) * 4 and not (p.x == " << i % 2 << " or e" << var << " != 0)\n";
+	}
+	program << "print p.dot(p)\n";
+	return program.str();
+}
+
+// Recursive method calls with parameters and locals, the time goes to calls and variables
+const string RECURSIVE_PROGRAM = R"(
+class Fib:
+  def calc(n):
+    if n < 2:
+      return n
+    a = n - 1
+    b = n - 2
+    first = self.calc(a)
+    second = self.calc(b)
+    result = first + second + a - a + b - b
+    return result
+
+f = Fib()
+print f.calc(22)
+)";
+
+// Returns the best time of several runs in seconds
+double BestTime(const function<void()> &run) {
+	double best = numeric_limits<double>::max();
+	for (int i = 0; i < RUNS; ++i) {
+		const auto start = chrono::steady_clock::now();
+		run();
+		best = min(best, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+	}
+	return best;
+}
+
+string Execute(ast::Statement &program) {
+	runtime::DummyContext context;
+	runtime::Closure closure;
+	program.Execute(closure, context);
+	return context.output.str();
+}
+
+unique_ptr<ast::Program> Parse(const string &source, ParseOptions options = {}) {
+	istringstream input(source);
+	parse::Lexer lexer(input);
+	return ParseProgram(lexer, options);
+}
+
+// Parses the source in memory as a script is parsed, lexing it by the threads of the parser
+unique_ptr<ast::Program> ParseSource(string_view source, ParseOptions options) {
+	parse::Lexer lexer(source, options.threads);
+	return ParseProgram(lexer, options);
+}
+
+void Report(string_view name, double seconds, size_t count, string_view unit = "statement"sv) {
+	cout << setw(16) << left << name << fixed << setprecision(1) << setw(10) << right
+			<< seconds * 1e3 << " ms" << setw(12) << seconds / count * 1e9
+			<< " ns/" << unit << endl;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+	const size_t thousands = argc > 1 ? static_cast<size_t>(atoi(argv[1])) : 200;
+	const size_t statement_count = thousands * 1000;
+	const string source = MakeProgram(statement_count);
+	cout << "Program: " << statement_count << " statements, "
+			<< source.size() / double(1 << 20) << " MB" << endl;
+
+	auto start = chrono::steady_clock::now();
+	auto tree = Parse(source);
+	Report("Parse"sv, chrono::duration<double>(chrono::steady_clock::now() - start).count(),
+			statement_count);
+
+	start = chrono::steady_clock::now();
+	ast::FlatProgram flat(*tree);
+	Report("Flatten"sv, chrono::duration<double>(chrono::steady_clock::now() - start).count(),
+			statement_count);
+
+	const ast::Arena::Stats &stats = tree->GetArena().GetStats();
+	cout << "Tree: " << stats.object_count << " nodes, " << stats.bytes_used << " bytes; flat: "
+			<< flat.GetNodes().size() << " nodes, "
+			<< flat.GetNodes().size() * sizeof(ast::FlatProgram::Node) << " bytes" << endl;
+
+	string tree_output;
+	string flat_output;
+	Report("Tree execute"sv, BestTime([&] {
+		tree_output = Execute(*tree);
+	}), statement_count);
+	Report("Flat execute"sv, BestTime([&] {
+		flat_output = Execute(flat);
+	}), statement_count);
+	if (tree_output != flat_output) {
+		cerr << "Outputs differ: " << tree_output << " and " << flat_output << endl;
+		return 1;
+	}
+
+	start = chrono::steady_clock::now();
+	const ast::OptimizationStats optimization = ast::Optimize(*tree);
+	Report("Optimize"sv, chrono::duration<double>(chrono::steady_clock::now() - start).count(),
+			statement_count);
+	cout << "Folded " << optimization.folded_constants << " constants, resolved "
+			<< optimization.resolved_conditions << " conditions" << endl;
+
+	ast::FlatProgram optimized_flat(*tree);
+	string optimized_output;
+	Report("Optimized tree"sv, BestTime([&] {
+		optimized_output = Execute(*tree);
+	}), statement_count);
+	Report("Optimized flat"sv, BestTime([&] {
+		flat_output = Execute(optimized_flat);
+	}), statement_count);
+	if (optimized_output != tree_output || flat_output != tree_output) {
+		cerr << "Optimized outputs differ: " << optimized_output << " and " << flat_output << endl;
+		return 1;
+	}
+
+	// Loading the cached program replaces lexing, parsing, optimizing and flattening
+	const uint64_t source_hash = ast::HashSource(source);
+	ostringstream cache;
+	start = chrono::steady_clock::now();
+	ast::SaveProgram(optimized_flat, source_hash, cache);
+	Report("Save cache"sv, chrono::duration<double>(chrono::steady_clock::now() - start).count(),
+			statement_count);
+	const string cache_data = cache.str();
+	unique_ptr<ast::FlatProgram> loaded;
+	Report("Load cache"sv, BestTime([&] {
+		loaded = ast::LoadProgram(cache_data, source_hash);
+	}), statement_count);
+	cout << "Cache: " << cache_data.size() / double(1 << 20) << " MB" << endl;
+	if (Execute(*loaded) != tree_output) {
+		cerr << "Cached program output differs" << endl;
+		return 1;
+	}
+
+	// Lazy parsing of method bodies, only the called one is parsed, and parallel parsing of all
+	// of them
+	const string library = MakeLibrary(thousands * 10);
+	const size_t method_count = thousands * 100;
+	ParseOptions lazy;
+	lazy.lazy_methods = true;
+	ParseOptions parallel;
+	parallel.threads = max(thread::hardware_concurrency(), 1U);
+	cout << "Library: " << thousands * 10 << " classes, parallel parsing by " << parallel.threads
+			<< " threads" << endl;
+	for (const auto &[name, options] : { pair { "Library eager"sv, ParseOptions { } },
+			pair { "Library lazy"sv, lazy }, pair { "Library parallel"sv, parallel } }) {
+		unique_ptr<ast::Program> program;
+		Report(name, BestTime([&] {
+			program = ParseSource(library, options);
+			tree_output = Execute(*program);
+		}), method_count, "method"sv);
+		cout << "  arena: " << program->GetArena().GetStats().bytes_used << " bytes" << endl;
+		if (tree_output != "4\n"s) {
+			cerr << "Wrong library output: " << tree_output << endl;
+			return 1;
+		}
+	}
+
+	const string expressions = MakeExpressions(statement_count);
+	unique_ptr<ast::Program> parsed;
+	Report("Parse exprs"sv, BestTime([&] {
+		parsed = Parse(expressions);
+	}), statement_count);
+	cout << "  " << expressions.size() / double(1 << 20) << " MB, "
+			<< parsed->GetArena().GetStats().object_count << " nodes" << endl;
+	if (Execute(*parsed) != "5\n"s) {
+		cerr << "Wrong expressions output" << endl;
+		return 1;
+	}
+
+	// fib(22) makes 57313 calls
+	const size_t call_count = 57313;
+	auto recursive = Parse(RECURSIVE_PROGRAM);
+	ast::FlatProgram recursive_flat(*recursive);
+	Report("Calls tree"sv, BestTime([&] {
+		tree_output = Execute(*recursive);
+	}), call_count, "call"sv);
+	Report("Calls flat"sv, BestTime([&] {
+		flat_output = Execute(recursive_flat);
+	}), call_count, "call"sv);
+	if (tree_output != "17711\n"s || flat_output != tree_output) {
+		cerr << "Wrong fib(22): " << tree_output << " and " << flat_output << endl;
+		return 1;
+	}
+
+	// self.calc is bound to the method, calls skip the lookup by name
+	const size_t devirtualized = ast::Optimize(*recursive).devirtualized_calls;
+	Report("Calls bound"sv, BestTime([&] {
+		tree_output = Execute(*recursive);
+	}), call_count, "call"sv);
+	cout << "Devirtualized " << devirtualized << " calls" << endl;
+	if (tree_output != "17711\n"s) {
+		cerr << "Wrong bound fib(22): " << tree_output << endl;
+		return 1;
+	}
+	return 0;
+}
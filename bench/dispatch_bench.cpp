@@ -0,0 +1,215 @@
+// Benchmark of the built-in operations on values of mixed types: the dispatch on the type tags
+// of objects against the chains of dynamic_cast that the runtime used before.
+// Usage: mython_dispatch_bench [number of operations in millions]
+// Every workload is a random sequence of argument types, so the branches are not predicted by
+// the order of the data. The sequence is short enough to stay in the cache and is repeated.
+// Build in Release mode to get meaningful numbers
+
+#include "runtime.h"
+#include "statement.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+using runtime::ObjectHolder;
+
+namespace {
+
+const int RUNS = 5;
+// Pairs of arguments in a workload
+const size_t PAIR_COUNT = 4096;
+
+// The operations as they were implemented with ObjectHolder::TryAs over dynamic_cast
+namespace legacy {
+
+template <typename T>
+T* TryAs(const ObjectHolder &object) {
+	return dynamic_cast<T*>(object.Get());
+}
+
+bool IsTrue(const ObjectHolder &object) {
+	if (TryAs<runtime::String>(object) != nullptr) {
+		return !TryAs<runtime::String>(object)->GetValue().empty();
+	}
+	if (TryAs<runtime::Number>(object) != nullptr) {
+		return TryAs<runtime::Number>(object)->GetValue() != 0;
+	}
+	if (TryAs<runtime::Bool>(object) != nullptr) {
+		return TryAs<runtime::Bool>(object)->GetValue();
+	}
+	return false;
+}
+
+bool Equal(const ObjectHolder &lhs, const ObjectHolder &rhs) {
+	if (TryAs<runtime::String>(lhs) != nullptr && TryAs<runtime::String>(rhs) != nullptr) {
+		return TryAs<runtime::String>(lhs)->GetValue() == TryAs<runtime::String>(rhs)->GetValue();
+	}
+	if (TryAs<runtime::Number>(lhs) != nullptr && TryAs<runtime::Number>(rhs) != nullptr) {
+		return TryAs<runtime::Number>(lhs)->GetValue() == TryAs<runtime::Number>(rhs)->GetValue();
+	}
+	if (TryAs<runtime::Bool>(lhs) != nullptr && TryAs<runtime::Bool>(rhs) != nullptr) {
+		return TryAs<runtime::Bool>(lhs)->GetValue() == TryAs<runtime::Bool>(rhs)->GetValue();
+	}
+	if (TryAs<runtime::ClassInstance>(lhs) != nullptr
+			&& TryAs<runtime::ClassInstance>(rhs) != nullptr) {
+		throw runtime_error("Instances are not compared by the benchmark"s);
+	}
+	if (!lhs && !rhs) {
+		return true;
+	}
+	throw runtime_error("Cannot compare objects for equality"s);
+}
+
+bool Less(const ObjectHolder &lhs, const ObjectHolder &rhs) {
+	if (TryAs<runtime::String>(lhs) != nullptr && TryAs<runtime::String>(rhs) != nullptr) {
+		return TryAs<runtime::String>(lhs)->GetValue() < TryAs<runtime::String>(rhs)->GetValue();
+	}
+	if (TryAs<runtime::Number>(lhs) != nullptr && TryAs<runtime::Number>(rhs) != nullptr) {
+		return TryAs<runtime::Number>(lhs)->GetValue() < TryAs<runtime::Number>(rhs)->GetValue();
+	}
+	if (TryAs<runtime::Bool>(lhs) != nullptr && TryAs<runtime::Bool>(rhs) != nullptr) {
+		return TryAs<runtime::Bool>(lhs)->GetValue() < TryAs<runtime::Bool>(rhs)->GetValue();
+	}
+	throw runtime_error("Cannot compare objects for equality"s);
+}
+
+ObjectHolder Add(const ObjectHolder &lhs, const ObjectHolder &rhs) {
+	if (TryAs<runtime::String>(lhs) != nullptr && TryAs<runtime::String>(rhs) != nullptr) {
+		return ObjectHolder::Own(runtime::String(TryAs<runtime::String>(lhs)->GetValue()
+				+ TryAs<runtime::String>(rhs)->GetValue()));
+	}
+	if (TryAs<runtime::Number>(lhs) != nullptr && TryAs<runtime::Number>(rhs) != nullptr) {
+		return ObjectHolder::Own(runtime::Number(TryAs<runtime::Number>(lhs)->GetValue()
+				+ TryAs<runtime::Number>(rhs)->GetValue()));
+	}
+	throw runtime_error("Cannot compare objects for equality"s);
+}
+
+}  // namespace legacy
+
+// Returns the best time of several runs in seconds
+double BestTime(const function<void()> &run) {
+	double best = numeric_limits<double>::max();
+	for (int i = 0; i < RUNS; ++i) {
+		const auto start = chrono::steady_clock::now();
+		run();
+		best = min(best, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+	}
+	return best;
+}
+
+// Values of every type an operation accepts, the strings are short enough not to allocate
+struct Values {
+	runtime::Class cls { "Point"s, { }, nullptr };
+	ObjectHolder instance = ObjectHolder::Own(runtime::ClassInstance(cls));
+	vector<ObjectHolder> numbers { ObjectHolder::Own(runtime::Number(0)),
+			ObjectHolder::Own(runtime::Number(7)), ObjectHolder::Own(runtime::Number(-3)) };
+	vector<ObjectHolder> strings { ObjectHolder::Own(runtime::String(""s)),
+			ObjectHolder::Own(runtime::String("abc"s)), ObjectHolder::Own(runtime::String("b"s)) };
+	vector<ObjectHolder> bools { ObjectHolder::Own(runtime::Bool(false)),
+			ObjectHolder::Own(runtime::Bool(true)) };
+};
+
+using Pairs = vector<pair<ObjectHolder, ObjectHolder>>;
+
+// Pairs of values of the same type, the type of each pair is random
+Pairs MakePairs(const Values &values, size_t count, const vector<int> &types, mt19937 &random) {
+	Pairs result;
+	result.reserve(count);
+	for (size_t i = 0; i < count; ++i) {
+		const int type = types[random() % types.size()];
+		const vector<ObjectHolder> *pool = type == 0 ? &values.numbers
+				: type == 1 ? &values.strings : type == 2 ? &values.bools : nullptr;
+		if (pool == nullptr) {
+			result.emplace_back();
+		} else {
+			result.emplace_back((*pool)[random() % pool->size()],
+					(*pool)[random() % pool->size()]);
+		}
+	}
+	return result;
+}
+
+void Report(string_view name, double legacy, double tagged, size_t count) {
+	cout << setw(8) << left << name << fixed << setprecision(2) << setw(10) << right
+			<< legacy / count * 1e9 << " ns/op" << setw(10) << tagged / count * 1e9
+			<< " ns/op" << setw(8) << setprecision(1) << legacy / tagged << "x" << endl;
+}
+
+// Runs the operation repeat times over the pairs in both ways and checks that the results are
+// the same
+template <typename Legacy, typename Tagged>
+bool Compare(string_view name, const Pairs &pairs, size_t repeat, Legacy legacy_operation,
+		Tagged tagged_operation) {
+	size_t legacy_result = 0;
+	size_t tagged_result = 0;
+	const double legacy = BestTime([&] {
+		legacy_result = 0;
+		for (size_t i = 0; i < repeat; ++i) {
+			for (const auto &[lhs, rhs] : pairs) {
+				legacy_result += legacy_operation(lhs, rhs);
+			}
+		}
+	});
+	const double tagged = BestTime([&] {
+		tagged_result = 0;
+		for (size_t i = 0; i < repeat; ++i) {
+			for (const auto &[lhs, rhs] : pairs) {
+				tagged_result += tagged_operation(lhs, rhs);
+			}
+		}
+	});
+	Report(name, legacy, tagged, pairs.size() * repeat);
+	if (legacy_result != tagged_result) {
+		cerr << name << " results differ: " << legacy_result << " and " << tagged_result << endl;
+		return false;
+	}
+	return true;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+	const size_t millions = argc > 1 ? static_cast<size_t>(atoi(argv[1])) : 2;
+	const size_t repeat = max<size_t>(millions * 1000000 / PAIR_COUNT, 1);
+	Values values;
+	mt19937 random(42);
+	runtime::DummyContext context;
+
+	// IsTrue gets single values of all types, including None and an instance
+	Pairs singles = MakePairs(values, PAIR_COUNT, { 0, 1, 2, 3 }, random);
+	for (size_t i = 0; i < singles.size(); i += 5) {
+		singles[i].first = values.instance;
+	}
+	const Pairs equal_pairs = MakePairs(values, PAIR_COUNT, { 0, 1, 2, 3 }, random);
+	const Pairs less_pairs = MakePairs(values, PAIR_COUNT, { 0, 1, 2 }, random);
+	const Pairs add_pairs = MakePairs(values, PAIR_COUNT, { 0, 1 }, random);
+
+	cout << "Operation    dynamic_cast    type tag" << endl;
+	const bool same = Compare("IsTrue"sv, singles, repeat, [](const auto &lhs, const auto&) {
+		return legacy::IsTrue(lhs);
+	}, [](const auto &lhs, const auto&) {
+		return runtime::IsTrue(lhs);
+	}) && Compare("Equal"sv, equal_pairs, repeat, legacy::Equal, [&](const auto &lhs, const auto &rhs) {
+		return runtime::Equal(lhs, rhs, context);
+	}) && Compare("Less"sv, less_pairs, repeat, legacy::Less, [&](const auto &lhs, const auto &rhs) {
+		return runtime::Less(lhs, rhs, context);
+	}) && Compare("Add"sv, add_pairs, repeat, [](const auto &lhs, const auto &rhs) {
+		return runtime::IsTrue(legacy::Add(lhs, rhs));
+	}, [&](const auto &lhs, const auto &rhs) {
+		return runtime::IsTrue(ast::Add::Apply(lhs, rhs, context));
+	});
+	return same ? 0 : 1;
+}
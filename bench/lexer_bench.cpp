@@ -0,0 +1,440 @@
+// Throughput benchmark of parse::Lexer.
+// Usage: mython_lexer_bench [corpus size in megabytes]
+//        mython_lexer_bench --scaling [largest corpus size in megabytes]
+// The second form lexes synthetic corpora of growing sizes and fails if the lexing time of
+// any of them grows faster than linearly. Build in Release mode to get meaningful numbers
+
+#include "incremental_lexer.h"
+#include "lexer.h"
+#include "lexer_tables.h"
+#include "scanner.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <new>
+#include <optional>
+#include <set>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+using namespace std;
+
+// Heap allocations of the benchmark, counted by the replaced operator new
+atomic<size_t> allocation_count = 0;
+
+void* operator new(size_t size) {
+	allocation_count.fetch_add(1, memory_order_relaxed);
+	if (void *data = malloc(size == 0 ? 1 : size)) {
+		return data;
+	}
+	throw bad_alloc();
+}
+
+void operator delete(void *data) noexcept {
+	free(data);
+}
+
+void operator delete(void *data, size_t) noexcept {
+	free(data);
+}
+
+namespace {
+
+const string SAMPLE_PROGRAM = R"(
+class Shape:
+  def __str__():
+    return "Shape"
+
+  def area():
+    return 'Not implemented'
+
+class Rect(Shape):
+  def __init__(w, h):
+    self.w = w
+    self.h = h
+
+  def __str__():
+    return "Rect(" + str(self.w) + 'x' + str(self.h) + ')'
+
+  def area():
+    if self.w <= 0 or self.h <= 0:
+      return 0
+    return self.w * self.h
+
+# comments are skipped by the lexer
+r = Rect(10, 20)
+total = r.area() + 100500 - 42 / 7
+if total >= 1000 and not r.w == 0:
+  print r, total, True, False, None
+else:
+  print "small \"rect\"", total != 0
+)";
+
+// Long comments, deep indentation and long string literals are where the scanning kernels
+// replace the longest symbol by symbol loops
+const string COMMENT_HEAVY_PROGRAM = R"(
+# The lexer skips comments like this one entirely, so the only work left is to find the end of
+# the line. Real programs often have whole blocks of them explaining what the code below does
+class Counter:
+  def __init__():
+    # initial_value_of_the_counter_that_is_incremented_by_every_call_of_the_increment_method
+    self.value_of_the_counter_that_is_long_enough_to_fill_a_vector = 0
+            # a comment with a deep indentation is still skipped as a whole
+)";
+
+const string STRING_HEAVY_PROGRAM = R"(
+header = "A long string literal that is returned as a view of the source text by the lexer"
+footer = 'Another long literal, this time in single quotes and with an escape \n at the end'
+print header + " and " + footer + "!!! The quick brown fox jumps over the lazy dog again"
+)";
+
+// Non-ASCII symbols in strings, comments and ids, each line with them is checked to be UTF-8.
+// It is lexed with LexerOptions::utf8_ids
+const string UTF8_PROGRAM = R"(
+# Счётчик обращений: строки и комментарии на русском языке
+class Счётчик:
+  def увеличить(шаг):
+    self.значение = self.значение + шаг
+    return "Значение счётчика увеличено на " + str(шаг)
+)";
+
+string MakeCorpus(const string &sample, size_t size) {
+	string corpus;
+	corpus.reserve(size + sample.size());
+	while (corpus.size() < size) {
+		corpus += sample;
+	}
+	return corpus;
+}
+
+// Synthetic corpora stress one construct each. The construct grows with the size of
+// the corpus, so a lexer that is slow on big constructs shows in the scaling check
+
+// One block nested about sqrt(size) levels deep, each line starts one level deeper
+string MakeDeepIndentation(size_t size) {
+	string corpus;
+	size_t level = 0;
+	for (; corpus.size() < size; ++level) {
+		corpus += string(level * 2, ' ') + "if x"s + to_string(level) + ":\n"s;
+	}
+	// The body of the innermost if is one level deeper than the if itself
+	return corpus + string(level * 2, ' ') + "x = 1\n"s;
+}
+
+// A single string literal with an escape sequence every kilobyte
+string MakeLongString(size_t size) {
+	string corpus = "s = '"s;
+	while (corpus.size() < size) {
+		corpus += string(1000, 'a') + "\\n"s;
+	}
+	return corpus + "'\n"s;
+}
+
+// A single line of operators and operands, no two-symbol operator is left out
+string MakeOperatorLine(size_t size) {
+	string corpus = "x = a"s;
+	while (corpus.size() < size) {
+		corpus += "+b-c*d/e==f!=g<=h>=i<j>k and not l or(m)"s;
+	}
+	return corpus + "\n"s;
+}
+
+string MakeLongComment(size_t size) {
+	string corpus = "x = 1 # "s;
+	while (corpus.size() < size) {
+		corpus += "a long comment line "s;
+	}
+	return corpus + "\nprint x\n"s;
+}
+
+// Four distinct ids of an eighth of the size each
+string MakeHugeIds(size_t size) {
+	string corpus;
+	const string id(max<size_t>(size / 8, 1), 'i');
+	for (int i = 0; i < 4; ++i) {
+		corpus += id + to_string(i) + " = "s + id + to_string(i) + "\n"s;
+	}
+	return corpus;
+}
+
+struct SyntheticCorpus {
+	string_view name;
+	string (*make)(size_t size);
+};
+
+const SyntheticCorpus SYNTHETIC_CORPORA[] = {
+	{ "Deep indentation"sv, MakeDeepIndentation },
+	{ "Long string literal"sv, MakeLongString },
+	{ "Operator-dense line"sv, MakeOperatorLine },
+	{ "Long comment line"sv, MakeLongComment },
+	{ "Huge ids"sv, MakeHugeIds },
+};
+
+double SecondsSince(chrono::steady_clock::time_point start) {
+	return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+void Report(string_view name, size_t bytes, size_t tokens, double seconds,
+		optional<size_t> allocations = nullopt) {
+	cout << setw(28) << left << name << fixed << setprecision(1) << setw(10) << right
+			<< bytes / seconds / (1 << 20) << " MB/s";
+	if (tokens > 0) {
+		cout << setw(12) << tokens / seconds / 1e6 << " Mtokens/s";
+	}
+	if (allocations && tokens > 0) {
+		cout << setw(12) << setprecision(4) << double(*allocations) / tokens << " allocs/token";
+	}
+	cout << endl;
+}
+
+size_t CountTokens(parse::Lexer &lexer) {
+	size_t tokens = 1;
+	for (lexer.Advance(); !lexer.Is<parse::token_type::Eof>(); lexer.Advance()) {
+		++tokens;
+	}
+	return tokens;
+}
+
+void BenchScanKernels(string_view corpus_name, const string &corpus,
+		parse::LexerOptions options = {}) {
+	const parse::ScanIsa default_isa = parse::GetSelectedScanIsa();
+	const pair<parse::ScanIsa, string_view> isas[] = { { parse::ScanIsa::SCALAR, "scalar"sv }, {
+			parse::ScanIsa::SSE2, "SSE2"sv }, { parse::ScanIsa::AVX2, "AVX2"sv } };
+	for (const auto& [isa, isa_name] : isas) {
+		if (!parse::SelectScanKernels(isa)) {
+			continue;
+		}
+		const auto start = chrono::steady_clock::now();
+		parse::Lexer lexer(string_view { corpus }, options);
+		const size_t tokens = CountTokens(lexer);
+		Report(string(corpus_name) + ", "s + string(isa_name), corpus.size(), tokens,
+				SecondsSince(start));
+	}
+	parse::SelectScanKernels(default_isa);
+}
+
+// Scaling of Lexer(source, thread_count), which lexes the whole source up front
+void BenchParallelLexer(const string &corpus) {
+	const size_t hardware_threads = max<size_t>(thread::hardware_concurrency(), 1);
+	cout << "Hardware threads: " << hardware_threads << endl;
+	double single_thread_seconds = 0;
+	for (size_t thread_count = 1; thread_count <= max<size_t>(hardware_threads, 4);
+			thread_count *= 2) {
+		const auto start = chrono::steady_clock::now();
+		parse::Lexer lexer(corpus, thread_count);
+		const size_t tokens = CountTokens(lexer);
+		const double seconds = SecondsSince(start);
+		if (thread_count == 1) {
+			single_thread_seconds = seconds;
+		}
+		Report("Parallel lexer, "s + to_string(thread_count) + " threads"s, corpus.size(), tokens,
+				seconds);
+		cout << "  speedup " << setprecision(2) << single_thread_seconds / seconds << "x"
+				<< endl;
+	}
+}
+
+// Editing one line costs the same in a small and in a big file, unlike lexing the file anew
+void BenchIncrementalLexer() {
+	for (size_t megabytes : { 1, 8 }) {
+		const string corpus = MakeCorpus(SAMPLE_PROGRAM, megabytes << 20);
+		parse::IncrementalLexer lexer(corpus);
+		const size_t middle = lexer.LineCount() / 2;
+		constexpr int EDIT_COUNT = 1000;
+
+		auto start = chrono::steady_clock::now();
+		for (int i = 0; i < EDIT_COUNT; ++i) {
+			lexer.Edit(middle, 1, i % 2 == 0 ? "  x = self.w * 2\n"sv : "x = 'text'\n"sv);
+		}
+		const double edit_seconds = SecondsSince(start) / EDIT_COUNT;
+
+		start = chrono::steady_clock::now();
+		parse::Lexer full_lexer { string_view(corpus) };
+		CountTokens(full_lexer);
+		const double full_seconds = SecondsSince(start);
+
+		cout << "Incremental lexer, " << megabytes << " MB: " << fixed << setprecision(2)
+				<< edit_seconds * 1e6 << " us per edit of a line, " << full_seconds * 1e6
+				<< " us to lex the whole file" << defaultfloat << endl;
+	}
+}
+
+void BenchLexer(const string &corpus) {
+	{
+		const auto start = chrono::steady_clock::now();
+		parse::Lexer lexer(string_view { corpus });
+		const size_t tokens = CountTokens(lexer);
+		Report("Lexer, in-memory source"sv, corpus.size(), tokens, SecondsSince(start));
+	}
+	{
+		istringstream input(corpus);
+		const auto start = chrono::steady_clock::now();
+		parse::Lexer lexer(input);
+		const size_t tokens = CountTokens(lexer);
+		Report("Lexer, std::istream"sv, corpus.size(), tokens, SecondsSince(start));
+	}
+}
+
+// Classification of symbols and words as the lexer did it before the lookup tables:
+// two std::set<char> searches per symbol, a std::set<std::string> search and a chain of
+// string comparisons per word
+size_t ClassifyWithSets(const string &corpus) {
+	const set<string> keywords { "class"s, "return"s, "if"s, "else"s, "def"s, "print"s, "and"s,
+		"or"s, "not"s, "=="s, "!="s, "<="s, ">="s, "None"s, "True"s, "False"s };
+	const set<char> trigger_symbols { ' ', ',', ':', '.', '(', ')', '\\' };
+	const set<char> math_symbols { '+', '-', '*', '/', '=', '<', '>', '!' };
+
+	size_t found = 0;
+	string word;
+	for (char symbol : corpus) {
+		if (math_symbols.count(symbol) || trigger_symbols.count(symbol) || symbol == '\n') {
+			if (!word.empty() && keywords.count(word)) {
+				found += word == "class"s || word == "return"s || word == "if"s
+						|| word == "else"s || word == "def"s || word == "print"s
+						|| word == "and"s || word == "or"s || word == "not"s
+						|| word == "None"s || word == "True"s || word == "False"s;
+			}
+			word.clear();
+		} else {
+			word += symbol;
+		}
+	}
+	return found;
+}
+
+size_t ClassifyWithTables(const string &corpus) {
+	size_t found = 0;
+	const char *word_begin = corpus.data();
+	for (const char &symbol : corpus) {
+		const parse::CharClass symbol_class = parse::ClassOf(symbol);
+		if (symbol_class == parse::CharClass::MATH || symbol_class == parse::CharClass::TRIGGER
+				|| symbol_class == parse::CharClass::SKIP || symbol == '\n') {
+			if (&symbol != word_begin) {
+				found += parse::FindKeyword(string_view(word_begin,
+						static_cast<size_t>(&symbol - word_begin))) != nullptr;
+			}
+			word_begin = &symbol + 1;
+		}
+	}
+	return found;
+}
+
+void BenchClassification(const string &corpus) {
+	auto start = chrono::steady_clock::now();
+	const size_t with_sets = ClassifyWithSets(corpus);
+	const double sets_seconds = SecondsSince(start);
+	Report("Classification, std::set"sv, corpus.size(), 0, sets_seconds);
+
+	start = chrono::steady_clock::now();
+	const size_t with_tables = ClassifyWithTables(corpus);
+	const double tables_seconds = SecondsSince(start);
+	Report("Classification, tables"sv, corpus.size(), 0, tables_seconds);
+
+	cout << "Speedup: " << setprecision(1) << sets_seconds / tables_seconds << "x, keywords found: "
+			<< with_sets << " / " << with_tables << endl;
+}
+
+// Lexes the corpus from memory, returns the time and counts the tokens and heap allocations
+double LexCorpus(const string &corpus, size_t &tokens, size_t &allocations) {
+	const size_t allocations_before = allocation_count.load();
+	const auto start = chrono::steady_clock::now();
+	parse::Lexer lexer { string_view(corpus) };
+	tokens = CountTokens(lexer);
+	const double seconds = SecondsSince(start);
+	allocations = allocation_count.load() - allocations_before;
+	return seconds;
+}
+
+void BenchSyntheticCorpora(size_t megabytes) {
+	for (const SyntheticCorpus &synthetic : SYNTHETIC_CORPORA) {
+		const string corpus = synthetic.make(megabytes << 20);
+		size_t tokens = 0;
+		size_t allocations = 0;
+		const double seconds = LexCorpus(corpus, tokens, allocations);
+		Report(synthetic.name, corpus.size(), tokens, seconds, allocations);
+	}
+}
+
+// Lexing time of a corpus should grow linearly with its size. The time is the best of the runs
+// made in MIN_SECONDS. A corpus whose time grows faster than size^MAX_EXPONENT on every doubling
+// of the size is reported, a single slow doubling is rather a corpus that no longer fits into
+// a cache. Returns false if any corpus is reported
+bool CheckScaling(size_t max_megabytes) {
+	constexpr double MAX_EXPONENT = 1.3;
+	constexpr int MIN_RUNS = 5;
+	constexpr double MIN_SECONDS = 0.1;
+	const size_t max_size = max<size_t>(max_megabytes, 1) << 20;
+	const size_t min_size = max_size / 8;
+
+	bool linear = true;
+	for (const SyntheticCorpus &synthetic : SYNTHETIC_CORPORA) {
+		cout << setw(28) << left << synthetic.name << right;
+		double previous_seconds = 0;
+		size_t previous_bytes = 0;
+		double min_exponent = numeric_limits<double>::max();
+		for (size_t size = min_size; size <= max_size; size *= 2) {
+			const string corpus = synthetic.make(size);
+			double seconds = numeric_limits<double>::max();
+			double total_seconds = 0;
+			for (int run = 0; run < MIN_RUNS || total_seconds < MIN_SECONDS; ++run) {
+				size_t tokens = 0;
+				size_t allocations = 0;
+				const double run_seconds = LexCorpus(corpus, tokens, allocations);
+				seconds = min(seconds, run_seconds);
+				total_seconds += run_seconds;
+			}
+			if (previous_bytes > 0) {
+				min_exponent = min(min_exponent, log(seconds / previous_seconds)
+						/ log(double(corpus.size()) / previous_bytes));
+			}
+			previous_seconds = seconds;
+			previous_bytes = corpus.size();
+			cout << fixed << setprecision(2) << setw(10) << seconds * 1e3 << " ms";
+		}
+		cout << "   exponent " << setprecision(2) << min_exponent;
+		if (min_exponent > MAX_EXPONENT) {
+			cout << "   SUPERLINEAR";
+			linear = false;
+		}
+		cout << endl;
+	}
+	return linear;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+	if (argc > 1 && argv[1] == "--scaling"sv) {
+		const size_t max_megabytes = argc > 2 ? static_cast<size_t>(atoi(argv[2])) : 16;
+		return CheckScaling(max_megabytes) ? 0 : 1;
+	}
+
+	const size_t megabytes = argc > 1 ? static_cast<size_t>(atoi(argv[1])) : 64;
+	const string corpus = MakeCorpus(SAMPLE_PROGRAM, megabytes << 20);
+	cout << "Corpus: " << corpus.size() / double(1 << 20) << " MB" << endl;
+
+	BenchLexer(corpus);
+	BenchParallelLexer(corpus);
+	BenchIncrementalLexer();
+	BenchClassification(corpus);
+
+	BenchScanKernels("Sample"sv, corpus);
+	BenchScanKernels("Comments"sv, MakeCorpus(COMMENT_HEAVY_PROGRAM, megabytes << 20));
+	BenchScanKernels("Strings"sv, MakeCorpus(STRING_HEAVY_PROGRAM, megabytes << 20));
+	BenchScanKernels("UTF-8"sv, MakeCorpus(UTF8_PROGRAM, megabytes << 20),
+			parse::LexerOptions { true });
+	BenchScanKernels("Long comment"sv, MakeLongComment(megabytes << 20));
+	BenchScanKernels("Long string"sv, MakeLongString(megabytes << 20));
+
+	BenchSyntheticCorpora(megabytes);
+	return 0;
+}
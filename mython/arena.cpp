@@ -0,0 +1,79 @@
+#include "arena.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+
+using namespace std;
+
+namespace ast {
+
+Arena::~Arena() {
+	for (Destructor *destructor = destructors_; destructor != nullptr;
+			destructor = destructor->next) {
+		destructor->destroy(destructor->object);
+	}
+}
+
+void* Arena::Allocate(size_t size, size_t alignment) {
+	const auto aligned = [this, alignment] {
+		const auto address = reinterpret_cast<uintptr_t>(current_);
+		return current_ + ((alignment - address % alignment) % alignment);
+	};
+	char *begin = aligned();
+	if (current_ == nullptr || static_cast<size_t>(end_ - begin) < size) {
+		AddBlock(size + alignment);
+		begin = aligned();
+	}
+	stats_.bytes_used += static_cast<size_t>(begin - current_) + size;
+	current_ = begin + size;
+	return begin;
+}
+
+// Текущий блок остаётся прежним, оставшееся место в блоках other не используется
+void Arena::Merge(Arena &other) {
+	blocks_.insert(blocks_.end(), make_move_iterator(other.blocks_.begin()),
+			make_move_iterator(other.blocks_.end()));
+	if (other.destructors_ != nullptr) {
+		other.last_destructor_->next = destructors_;
+		if (destructors_ == nullptr) {
+			last_destructor_ = other.last_destructor_;
+		}
+		destructors_ = other.destructors_;
+	}
+	stats_.object_count += other.stats_.object_count;
+	stats_.destructor_count += other.stats_.destructor_count;
+	stats_.bytes_used += other.stats_.bytes_used;
+	stats_.bytes_reserved += other.stats_.bytes_reserved;
+	stats_.block_count += other.stats_.block_count;
+
+	other.blocks_.clear();
+	other.current_ = nullptr;
+	other.end_ = nullptr;
+	other.next_block_size_ = FIRST_BLOCK_SIZE;
+	other.destructors_ = nullptr;
+	other.last_destructor_ = nullptr;
+	other.stats_ = {};
+}
+
+void Arena::AddDestructor(void *object, void (*destroy)(void*)) {
+	destructors_ = new (Allocate(sizeof(Destructor), alignof(Destructor)))
+			Destructor { destroy, object, destructors_ };
+	if (last_destructor_ == nullptr) {
+		last_destructor_ = destructors_;
+	}
+	++stats_.destructor_count;
+}
+
+// Блоки растут вдвое до MAX_BLOCK_SIZE, так что маленькие программы занимают мало памяти,
+// а большие - немного блоков. Объект больше блока получает блок своего размера
+void Arena::AddBlock(size_t min_size) {
+	const size_t size = max(next_block_size_, min_size);
+	next_block_size_ = min(next_block_size_ * 2, MAX_BLOCK_SIZE);
+	current_ = blocks_.emplace_back(new char[size]).get();
+	end_ = current_ + size;
+	stats_.bytes_reserved += size;
+	++stats_.block_count;
+}
+
+}  // namespace ast
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ast {
+
+// Объекты, деструктор которых не освобождает никаких ресурсов, арена не разрушает.
+// Узлы дерева, у которых потомки тоже созданы в арене, отмечаются специализацией этого шаблона
+template <typename T>
+struct IsArenaTrivial : std::is_trivially_destructible<T> {};
+
+// Арена, в которой создаются узлы синтаксического дерева программы.
+// Память выделяется сдвигом указателя внутри больших блоков и освобождается разом вместе
+// с ареной. Деструкторы вызываются только у объектов, которые владеют ресурсами вне арены
+// (строками, векторами), поэтому разрушение дерева не обходит все его узлы
+class Arena {
+public:
+    // Статистика использования памяти
+    struct Stats {
+        size_t object_count = 0;      // создано объектов
+        size_t destructor_count = 0;  // объектов, которые разрушаются вместе с ареной
+        size_t bytes_used = 0;        // занято объектами, включая выравнивание
+        size_t bytes_reserved = 0;    // выделено под блоки
+        size_t block_count = 0;
+    };
+
+    Arena() = default;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    ~Arena();
+
+    // Выделяет size байт, выровненных по alignment
+    [[nodiscard]] void* Allocate(size_t size, size_t alignment);
+
+    // Создаёт объект типа T. Объект живёт до разрушения арены
+    template <typename T, typename... Args>
+    T* Make(Args&&... args) {
+        T* object = new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        ++stats_.object_count;
+        if constexpr (!IsArenaTrivial<T>::value) {
+            AddDestructor(object, [](void* p) {
+                static_cast<T*>(p)->~T();
+            });
+        }
+        return object;
+    }
+
+    // Переносит в эту арену блоки и объекты арены other, other становится пустой. Так объекты,
+    // созданные в разных потоках каждым в своей арене, живут затем до разрушения этой арены
+    void Merge(Arena& other);
+
+    [[nodiscard]] const Stats& GetStats() const {
+        return stats_;
+    }
+
+private:
+    static constexpr size_t FIRST_BLOCK_SIZE = 4 * 1024;
+    static constexpr size_t MAX_BLOCK_SIZE = 1024 * 1024;
+
+    // Список деструкторов тоже хранится в арене, от последнего созданного объекта к первому
+    struct Destructor {
+        void (*destroy)(void*);
+        void* object;
+        Destructor* next;
+    };
+
+    std::vector<std::unique_ptr<char[]>> blocks_;
+    char* current_ = nullptr;
+    char* end_ = nullptr;
+    size_t next_block_size_ = FIRST_BLOCK_SIZE;
+    Destructor* destructors_ = nullptr;
+    Destructor* last_destructor_ = nullptr;  // первый созданный, к нему присоединяется Merge
+    Stats stats_;
+
+    void AddDestructor(void* object, void (*destroy)(void*));
+    void AddBlock(size_t min_size);
+};
+
+}  // namespace ast
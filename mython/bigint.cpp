@@ -0,0 +1,320 @@
+#include "bigint.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+using namespace std;
+
+namespace runtime {
+
+namespace {
+
+using Digits = vector<uint32_t>;
+
+const uint64_t BASE = uint64_t(1) << 32;
+// Множители короче этого числа цифр перемножаются в столбик: на коротких числах алгоритм
+// Карацубы медленнее из-за сложений и выделения памяти под промежуточные значения
+const size_t KARATSUBA_THRESHOLD = 32;
+// Основание, по которому модуль переводится в десятичную запись: девять знаков за деление
+const uint32_t DECIMAL_CHUNK = 1000000000;
+const int DECIMAL_CHUNK_WIDTH = 9;
+
+void Trim(Digits &digits) {
+	while (!digits.empty() && digits.back() == 0) {
+		digits.pop_back();
+	}
+}
+
+int CompareDigits(const Digits &lhs, const Digits &rhs) {
+	if (lhs.size() != rhs.size()) {
+		return lhs.size() < rhs.size() ? -1 : 1;
+	}
+	for (size_t i = lhs.size(); i-- > 0;) {
+		if (lhs[i] != rhs[i]) {
+			return lhs[i] < rhs[i] ? -1 : 1;
+		}
+	}
+	return 0;
+}
+
+Digits AddDigits(const Digits &lhs, const Digits &rhs) {
+	const Digits &longer = lhs.size() >= rhs.size() ? lhs : rhs;
+	const Digits &shorter = lhs.size() >= rhs.size() ? rhs : lhs;
+	Digits result;
+	result.reserve(longer.size() + 1);
+	uint64_t carry = 0;
+	for (size_t i = 0; i < longer.size(); ++i) {
+		const uint64_t sum = uint64_t(longer[i]) + (i < shorter.size() ? shorter[i] : 0) + carry;
+		result.push_back(static_cast<uint32_t>(sum));
+		carry = sum >> 32;
+	}
+	if (carry != 0) {
+		result.push_back(static_cast<uint32_t>(carry));
+	}
+	return result;
+}
+
+// Вычитает rhs из lhs, lhs не меньше rhs
+Digits SubDigits(const Digits &lhs, const Digits &rhs) {
+	Digits result;
+	result.reserve(lhs.size());
+	uint64_t borrow = 0;
+	for (size_t i = 0; i < lhs.size(); ++i) {
+		const uint64_t subtrahend = (i < rhs.size() ? rhs[i] : 0) + borrow;
+		borrow = lhs[i] < subtrahend ? 1 : 0;
+		result.push_back(static_cast<uint32_t>(BASE * borrow + lhs[i] - subtrahend));
+	}
+	Trim(result);
+	return result;
+}
+
+// Прибавляет value, сдвинутое на shift цифр, к result. Сумма помещается в result
+void AddShifted(Digits &result, const Digits &value, size_t shift) {
+	uint64_t carry = 0;
+	size_t i = 0;
+	for (; i < value.size(); ++i) {
+		const uint64_t sum = uint64_t(result[i + shift]) + value[i] + carry;
+		result[i + shift] = static_cast<uint32_t>(sum);
+		carry = sum >> 32;
+	}
+	for (i += shift; carry != 0; ++i) {
+		const uint64_t sum = uint64_t(result[i]) + carry;
+		result[i] = static_cast<uint32_t>(sum);
+		carry = sum >> 32;
+	}
+}
+
+Digits MultiplySchool(const Digits &lhs, const Digits &rhs) {
+	Digits result(lhs.size() + rhs.size());
+	for (size_t i = 0; i < lhs.size(); ++i) {
+		uint64_t carry = 0;
+		for (size_t j = 0; j < rhs.size(); ++j) {
+			const uint64_t product = uint64_t(lhs[i]) * rhs[j] + result[i + j] + carry;
+			result[i + j] = static_cast<uint32_t>(product);
+			carry = product >> 32;
+		}
+		result[i + rhs.size()] = static_cast<uint32_t>(carry);
+	}
+	Trim(result);
+	return result;
+}
+
+// Возвращает младшие count цифр и остальные цифры числа
+pair<Digits, Digits> Split(const Digits &digits, size_t count) {
+	count = min(count, digits.size());
+	Digits low(digits.begin(), digits.begin() + count);
+	Digits high(digits.begin() + count, digits.end());
+	Trim(low);
+	return {move(low), move(high)};
+}
+
+// Алгоритм Карацубы: lhs = a1 * B^half + a0, rhs = b1 * B^half + b0, произведение равно
+// a1b1 * B^(2half) + ((a0 + a1)(b0 + b1) - a0b0 - a1b1) * B^half + a0b0 - три умножения
+// половинной длины вместо четырёх
+Digits MultiplyDigits(const Digits &lhs, const Digits &rhs) {
+	if (lhs.empty() || rhs.empty()) {
+		return {};
+	}
+	if (min(lhs.size(), rhs.size()) < KARATSUBA_THRESHOLD) {
+		return MultiplySchool(lhs, rhs);
+	}
+	const size_t half = max(lhs.size(), rhs.size()) / 2;
+	const auto [a0, a1] = Split(lhs, half);
+	const auto [b0, b1] = Split(rhs, half);
+	const Digits low = MultiplyDigits(a0, b0);
+	const Digits high = MultiplyDigits(a1, b1);
+	const Digits middle = SubDigits(SubDigits(MultiplyDigits(AddDigits(a0, a1),
+			AddDigits(b0, b1)), low), high);
+
+	Digits result(lhs.size() + rhs.size());
+	AddShifted(result, low, 0);
+	AddShifted(result, middle, half);
+	AddShifted(result, high, 2 * half);
+	Trim(result);
+	return result;
+}
+
+// Делит digits на однозначный делитель на месте и возвращает остаток
+uint32_t DivideBySmall(Digits &digits, uint32_t divisor) {
+	uint64_t remainder = 0;
+	for (size_t i = digits.size(); i-- > 0;) {
+		const uint64_t current = remainder << 32 | digits[i];
+		digits[i] = static_cast<uint32_t>(current / divisor);
+		remainder = current % divisor;
+	}
+	Trim(digits);
+	return static_cast<uint32_t>(remainder);
+}
+
+// Сдвигает цифры влево на shift бит (shift < 32), добавляя extra старших цифр
+Digits ShiftLeft(const Digits &digits, int shift, size_t extra) {
+	Digits result(digits.size() + extra);
+	uint32_t carry = 0;
+	for (size_t i = 0; i < digits.size(); ++i) {
+		result[i] = digits[i] << shift | carry;
+		carry = shift == 0 ? 0 : digits[i] >> (32 - shift);
+	}
+	if (extra != 0) {
+		result[digits.size()] = carry;
+	}
+	return result;
+}
+
+// Деление в столбик по алгоритму D Кнута. Делитель не равен нулю
+Digits DivideDigits(const Digits &lhs, const Digits &rhs) {
+	if (CompareDigits(lhs, rhs) < 0) {
+		return {};
+	}
+	if (rhs.size() == 1) {
+		Digits quotient = lhs;
+		DivideBySmall(quotient, rhs[0]);
+		return quotient;
+	}
+	// Старший бит делителя должен быть единицей, тогда оценка цифры частного по двум старшим
+	// цифрам остатка ошибается не больше чем на два
+	const int shift = __builtin_clz(rhs.back());
+	const Digits divisor = ShiftLeft(rhs, shift, 0);
+	Digits remainder = ShiftLeft(lhs, shift, 1);
+	const size_t n = divisor.size();
+	Digits quotient(lhs.size() - n + 1);
+
+	for (size_t j = quotient.size(); j-- > 0;) {
+		const uint64_t top = uint64_t(remainder[j + n]) << 32 | remainder[j + n - 1];
+		uint64_t digit = top / divisor[n - 1];
+		uint64_t rest = top % divisor[n - 1];
+		while (digit >= BASE || digit * divisor[n - 2] > (rest << 32 | remainder[j + n - 2])) {
+			--digit;
+			rest += divisor[n - 1];
+			if (rest >= BASE) {
+				break;
+			}
+		}
+
+		// Вычитает digit * divisor из остатка
+		int64_t borrow = 0;
+		for (size_t i = 0; i < n; ++i) {
+			const uint64_t product = digit * divisor[i];
+			const int64_t difference = int64_t(remainder[i + j]) - borrow
+					- int64_t(product & 0xFFFFFFFF);
+			remainder[i + j] = static_cast<uint32_t>(difference);
+			borrow = int64_t(product >> 32) - (difference >> 32);
+		}
+		const int64_t difference = int64_t(remainder[j + n]) - borrow;
+		remainder[j + n] = static_cast<uint32_t>(difference);
+
+		// Оценка оказалась на единицу больше: делитель прибавляется обратно
+		if (difference < 0) {
+			--digit;
+			uint64_t carry = 0;
+			for (size_t i = 0; i < n; ++i) {
+				const uint64_t sum = uint64_t(remainder[i + j]) + divisor[i] + carry;
+				remainder[i + j] = static_cast<uint32_t>(sum);
+				carry = sum >> 32;
+			}
+			remainder[j + n] += static_cast<uint32_t>(carry);
+		}
+		quotient[j] = static_cast<uint32_t>(digit);
+	}
+	Trim(quotient);
+	return quotient;
+}
+
+}  // namespace
+
+BigInt::BigInt(int64_t value) :
+		negative_(value < 0) {
+	// Модуль INT64_MIN не помещается в int64_t, поэтому он вычисляется без знака
+	uint64_t magnitude = negative_ ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+	while (magnitude != 0) {
+		digits_.push_back(static_cast<uint32_t>(magnitude));
+		magnitude >>= 32;
+	}
+}
+
+BigInt::BigInt(vector<uint32_t> digits, bool negative) :
+		digits_(move(digits)), negative_(negative && !digits_.empty()) {
+}
+
+optional<int64_t> BigInt::ToInt64() const {
+	if (digits_.size() > 2) {
+		return nullopt;
+	}
+	uint64_t magnitude = 0;
+	for (size_t i = digits_.size(); i-- > 0;) {
+		magnitude = magnitude << 32 | digits_[i];
+	}
+	const uint64_t max_magnitude = uint64_t(numeric_limits<int64_t>::max()) + (negative_ ? 1 : 0);
+	if (magnitude > max_magnitude) {
+		return nullopt;
+	}
+	return negative_ ? static_cast<int64_t>(0 - magnitude) : static_cast<int64_t>(magnitude);
+}
+
+string BigInt::ToString() const {
+	if (digits_.empty()) {
+		return "0"s;
+	}
+	vector<uint32_t> chunks;
+	Digits rest = digits_;
+	while (!rest.empty()) {
+		chunks.push_back(DivideBySmall(rest, DECIMAL_CHUNK));
+	}
+	string result = negative_ ? "-"s : ""s;
+	result += to_string(chunks.back());
+	for (size_t i = chunks.size() - 1; i-- > 0;) {
+		const string chunk = to_string(chunks[i]);
+		result.append(DECIMAL_CHUNK_WIDTH - chunk.size(), '0');
+		result += chunk;
+	}
+	return result;
+}
+
+BigInt BigInt::operator-() const {
+	return BigInt(digits_, !negative_);
+}
+
+BigInt operator+(const BigInt &lhs, const BigInt &rhs) {
+	if (lhs.negative_ == rhs.negative_) {
+		return BigInt(AddDigits(lhs.digits_, rhs.digits_), lhs.negative_);
+	}
+	// Знаки разные: из большего модуля вычитается меньший, знак - у большего
+	if (CompareDigits(lhs.digits_, rhs.digits_) >= 0) {
+		return BigInt(SubDigits(lhs.digits_, rhs.digits_), lhs.negative_);
+	}
+	return BigInt(SubDigits(rhs.digits_, lhs.digits_), rhs.negative_);
+}
+
+BigInt operator-(const BigInt &lhs, const BigInt &rhs) {
+	return lhs + -rhs;
+}
+
+BigInt operator*(const BigInt &lhs, const BigInt &rhs) {
+	return BigInt(MultiplyDigits(lhs.digits_, rhs.digits_), lhs.negative_ != rhs.negative_);
+}
+
+BigInt operator/(const BigInt &lhs, const BigInt &rhs) {
+	if (rhs.IsZero()) {
+		throw domain_error("Division by zero"s);
+	}
+	return BigInt(DivideDigits(lhs.digits_, rhs.digits_), lhs.negative_ != rhs.negative_);
+}
+
+bool operator==(const BigInt &lhs, const BigInt &rhs) {
+	return lhs.negative_ == rhs.negative_ && lhs.digits_ == rhs.digits_;
+}
+
+bool operator<(const BigInt &lhs, const BigInt &rhs) {
+	if (lhs.negative_ != rhs.negative_) {
+		return lhs.negative_;
+	}
+	const int order = CompareDigits(lhs.digits_, rhs.digits_);
+	return lhs.negative_ ? order > 0 : order < 0;
+}
+
+ostream& operator<<(ostream &os, const BigInt &value) {
+	return os << value.ToString();
+}
+
+}  // namespace runtime
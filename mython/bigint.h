@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace runtime {
+
+/*
+Целое число произвольной длины. Хранит знак и модуль в виде цифр по основанию 2^32, младшие
+цифры первыми, без ведущих нулей. Числа Mython, которые не помещаются в int64_t, становятся
+объектами BigNumber с таким значением (см. runtime.h).
+Умножение длинных чисел выполняется по алгоритму Карацубы, короткие множители перемножаются
+в столбик. Деление, как и для Number, отбрасывает дробную часть
+*/
+class BigInt {
+public:
+    BigInt() = default;
+    explicit BigInt(int64_t value);
+
+    // Возвращает значение, если оно помещается в int64_t, иначе nullopt
+    [[nodiscard]] std::optional<int64_t> ToInt64() const;
+
+    [[nodiscard]] bool IsZero() const {
+        return digits_.empty();
+    }
+
+    [[nodiscard]] bool IsNegative() const {
+        return negative_;
+    }
+
+    [[nodiscard]] std::string ToString() const;
+
+    BigInt operator-() const;
+
+    friend BigInt operator+(const BigInt& lhs, const BigInt& rhs);
+    friend BigInt operator-(const BigInt& lhs, const BigInt& rhs);
+    friend BigInt operator*(const BigInt& lhs, const BigInt& rhs);
+    // Если rhs равен нулю, выбрасывается исключение std::domain_error
+    friend BigInt operator/(const BigInt& lhs, const BigInt& rhs);
+
+    friend bool operator==(const BigInt& lhs, const BigInt& rhs);
+    friend bool operator<(const BigInt& lhs, const BigInt& rhs);
+
+private:
+    BigInt(std::vector<uint32_t> digits, bool negative);
+
+    std::vector<uint32_t> digits_;
+    bool negative_ = false;
+};
+
+inline bool operator!=(const BigInt& lhs, const BigInt& rhs) {
+    return !(lhs == rhs);
+}
+
+inline bool operator>(const BigInt& lhs, const BigInt& rhs) {
+    return rhs < lhs;
+}
+
+inline bool operator<=(const BigInt& lhs, const BigInt& rhs) {
+    return !(rhs < lhs);
+}
+
+inline bool operator>=(const BigInt& lhs, const BigInt& rhs) {
+    return !(lhs < rhs);
+}
+
+std::ostream& operator<<(std::ostream& os, const BigInt& value);
+
+}  // namespace runtime
@@ -0,0 +1,534 @@
+#include "flat_ast.h"
+
+#include <iostream>
+#include <stdexcept>
+#include <typeinfo>
+#include <unordered_map>
+
+using namespace std;
+
+namespace ast {
+
+using runtime::Closure;
+using runtime::Context;
+using runtime::ObjectHolder;
+using NodeIndex = FlatProgram::NodeIndex;
+using Kind = FlatProgram::Kind;
+
+namespace {
+const runtime::Symbol INIT_METHOD = "__init__"sv;
+}  // namespace
+
+class Flattener {
+public:
+	explicit Flattener(FlatProgram &program) :
+			program_(program) {
+	}
+
+	// Потомки записываются раньше родителя, поэтому узлы лежат в порядке вычисления
+	NodeIndex Flatten(const Statement *statement) {
+		if (statement == nullptr) {
+			return FlatProgram::NO_NODE;
+		}
+		const type_info &type = typeid(*statement);
+		if (const auto *program = As<Program>(statement, type)) {
+			return Flatten(program->root_.get());
+		}
+		if (const auto *constant = As<NumericConst>(statement, type)) {
+			return AddConst(*constant);
+		}
+		if (const auto *constant = As<StringConst>(statement, type)) {
+			return AddConst(*constant);
+		}
+		if (const auto *constant = As<BoolConst>(statement, type)) {
+			return AddConst(*constant);
+		}
+		if (As<None>(statement, type) != nullptr) {
+			return AddNode(Kind::None);
+		}
+		if (const auto *variable = As<VariableValue>(statement, type)) {
+			return AddVariable(*variable);
+		}
+		if (const auto *assignment = As<Assignment>(statement, type)) {
+			const NodeIndex value = Flatten(assignment->rv_.get());
+			return AddNode(Kind::Assignment, assignment->var_.Id(), value, assignment->slot_);
+		}
+		if (const auto *assignment = As<FieldAssignment>(statement, type)) {
+			const NodeIndex object = AddVariable(assignment->object_);
+			const NodeIndex value = Flatten(assignment->rv_.get());
+			return AddNode(Kind::FieldAssignment, object, assignment->field_name_.Id(), value);
+		}
+		if (const auto *print = As<Print>(statement, type)) {
+			return AddNode(Kind::Print, AddList(print->args_), Size(print->args_));
+		}
+		if (const auto *call = As<MethodCall>(statement, type)) {
+			vector<NodeIndex> children = FlattenAll(call->args_);
+			children.push_back(Flatten(call->object_.get()));
+			if (call->bound_method_ != nullptr && !call->bound_method_->build) {
+				bound_methods_.push_back(call->bound_method_);
+				return AddNode(Kind::BoundMethodCall, AddChildren(children), Size(call->args_),
+						Size(bound_methods_) - 1);
+			}
+			return AddNode(Kind::MethodCall, AddChildren(children), Size(call->args_),
+					call->method_.Id());
+		}
+		if (const auto *instance = As<NewInstance>(statement, type)) {
+			const runtime::Class &cls = FlattenClass(instance->new_class_.GetClass());
+			const uint32_t first = AddList(instance->args_);
+			program_.instances_.emplace_back(cls);
+			return AddNode(Kind::NewInstance, Size(program_.instances_) - 1, first,
+					Size(instance->args_));
+		}
+		if (const auto *stringify = As<Stringify>(statement, type)) {
+			return AddUnary(Kind::Stringify, *stringify);
+		}
+		if (const auto *operation = As<Not>(statement, type)) {
+			return AddUnary(Kind::Not, *operation);
+		}
+		if (const auto *operation = As<Negate>(statement, type)) {
+			return AddUnary(Kind::Negate, *operation);
+		}
+		if (const auto *operation = As<Add>(statement, type)) {
+			return AddBinary(Kind::Add, *operation);
+		}
+		if (const auto *operation = As<Sub>(statement, type)) {
+			return AddBinary(Kind::Sub, *operation);
+		}
+		if (const auto *operation = As<Mult>(statement, type)) {
+			return AddBinary(Kind::Mult, *operation);
+		}
+		if (const auto *operation = As<Div>(statement, type)) {
+			return AddBinary(Kind::Div, *operation);
+		}
+		if (const auto *operation = As<Or>(statement, type)) {
+			return AddBinary(Kind::Or, *operation);
+		}
+		if (const auto *operation = As<And>(statement, type)) {
+			return AddBinary(Kind::And, *operation);
+		}
+		if (const auto *comparison = As<Equal>(statement, type)) {
+			return AddBinary(Kind::Equal, *comparison);
+		}
+		if (const auto *comparison = As<NotEqual>(statement, type)) {
+			return AddBinary(Kind::NotEqual, *comparison);
+		}
+		if (const auto *comparison = As<Less>(statement, type)) {
+			return AddBinary(Kind::Less, *comparison);
+		}
+		if (const auto *comparison = As<Greater>(statement, type)) {
+			return AddBinary(Kind::Greater, *comparison);
+		}
+		if (const auto *comparison = As<LessOrEqual>(statement, type)) {
+			return AddBinary(Kind::LessOrEqual, *comparison);
+		}
+		if (const auto *comparison = As<GreaterOrEqual>(statement, type)) {
+			return AddBinary(Kind::GreaterOrEqual, *comparison);
+		}
+		if (const auto *compound = As<Compound>(statement, type)) {
+			return AddNode(Kind::Compound, AddList(compound->compound_),
+					Size(compound->compound_));
+		}
+		if (const auto *body = As<MethodBody>(statement, type)) {
+			return AddNode(Kind::MethodBody, Flatten(body->body_.get()));
+		}
+		if (const auto *return_statement = As<Return>(statement, type)) {
+			return AddNode(Kind::Return, Flatten(return_statement->statement_.get()));
+		}
+		if (const auto *definition = As<ClassDefinition>(statement, type)) {
+			FlattenClass(*definition->cls_.TryAs<runtime::Class>());
+			return AddNode(Kind::ClassDefinition,
+					class_indices_.at(definition->cls_.TryAs<runtime::Class>()));
+		}
+		if (const auto *if_else = As<IfElse>(statement, type)) {
+			const NodeIndex condition = Flatten(if_else->condition_.get());
+			const NodeIndex if_body = Flatten(if_else->if_body_.get());
+			const NodeIndex else_body = Flatten(if_else->else_body_.get());
+			return AddNode(Kind::IfElse, condition, if_body, else_body);
+		}
+		throw invalid_argument("Statement of type "s + type.name()
+				+ " has no flat representation"s);
+	}
+
+	// Связанный метод принадлежит классу метода, в котором записан вызов, или его предку, поэтому
+	// к концу построения все такие классы уже построены
+	void BindMethods() {
+		program_.bound_methods_.reserve(bound_methods_.size());
+		for (const runtime::Method *method : bound_methods_) {
+			const auto it = flat_methods_.find(method);
+			if (it == flat_methods_.end()) {
+				throw invalid_argument("A bound method call has no flat representation"s);
+			}
+			program_.bound_methods_.push_back(it->second);
+		}
+	}
+
+private:
+	FlatProgram &program_;
+	// Классы дерева и номера построенных по ним классов плоской программы
+	unordered_map<const runtime::Class*, uint32_t> class_indices_;
+	// Методы дерева, с которыми связаны вызовы, по порядку узлов BoundMethodCall
+	vector<const runtime::Method*> bound_methods_;
+	// Методы дерева и построенные по ним методы плоской программы
+	unordered_map<const runtime::Method*, const runtime::Method*> flat_methods_;
+
+	// Узлы сравниваются по точному типу: это намного быстрее цепочки dynamic_cast
+	template <typename T>
+	static const T* As(const Statement *statement, const type_info &type) {
+		return type == typeid(T) ? static_cast<const T*>(statement) : nullptr;
+	}
+
+	template <typename Container>
+	static uint32_t Size(const Container &container) {
+		if (container.size() >= FlatProgram::NO_NODE) {
+			throw length_error("The program is too large for the flat representation"s);
+		}
+		return static_cast<uint32_t>(container.size());
+	}
+
+	NodeIndex AddNode(Kind kind, uint32_t a = 0, uint32_t b = 0, uint32_t c = 0) {
+		program_.nodes_.push_back( { kind, a, b, c });
+		return Size(program_.nodes_) - 1;
+	}
+
+	template <typename T>
+	NodeIndex AddConst(const ValueStatement<T> &constant) {
+		program_.constants_.push_back(ObjectHolder::Own(T(constant.value_)));
+		return AddNode(Kind::Const, Size(program_.constants_) - 1);
+	}
+
+	NodeIndex AddVariable(const VariableValue &variable) {
+		return AddNode(Kind::Variable, AddNames(variable.dotted_ids_),
+				Size(variable.dotted_ids_), variable.slot_);
+	}
+
+	NodeIndex AddUnary(Kind kind, const UnaryOperation &operation) {
+		return AddNode(kind, Flatten(operation.argument_.get()));
+	}
+
+	NodeIndex AddBinary(Kind kind, const BinaryOperation &operation) {
+		const NodeIndex lhs = Flatten(operation.lhs_.get());
+		return AddNode(kind, lhs, Flatten(operation.rhs_.get()));
+	}
+
+	uint32_t AddNames(const vector<runtime::Symbol> &names) {
+		const uint32_t first = Size(program_.names_);
+		program_.names_.insert(program_.names_.end(), names.begin(), names.end());
+		return first;
+	}
+
+	vector<NodeIndex> FlattenAll(const vector<StatementPtr> &statements) {
+		vector<NodeIndex> result;
+		result.reserve(statements.size());
+		for (const StatementPtr &statement : statements) {
+			result.push_back(Flatten(statement.get()));
+		}
+		return result;
+	}
+
+	// Потомки могут сами добавлять списки, поэтому список узла дописывается после них
+	uint32_t AddChildren(const vector<NodeIndex> &children) {
+		const uint32_t first = Size(program_.children_);
+		program_.children_.insert(program_.children_.end(), children.begin(), children.end());
+		return first;
+	}
+
+	uint32_t AddList(const vector<StatementPtr> &statements) {
+		return AddChildren(FlattenAll(statements));
+	}
+
+	// Строит класс, методы которого выполняются по плоскому представлению
+	const runtime::Class& FlattenClass(const runtime::Class &cls) {
+		if (auto it = class_indices_.find(&cls); it != class_indices_.end()) {
+			return *program_.classes_[it->second].TryAs<runtime::Class>();
+		}
+		const runtime::Class *parent = nullptr;
+		if (cls.GetParent() != nullptr) {
+			parent = &FlattenClass(*cls.GetParent());
+		}
+		vector<runtime::Method> methods;
+		cls.BuildMethods();
+		for (const runtime::Method &method : cls.GetMethods()) {
+			methods.push_back( { method.name, method.formal_params, make_unique<FlatMethodBody>(
+					program_, Flatten(method.body.get())), method.frame_size });
+		}
+		program_.classes_.push_back(
+				ObjectHolder::Own(runtime::Class(cls.GetName(), move(methods), parent)));
+		class_indices_[&cls] = Size(program_.classes_) - 1;
+		const auto &flat_cls = *program_.classes_.back().TryAs<runtime::Class>();
+		for (size_t i = 0; i < cls.GetMethods().size(); ++i) {
+			flat_methods_[&cls.GetMethods()[i]] = &flat_cls.GetMethods()[i];
+		}
+		return flat_cls;
+	}
+};
+
+FlatProgram::FlatProgram(const Statement &root) {
+	// Каждый объект арены программы становится одним узлом
+	if (const auto *program = dynamic_cast<const Program*>(&root)) {
+		nodes_.reserve(program->GetArena().GetStats().object_count);
+	}
+	Flattener flattener(*this);
+	root_ = flattener.Flatten(&root);
+	flattener.BindMethods();
+}
+
+ObjectHolder FlatProgram::Execute(Closure &closure, Context &context) {
+	Run(root_, closure, context, nullptr);
+	return {};
+}
+
+bool FlatProgram::Run(NodeIndex index, Closure &closure, Context &context,
+		ObjectHolder *result) {
+	const Node &node = nodes_[index];
+	switch (node.kind) {
+	case Kind::Compound:
+		for (uint32_t i = node.a; i < node.a + node.b; ++i) {
+			if (Run(children_[i], closure, context, result)) {
+				return true;
+			}
+		}
+		return false;
+	case Kind::IfElse: {
+		const NodeIndex body = EvaluateNodeCondition(node.a, closure, context) ? node.b : node.c;
+		return body != NO_NODE && Run(body, closure, context, result);
+	}
+	case Kind::Return:
+		if (result == nullptr) {
+			throw ReturnException(nullptr);
+		}
+		*result = ExecuteNode(node.a, closure, context);
+		return true;
+	default:
+		ExecuteNode(index, closure, context);
+		return false;
+	}
+}
+
+bool FlatProgram::EvaluateNodeCondition(NodeIndex index, Closure &closure, Context &context) {
+	const Node &node = nodes_[index];
+	switch (node.kind) {
+	case Kind::Const:
+		return runtime::IsTrue(constants_[node.a]);
+	case Kind::Or:
+		return EvaluateNodeCondition(node.a, closure, context)
+				|| EvaluateNodeCondition(node.b, closure, context);
+	case Kind::And:
+		return EvaluateNodeCondition(node.a, closure, context)
+				&& EvaluateNodeCondition(node.b, closure, context);
+	case Kind::Not:
+		return !EvaluateNodeCondition(node.a, closure, context);
+	case Kind::Equal: {
+		const ObjectHolder lhs = ExecuteNode(node.a, closure, context);
+		return Equal::Apply(lhs, ExecuteNode(node.b, closure, context), context);
+	}
+	case Kind::NotEqual: {
+		const ObjectHolder lhs = ExecuteNode(node.a, closure, context);
+		return NotEqual::Apply(lhs, ExecuteNode(node.b, closure, context), context);
+	}
+	case Kind::Less: {
+		const ObjectHolder lhs = ExecuteNode(node.a, closure, context);
+		return Less::Apply(lhs, ExecuteNode(node.b, closure, context), context);
+	}
+	case Kind::Greater: {
+		const ObjectHolder lhs = ExecuteNode(node.a, closure, context);
+		return Greater::Apply(lhs, ExecuteNode(node.b, closure, context), context);
+	}
+	case Kind::LessOrEqual: {
+		const ObjectHolder lhs = ExecuteNode(node.a, closure, context);
+		return LessOrEqual::Apply(lhs, ExecuteNode(node.b, closure, context), context);
+	}
+	case Kind::GreaterOrEqual: {
+		const ObjectHolder lhs = ExecuteNode(node.a, closure, context);
+		return GreaterOrEqual::Apply(lhs, ExecuteNode(node.b, closure, context), context);
+	}
+	default:
+		return runtime::IsTrue(ExecuteNode(index, closure, context));
+	}
+}
+
+ObjectHolder FlatProgram::ExecuteNode(NodeIndex index, Closure &closure, Context &context) {
+	const Node &node = nodes_[index];
+	switch (node.kind) {
+	case Kind::Const:
+		return constants_[node.a];
+	case Kind::None:
+		return {};
+	case Kind::Variable:
+		return ExecuteVariable(node, closure);
+	case Kind::Assignment:
+		if (node.c != NO_SLOT) {
+			return *(closure.slots[node.c] = ExecuteNode(node.b, closure, context));
+		}
+		return closure[runtime::Symbol::FromId(node.a)] = ExecuteNode(node.b, closure, context);
+	case Kind::FieldAssignment:
+		return ExecuteFieldAssignment(node, closure, context);
+	case Kind::Print:
+		ExecutePrint(node, closure, context);
+		return {};
+	case Kind::MethodCall:
+	case Kind::BoundMethodCall:
+		return ExecuteMethodCall(node, closure, context);
+	case Kind::NewInstance:
+		return ExecuteNewInstance(node, closure, context);
+	case Kind::Stringify:
+		return Stringify::Apply(ExecuteNode(node.a, closure, context), context);
+	case Kind::Add: {
+		const ObjectHolder lhs = ExecuteNode(node.a, closure, context);
+		return Add::Apply(lhs, ExecuteNode(node.b, closure, context), context);
+	}
+	case Kind::Sub: {
+		const ObjectHolder lhs = ExecuteNode(node.a, closure, context);
+		return Sub::Apply(lhs, ExecuteNode(node.b, closure, context), context);
+	}
+	case Kind::Mult: {
+		const ObjectHolder lhs = ExecuteNode(node.a, closure, context);
+		return Mult::Apply(lhs, ExecuteNode(node.b, closure, context), context);
+	}
+	case Kind::Div: {
+		const ObjectHolder lhs = ExecuteNode(node.a, closure, context);
+		return Div::Apply(lhs, ExecuteNode(node.b, closure, context), context);
+	}
+	case Kind::Or:
+	case Kind::And:
+	case Kind::Not:
+		return ObjectHolder::Own(runtime::Bool(EvaluateNodeCondition(index, closure, context)));
+	case Kind::Negate:
+		return Negate::Apply(ExecuteNode(node.a, closure, context), context);
+	case Kind::Equal: {
+		const ObjectHolder lhs = ExecuteNode(node.a, closure, context);
+		return Comparison::MakeBool(Equal::Apply(lhs, ExecuteNode(node.b, closure, context),
+				context));
+	}
+	case Kind::NotEqual: {
+		const ObjectHolder lhs = ExecuteNode(node.a, closure, context);
+		return Comparison::MakeBool(NotEqual::Apply(lhs, ExecuteNode(node.b, closure, context),
+				context));
+	}
+	case Kind::Less: {
+		const ObjectHolder lhs = ExecuteNode(node.a, closure, context);
+		return Comparison::MakeBool(Less::Apply(lhs, ExecuteNode(node.b, closure, context),
+				context));
+	}
+	case Kind::Greater: {
+		const ObjectHolder lhs = ExecuteNode(node.a, closure, context);
+		return Comparison::MakeBool(Greater::Apply(lhs, ExecuteNode(node.b, closure, context),
+				context));
+	}
+	case Kind::LessOrEqual: {
+		const ObjectHolder lhs = ExecuteNode(node.a, closure, context);
+		return Comparison::MakeBool(LessOrEqual::Apply(lhs,
+				ExecuteNode(node.b, closure, context), context));
+	}
+	case Kind::GreaterOrEqual: {
+		const ObjectHolder lhs = ExecuteNode(node.a, closure, context);
+		return Comparison::MakeBool(GreaterOrEqual::Apply(lhs,
+				ExecuteNode(node.b, closure, context), context));
+	}
+	case Kind::MethodBody: {
+		ObjectHolder result;
+		Run(node.a, closure, context, &result);
+		return result;
+	}
+	case Kind::ClassDefinition: {
+		const auto &cls = *classes_[node.a].TryAs<runtime::Class>();
+		closure[cls.GetName()] = ObjectHolder::Own(runtime::ClassInstance(cls));
+		return {};
+	}
+	case Kind::Compound:
+	case Kind::IfElse:
+	case Kind::Return: {
+		ObjectHolder result;
+		Run(index, closure, context, &result);
+		return {};
+	}
+	}
+	throw logic_error("Unknown kind of a flat node"s);
+}
+
+// Редкие и громоздкие узлы вычисляются отдельными функциями, чтобы кадр стека ExecuteNode,
+// который вызывается рекурсивно для каждого узла, оставался небольшим
+ObjectHolder FlatProgram::ExecuteFieldAssignment(const Node &node, Closure &closure,
+		Context &context) {
+	const ObjectHolder object = ExecuteVariable(nodes_[node.a], closure);
+	ObjectHolder value = ExecuteNode(node.c, closure, context);
+	const runtime::Symbol field = runtime::Symbol::FromId(node.b);
+	auto *instance = object.TryAs<runtime::ClassInstance>();
+	if (instance == nullptr) {
+		throw runtime_error("Field "s + field.Name()
+				+ " is assigned to a value that is not an object"s);
+	}
+	return instance->Fields()[field] = move(value);
+}
+
+void FlatProgram::ExecutePrint(const Node &node, Closure &closure, Context &context) {
+	for (uint32_t i = node.a; i < node.a + node.b; ++i) {
+		if (i != node.a) {
+			context.GetOutputStream() << ' ';
+		}
+		Print::PrintValue(ExecuteNode(children_[i], closure, context), context);
+	}
+	context.GetOutputStream() << endl;
+}
+
+ObjectHolder FlatProgram::ExecuteMethodCall(const Node &node, Closure &closure,
+		Context &context) {
+	const vector<ObjectHolder> args = ExecuteList(node.a, node.b, closure, context);
+	const ObjectHolder object = ExecuteNode(children_[node.a + node.b], closure, context);
+	const runtime::Method *bound_method = node.kind == Kind::BoundMethodCall ?
+			bound_methods_[node.c] : nullptr;
+	const runtime::Symbol method = bound_method != nullptr ? bound_method->name :
+			runtime::Symbol::FromId(node.c);
+	auto *instance = object.TryAs<runtime::ClassInstance>();
+	if (instance == nullptr) {
+		throw runtime_error("Method "s + method.Name()
+				+ " is called on a value that is not an object"s);
+	}
+	if (bound_method != nullptr) {
+		return instance->Call(*bound_method, args, context);
+	}
+	return instance->Call(method, args, context);
+}
+
+ObjectHolder FlatProgram::ExecuteNewInstance(const Node &node, Closure &closure,
+		Context &context) {
+	runtime::ClassInstance &instance = instances_[node.a];
+	if (instance.HasMethod(INIT_METHOD, node.c)) {
+		instance.Call(INIT_METHOD, ExecuteList(node.b, node.c, closure, context), context);
+	}
+	return ObjectHolder::Share(instance);
+}
+
+// Вычисляет цепочку полей id1.id2.id3 так же, как VariableValue
+ObjectHolder FlatProgram::ExecuteVariable(const Node &node, const Closure &closure) const {
+	const Closure *scope = &closure;
+	ObjectHolder result;
+	for (uint32_t i = node.a; i < node.a + node.b; ++i) {
+		if (i == node.a && node.c != NO_SLOT) {
+			const optional<ObjectHolder> &value = closure.slots[node.c];
+			if (!value) {
+				throw runtime_error("Not implemented"s);
+			}
+			result = *value;
+		} else if (auto it = scope->find(names_[i]); it != scope->end()) {
+			result = it->second;
+		} else {
+			throw runtime_error("Not implemented"s);
+		}
+		if (const auto *instance = result.TryAs<runtime::ClassInstance>()) {
+			scope = &instance->Fields();
+		}
+	}
+	return result;
+}
+
+vector<ObjectHolder> FlatProgram::ExecuteList(uint32_t first, uint32_t count,
+		Closure &closure, Context &context) {
+	vector<ObjectHolder> result;
+	result.reserve(count);
+	for (uint32_t i = first; i < first + count; ++i) {
+		result.push_back(ExecuteNode(children_[i], closure, context));
+	}
+	return result;
+}
+
+}  // namespace ast
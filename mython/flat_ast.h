@@ -0,0 +1,154 @@
+#pragma once
+
+#include "statement.h"
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+namespace ast {
+
+/*
+Плоское представление программы. Все узлы лежат подряд в одном векторе и ссылаются на потомков
+32-битными номерами, а не указателями. Узлы записаны в порядке вычисления: потомки раньше
+родителя, инструкции составной инструкции - друг за другом, поэтому при выполнении программа
+читает память в основном последовательно.
+
+Плоская программа строится по дереву, созданному парсером, и не зависит от него: константы,
+классы и объекты, которые создаёт NewInstance, копируются. Методы классов тоже выполняются
+по плоскому представлению
+*/
+class FlatProgram : public Statement {
+public:
+    using NodeIndex = uint32_t;
+    // Номер отсутствующего узла, например пустой ветки else
+    static constexpr NodeIndex NO_NODE = UINT32_MAX;
+
+    enum class Kind : uint8_t {
+        Const,            // a - номер в constants_
+        None,
+        Variable,         // a, b - начало и длина цепочки имён в names_, c - слот кадра
+        Assignment,       // a - номер символа переменной, b - значение, c - слот кадра
+        FieldAssignment,  // a - узел Variable объекта, b - номер символа поля, c - значение
+        Print,            // a, b - начало и длина списка аргументов в children_
+        MethodCall,       // a, b - аргументы в children_, за ними объект; c - номер символа метода
+        BoundMethodCall,  // a, b - как у MethodCall; c - номер метода в bound_methods_
+        NewInstance,      // a - номер в instances_; b, c - аргументы в children_
+        Stringify,        // a - аргумент
+        Add,              // a, b - аргументы бинарных операций
+        Sub,
+        Mult,
+        Div,
+        Or,
+        And,
+        Not,              // a - аргумент
+        Negate,           // a - аргумент
+        Equal,            // a, b - аргументы сравнений
+        NotEqual,
+        Less,
+        Greater,
+        LessOrEqual,
+        GreaterOrEqual,
+        Compound,         // a, b - инструкции в children_
+        MethodBody,       // a - тело метода
+        Return,           // a - возвращаемое выражение
+        ClassDefinition,  // a - номер в classes_
+        IfElse,           // a - условие, b и c - ветки if и else (могут быть NO_NODE)
+    };
+
+    struct Node {
+        Kind kind = Kind::None;
+        uint32_t a = 0;
+        uint32_t b = 0;
+        uint32_t c = 0;
+    };
+
+    // Строит плоское представление дерева с корнем root. Если root - программа (ast::Program),
+    // используется её корневая инструкция. Отложенный разбор тел методов
+    // (ParseOptions::lazy_methods) выполняется при построении. Для узлов неизвестного типа
+    // выбрасывается исключение std::invalid_argument
+    explicit FlatProgram(const Statement& root);
+
+    FlatProgram(const FlatProgram&) = delete;
+    FlatProgram& operator=(const FlatProgram&) = delete;
+
+    // Выполняет программу. Как и для дерева, инструкция return вне метода выбрасывает
+    // исключение ReturnException, а её выражение не вычисляется
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+    // Вычисляет узел с номером index и возвращает его значение
+    runtime::ObjectHolder ExecuteNode(NodeIndex index, runtime::Closure& closure,
+                                      runtime::Context& context);
+
+    // Вычисляет узел с номером index как условие (см. runtime::Executable::EvaluateCondition)
+    bool EvaluateNodeCondition(NodeIndex index, runtime::Closure& closure,
+                               runtime::Context& context);
+
+    [[nodiscard]] const std::vector<Node>& GetNodes() const {
+        return nodes_;
+    }
+
+    [[nodiscard]] NodeIndex GetRoot() const {
+        return root_;
+    }
+
+private:
+    friend class Flattener;
+    friend class ProgramReader;
+    friend class ProgramWriter;
+
+    // Пустая программа, которую заполняет ProgramReader
+    FlatProgram() = default;
+
+    std::vector<Node> nodes_;
+    std::vector<NodeIndex> children_;
+    std::vector<runtime::Symbol> names_;
+    std::vector<runtime::ObjectHolder> constants_;
+    std::vector<runtime::ObjectHolder> classes_;
+    // Методы классов из classes_, с которыми оптимизатор связал вызовы self.method(...)
+    std::vector<const runtime::Method*> bound_methods_;
+    // NewInstance возвращает при каждом вычислении один и тот же объект, как и узел дерева
+    std::deque<runtime::ClassInstance> instances_;
+    NodeIndex root_ = NO_NODE;
+
+    // Выполняет инструкцию. Возвращает true, если была выполнена инструкция return,
+    // её значение записывается в *result. Если result равен nullptr, инструкция выполняется
+    // вне метода и return выбрасывает исключение ReturnException
+    bool Run(NodeIndex index, runtime::Closure& closure, runtime::Context& context,
+             runtime::ObjectHolder* result);
+
+    runtime::ObjectHolder ExecuteFieldAssignment(const Node& node, runtime::Closure& closure,
+                                                 runtime::Context& context);
+    void ExecutePrint(const Node& node, runtime::Closure& closure, runtime::Context& context);
+    runtime::ObjectHolder ExecuteMethodCall(const Node& node, runtime::Closure& closure,
+                                            runtime::Context& context);
+    runtime::ObjectHolder ExecuteNewInstance(const Node& node, runtime::Closure& closure,
+                                             runtime::Context& context);
+    runtime::ObjectHolder ExecuteVariable(const Node& node, const runtime::Closure& closure) const;
+    std::vector<runtime::ObjectHolder> ExecuteList(uint32_t first, uint32_t count,
+                                                   runtime::Closure& closure,
+                                                   runtime::Context& context);
+};
+
+// Тело метода класса, построенного плоской программой
+class FlatMethodBody : public runtime::Executable {
+public:
+    FlatMethodBody(FlatProgram& program, FlatProgram::NodeIndex body)
+        : program_(program)
+        , body_(body) {
+    }
+
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override {
+        return program_.ExecuteNode(body_, closure, context);
+    }
+
+    [[nodiscard]] FlatProgram::NodeIndex GetBody() const {
+        return body_;
+    }
+
+private:
+    FlatProgram& program_;
+    FlatProgram::NodeIndex body_;
+};
+
+}  // namespace ast
@@ -0,0 +1,121 @@
+#include "incremental_lexer.h"
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+using namespace std;
+
+namespace parse {
+
+IncrementalLexer::IncrementalLexer(string_view text, LexerOptions options) :
+		options_(options), lines_(LexLines(text, 0)) {
+	UpdateIndentDeltas(0, lines_.size());
+}
+
+void IncrementalLexer::Edit(size_t first_line, size_t line_count, string_view text) {
+	if (first_line > lines_.size() || line_count > lines_.size() - first_line) {
+		throw out_of_range("Lines "s + to_string(first_line) + " - "s
+				+ to_string(first_line + line_count) + " are out of the text"s);
+	}
+	vector<unique_ptr<Line>> new_lines = LexLines(text, first_line);
+
+	const auto begin = lines_.begin() + static_cast<ptrdiff_t>(first_line);
+	const size_t common = min(line_count, new_lines.size());
+	move(new_lines.begin(), new_lines.begin() + static_cast<ptrdiff_t>(common), begin);
+	if (line_count > common) {
+		lines_.erase(begin + static_cast<ptrdiff_t>(common),
+				begin + static_cast<ptrdiff_t>(line_count));
+	} else {
+		lines_.insert(begin + static_cast<ptrdiff_t>(common),
+				make_move_iterator(new_lines.begin() + static_cast<ptrdiff_t>(common)),
+				make_move_iterator(new_lines.end()));
+	}
+	UpdateIndentDeltas(first_line, new_lines.size());
+}
+
+const TokenBuffer& IncrementalLexer::LineTokens(size_t line) const {
+	return lines_.at(line)->tokens;
+}
+
+int IncrementalLexer::IndentDelta(size_t line) const {
+	return lines_.at(line)->indent_delta;
+}
+
+TokenBuffer IncrementalLexer::Tokens() const {
+	TokenBuffer result;
+	size_t level = 0;
+	for (const unique_ptr<Line> &line : lines_) {
+		if (!line->level) {
+			continue;
+		}
+		for (int i = 0; i < line->indent_delta; ++i) {
+			result.Push<token_type::Indent>();
+		}
+		for (int i = 0; i > line->indent_delta; --i) {
+			result.Push<token_type::Dedent>();
+		}
+		level = *line->level;
+
+		const TokenBuffer &tokens = line->tokens;
+		for (size_t i = 0; i < tokens.Size(); ++i) {
+			result.Push(tokens.At(i));
+		}
+		if (tokens.Size() > 0) {
+			result.Push<token_type::Newline>();
+		}
+	}
+	for (; level > 0; --level) {
+		result.Push<token_type::Dedent>();
+	}
+	result.Push<token_type::Eof>();
+	return result;
+}
+
+// The lines share one copy of the text, their String tokens refer to it
+vector<unique_ptr<IncrementalLexer::Line>> IncrementalLexer::LexLines(string_view text,
+		size_t first_line) const {
+	const auto shared_text = make_shared<const string>(text);
+	Lexer lexer(*shared_text, 0, first_line, options_);
+
+	vector<unique_ptr<Line>> lines;
+	while (true) {
+		auto line = make_unique<Line>();
+		if (!lexer.LexDetachedLine(line->tokens, line->level)) {
+			break;
+		}
+		line->text = shared_text;
+		lines.push_back(move(line));
+	}
+	return lines;
+}
+
+// Returns the indentation of the last line with tokens before the line
+size_t IncrementalLexer::LevelBefore(size_t line) const {
+	while (line > 0) {
+		--line;
+		if (lines_[line]->level) {
+			return *lines_[line]->level;
+		}
+	}
+	return 0;
+}
+
+// Only the given lines and the first line with tokens after them can start at another
+// indentation than before, the deltas of the rest of the lines stay the same
+void IncrementalLexer::UpdateIndentDeltas(size_t first_line, size_t line_count) {
+	size_t level = LevelBefore(first_line);
+	for (size_t i = first_line; i < lines_.size(); ++i) {
+		Line &line = *lines_[i];
+		if (!line.level) {
+			continue;
+		}
+		line.indent_delta = static_cast<int>(*line.level) - static_cast<int>(level);
+		level = *line.level;
+		if (i >= first_line + line_count) {
+			break;
+		}
+	}
+}
+
+}  // namespace parse
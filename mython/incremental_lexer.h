@@ -0,0 +1,60 @@
+#pragma once
+
+#include "lexer.h"
+
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace parse {
+
+// Token stream of a program that is being edited, e.g. in an editor.
+// Tokens are kept per line, so an edit re-lexes only the lines it replaces. Indent and Dedent
+// tokens are stored as the change of indentation before each line with tokens, an edit
+// recomputes it for the new lines and the first line with tokens after them.
+// Lines are the ones Lexer reads: a text of n lines has n - 1 or n symbols '\n'
+class IncrementalLexer {
+public:
+    // Throws LexerError like Lexer does. Edits are lexed with the same options
+    explicit IncrementalLexer(std::string_view text, LexerOptions options = {});
+
+    // Replaces line_count lines starting with first_line by the lines of text.
+    // Throws std::out_of_range for lines that do not exist and LexerError for invalid text,
+    // the tokens are unchanged then
+    void Edit(size_t first_line, size_t line_count, std::string_view text);
+
+    [[nodiscard]] size_t LineCount() const {
+        return lines_.size();
+    }
+
+    // Tokens of the line without Indent, Dedent and Newline. String tokens refer to the text
+    // of the line and stay valid until the line is replaced
+    [[nodiscard]] const TokenBuffer& LineTokens(size_t line) const;
+
+    // Number of Indent (positive) or Dedent (negative) tokens before the tokens of the line
+    [[nodiscard]] int IndentDelta(size_t line) const;
+
+    // Returns the whole token stream, the same one Lexer produces for the current text
+    [[nodiscard]] TokenBuffer Tokens() const;
+
+private:
+    struct Line {
+        std::shared_ptr<const std::string> text;  // shared by the lines of one edit
+        TokenBuffer tokens;
+        std::optional<size_t> level;  // indentation, nullopt for lines that do not change it
+        int indent_delta = 0;
+    };
+
+    LexerOptions options_;
+    // Lines are held by pointers, so that an edit moves only pointers of the lines after it
+    std::vector<std::unique_ptr<Line>> lines_;
+
+    std::vector<std::unique_ptr<Line>> LexLines(std::string_view text, size_t first_line) const;
+    size_t LevelBefore(size_t line) const;
+    void UpdateIndentDeltas(size_t first_line, size_t line_count);
+};
+
+}  // namespace parse
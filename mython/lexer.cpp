@@ -1,11 +1,14 @@
 #include "lexer.h"
+#include "lexer_tables.h"
+#include "scanner.h"
 
 #include <algorithm>
 #include <array>
 #include <charconv>
-#include <unordered_map>
 #include <string_view>
 #include <string>
+#include <thread>
+#include <utility>
 
 using namespace std;
 
@@ -78,91 +81,392 @@ std::ostream& operator<<(std::ostream &os, const Token &rhs) {
 	return os << "Unknown token :("sv;
 }
 
-Lexer::Lexer(std::istream &input) {
-	ParsingData(input);
+namespace {
+
+template <size_t... Kinds>
+array<Token, sizeof...(Kinds)> MakeDefaultTokens(index_sequence<Kinds...>) {
+	return { Token(in_place_index<Kinds>)... };
 }
 
-const Token& Lexer::CurrentToken() const {
-	if (lexer_data.empty()) {
-		throw std::logic_error("Not implemented"s);
+// Tokens without a payload are fully defined by their kind
+const auto DEFAULT_TOKENS = MakeDefaultTokens(make_index_sequence<variant_size_v<TokenBase>>());
+
+}  // namespace
+
+Token TokenBuffer::At(size_t index) const {
+	using namespace token_type;
+
+	switch (kinds_[index]) {
+	case KIND<Number>:
+		return Number { NumberAt(index) };
+	case KIND<Id>:
+		return Id { IdAt(index) };
+	case KIND<Char>:
+		return Char { CharAt(index) };
+	case KIND<String>:
+		return String { StringAt(index) };
+	default:
+		return DEFAULT_TOKENS[kinds_[index]];
 	}
-	return lexer_data[nomber_of_curent_token];
 }
 
-Token Lexer::NextToken() {
-	if (nomber_of_curent_token < (static_cast<size_t>(lexer_data.size()) - 1)) {
-		return lexer_data[++nomber_of_curent_token];
+void TokenBuffer::Push(const Token &token) {
+	using namespace token_type;
+
+	switch (token.index()) {
+	case KIND<Number>:
+		PushNumber(token.As<Number>().value);
+		break;
+	case KIND<Id>:
+		PushId(token.As<Id>().value);
+		break;
+	case KIND<Char>:
+		PushChar(token.As<Char>().value);
+		break;
+	case KIND<String>:
+		PushString(token.As<String>().value);
+		break;
+	default:
+		Append(static_cast<Kind>(token.index()), 0);
 	}
-	return lexer_data[nomber_of_curent_token];
 }
 
-bool Lexer::IsNumber(char ch) const {
-	if (ch >= '0' && ch <= '9') {
-		return true;
+void TokenBuffer::PushNumber(int64_t value) {
+	Append(KIND<token_type::Number>, static_cast<uint32_t>(numbers_.size()));
+	numbers_.push_back(value);
+}
+
+void TokenBuffer::PushId(runtime::Symbol value) {
+	Append(KIND<token_type::Id>, value.Id());
+}
+
+void TokenBuffer::PushChar(char value) {
+	Append(KIND<token_type::Char>, static_cast<unsigned char>(value));
+}
+
+void TokenBuffer::PushString(string_view value) {
+	Append(KIND<token_type::String>, static_cast<uint32_t>(strings_.size()));
+	strings_.push_back(value);
+}
+
+void TokenBuffer::PushStringCopy(string_view value) {
+	PushString(CopyString(value));
+}
+
+// Ids and chars are stored in their payloads, tokens without a value have none
+void TokenBuffer::PushCopy(const TokenBuffer &other, size_t index) {
+	switch (other.kinds_[index]) {
+	case KIND<token_type::Number>:
+		PushNumber(other.NumberAt(index));
+		break;
+	case KIND<token_type::String>:
+		PushStringCopy(other.StringAt(index));
+		break;
+	default:
+		Append(other.kinds_[index], other.payloads_[index]);
 	}
-	return false;
 }
 
-bool Lexer::IsLegalSymbolForId(char ch) const {
-	if ((ch >= 'A' && ch <= 'Z') || (ch >= 'a' && ch <= 'z') || ch == '_') {
-		return true;
+void TokenBuffer::Reserve(size_t token_count) {
+	kinds_.reserve(token_count);
+	payloads_.reserve(token_count);
+}
+
+void TokenBuffer::Clear() {
+	kinds_.clear();
+	payloads_.clear();
+	numbers_.clear();
+	strings_.clear();
+	chunk_index_ = 0;
+	chunk_used_ = 0;
+	long_strings_.clear();
+}
+
+string_view TokenBuffer::CopyString(string_view value) {
+	if (chunk_index_ < string_chunks_.size()
+			&& chunk_used_ + value.size() > ChunkSize(chunk_index_)) {
+		++chunk_index_;
+		chunk_used_ = 0;
 	}
-	return false;
+	char *data = nullptr;
+	if (value.size() > ChunkSize(chunk_index_)) {
+		data = long_strings_.emplace_back(new char[value.size()]).get();
+	} else {
+		if (chunk_index_ == string_chunks_.size()) {
+			string_chunks_.emplace_back(new char[ChunkSize(chunk_index_)]);
+		}
+		data = string_chunks_[chunk_index_].get() + chunk_used_;
+		chunk_used_ += value.size();
+	}
+	copy(value.begin(), value.end(), data);
+	return { data, value.size() };
+}
+
+Lexer::Lexer(std::istream &input, LexerOptions options) :
+		input_(&input), buffer_(BUFFER_SIZE), options_(options) {
+	Fill();
+}
+
+Lexer::Lexer(std::string_view source, LexerOptions options) :
+		source_(source), buffer_end_(source.size()), input_exhausted_(true), options_(options) {
+	Fill();
+}
+
+Lexer::Lexer(std::string_view source, size_t thread_count, LexerOptions options) :
+		source_(source), buffer_end_(source.size()), input_exhausted_(true), options_(options) {
+	const size_t part_count = clamp<size_t>(source.size() / MIN_PART_SIZE, 1,
+			max<size_t>(thread_count, 1));
+	if (part_count == 1) {
+		Fill();
+		return;
+	}
+
+	// Parts end right after a newline, so no token, string or comment crosses a seam.
+	// The indentation a part starts with is that of the last line with tokens before it
+	vector<size_t> bounds(part_count + 1, source.size());
+	bounds[0] = 0;
+	for (size_t i = 1; i < part_count; ++i) {
+		const size_t newline = source.find('\n',
+				max(bounds[i - 1], i * source.size() / part_count));
+		bounds[i] = newline == string_view::npos ? source.size() : newline + 1;
+	}
+
+	vector<TokenBuffer> parts(part_count);
+	vector<exception_ptr> errors(part_count);
+	auto lex_part = [&](size_t i) {
+		try {
+			Lexer part_lexer(source.substr(bounds[i], bounds[i + 1] - bounds[i]),
+					IndentBefore(source, bounds[i]), 0, options_);
+			part_lexer.LexPart(parts[i], i + 1 == part_count);
+		} catch (...) {
+			errors[i] = current_exception();
+		}
+	};
+	vector<thread> threads;
+	for (size_t i = 1; i < part_count; ++i) {
+		threads.emplace_back(lex_part, i);
+	}
+	lex_part(0);
+	for (thread &t : threads) {
+		t.join();
+	}
+
+	// Lexing the source in one piece reports the first error with its line number
+	// after the tokens before it, just like the lexer does for any other input
+	if (any_of(errors.begin(), errors.end(), [](const exception_ptr &error) {
+		return error != nullptr;
+	})) {
+		Fill();
+		return;
+	}
+	lexed_parts_ = move(parts);
+	eof_ = true;
+	Fill();
+}
+
+Lexer::Lexer(std::string_view part, size_t indent, size_t lines_before, LexerOptions options) :
+		source_(part), buffer_end_(part.size()), input_exhausted_(true), options_(options),
+		line_counter_(lines_before), offset(indent) {
 }
 
-void Lexer::WriteWord(string &word) {
-	if (!word.empty()) {
-		if (IsNumber(word[0])) {
-			for (const char &ch : word) {
-				if (!IsNumber(ch)) {
-					throw;
-				}
+Lexer::Lexer(TokenBuffer tokens) :
+		input_exhausted_(true), tokens_(move(tokens)), eof_(true) {
+}
+
+void Lexer::LexPart(TokenBuffer &tokens, bool last) {
+	tokens.Reserve(source_.size() / BYTES_PER_TOKEN);
+	while (ReadLine()) {
+		LexLine(tokens);
+	}
+	if (last) {
+		for (; offset > 0; --offset) {
+			tokens.Push<token_type::Dedent>();
+		}
+		tokens.Push<token_type::Eof>();
+	}
+	eof_ = true;
+}
+
+// Returns the indentation level of the last line with tokens that ends before line_begin
+size_t Lexer::IndentBefore(std::string_view source, size_t line_begin) {
+	while (line_begin > 0) {
+		const size_t line_end = line_begin - 1;
+		const size_t newline = line_end == 0 ? string_view::npos : source.rfind('\n', line_end - 1);
+		line_begin = newline == string_view::npos ? 0 : newline + 1;
+
+		const char *first = SkipSpaces(source.data() + line_begin, source.data() + line_end);
+		if (first != source.data() + line_end && *first != '#') {
+			return static_cast<size_t>(first - source.data() - line_begin) / 2;
+		}
+	}
+	return 0;
+}
+
+const Token& Lexer::CurrentToken() const {
+	current_token_ = tokens_.At(position_);
+	return current_token_;
+}
+
+const Token& Lexer::NextToken() {
+	Advance();
+	return CurrentToken();
+}
+
+void Lexer::Advance() {
+	if (position_ + 1 < tokens_.Size()) {
+		++position_;
+	} else if (!tokens_.Is<token_type::Eof>(position_)) {
+		Fill();
+	}
+}
+
+void Lexer::CopyCurrentToken(TokenBuffer &tokens) const {
+	tokens.PushCopy(tokens_, position_);
+}
+
+// Lexes the following block of lines into the spare buffer and makes it current.
+// An error is reported only after the tokens lexed before it have been read
+void Lexer::Fill() {
+	if (error_) {
+		rethrow_exception(error_);
+	}
+	// The buffers of parts that are done are kept, so values read from them stay valid
+	while (next_part_ < lexed_parts_.size()) {
+		swap(tokens_, lexed_parts_[next_part_++]);
+		if (tokens_.Size() > 0) {
+			position_ = 0;
+			return;
+		}
+	}
+
+	next_tokens_.Clear();
+	try {
+		while (!eof_ && next_tokens_.Size() < BLOCK_TOKENS) {
+			if (ReadLine()) {
+				LexLine(next_tokens_);
+				continue;
 			}
-			lexer_data.push_back(token_type::Number { stoi(word) });
-		} else {
-			lexer_data.push_back(ParseToken(word));
+			for (; offset > 0; --offset) {
+				next_tokens_.Push<token_type::Dedent>();
+			}
+			next_tokens_.Push<token_type::Eof>();
+			eof_ = true;
 		}
-		word = ""s;
-		is_first_line = false;
+	} catch (...) {
+		error_ = current_exception();
+	}
+	if (next_tokens_.Size() == 0) {
+		rethrow_exception(error_);
 	}
+	swap(tokens_, next_tokens_);
+	position_ = 0;
 }
 
-void Lexer::WriteMathWord(string &math_word) {
-	if (!math_word.empty()) {
-		if (math_word.size() == 1) {
-			lexer_data.push_back(token_type::Char { math_word[0] });
-		} else {
-			lexer_data.push_back(ParseToken(math_word));
+const char* Lexer::Data() const {
+	return input_ != nullptr ? buffer_.data() : source_.data();
+}
+
+// Makes the next line of the input current, reading more data into the buffer when the
+// line is not complete yet. Returns false when the input is over
+bool Lexer::ReadLine() {
+	size_t search_from = buffer_begin_;
+	const char *newline = nullptr;
+	bool non_ascii = false;
+	while (true) {
+		if (search_from < buffer_end_) {
+			const char *data_end = Data() + buffer_end_;
+			newline = FindNewlineOrNonAscii(Data() + search_from, data_end);
+			if (newline != data_end && *newline != '\n') {
+				non_ascii = true;
+				newline = FindNewline(newline, data_end);
+			}
+			if (newline == data_end) {
+				newline = nullptr;
+			}
+		}
+		if (newline != nullptr || input_exhausted_) {
+			break;
+		}
+		if (buffer_begin_ > 0) {
+			copy(buffer_.begin() + buffer_begin_, buffer_.begin() + buffer_end_,
+					buffer_.begin());
+			buffer_end_ -= buffer_begin_;
+			buffer_begin_ = 0;
+		}
+		if (buffer_end_ == buffer_.size()) {
+			buffer_.resize(buffer_.size() * 2);
 		}
-		math_word = ""s;
-		is_first_line = false;
+		search_from = buffer_end_;
+		input_->read(buffer_.data() + buffer_end_, buffer_.size() - buffer_end_);
+		buffer_end_ += static_cast<size_t>(input_->gcount());
+		if (input_->gcount() == 0) {
+			input_exhausted_ = true;
+		}
+	}
+	if (newline == nullptr && buffer_begin_ == buffer_end_) {
+		return false;
 	}
+
+	line_begin_ = Data() + buffer_begin_;
+	line_end_ = newline != nullptr ? newline : Data() + buffer_end_;
+	cur_ = line_begin_;
+	buffer_begin_ = static_cast<size_t>(line_end_ - Data()) + (newline != nullptr ? 1 : 0);
+	++line_counter_;
+
+	// Only lines with non-ASCII symbols are decoded, the search for newlines finds them
+	if (non_ascii) {
+		const char *invalid = FindInvalidUtf8(line_begin_, line_end_);
+		if (invalid != line_end_) {
+			throw LexerError("Invalid UTF-8 in line "s + to_string(line_counter_) + ", symbol "s
+					+ to_string(invalid - line_begin_));
+		}
+	}
+	return true;
 }
 
-void Lexer::WriteToString(const char symbol) {
-	if (exception_symbol) {
-		str_line += Unescape(symbol);
-		exception_symbol = false;
+bool Lexer::LexDetachedLine(TokenBuffer &tokens, optional<size_t> &level) {
+	if (!ReadLine()) {
+		return false;
+	}
+	size_t line_offset = 0;
+	if (SkipIndentation(line_offset)) {
+		level = line_offset;
+		LexLineTokens(tokens);
 	} else {
-		str_line += symbol;
+		level.reset();
 	}
-	is_first_line = false;
+	return true;
 }
 
-void Lexer::WriteWords(std::string &word, std::string &math_word) {
-	WriteWord(word);
-	WriteMathWord(math_word);
+// Moves to the first symbol of the current line and gets its indentation level.
+// Returns false for lines without tokens
+bool Lexer::SkipIndentation(size_t &level) {
+	const char *first = SkipSpaces(cur_, line_end_);
+	if (first == line_end_ || *first == '#') {
+		cur_ = line_end_;
+		return false;
+	}
+	level = static_cast<size_t>(first - cur_) / 2;
+	cur_ = first;
+	return true;
 }
 
-void Lexer::NewLineProcessing() {
-	WriteWords(word, math_word);
-	if (!is_first_line && !is_new_line) {
-		lexer_data.push_back(token_type::Newline());
-		previous_line_offset = offset;
-		offset = 0;
+// Computes the indentation of a freshly read line and adds Indent/Dedent tokens.
+// Lines that contain only spaces or a comment do not change the indentation,
+// false is returned for them
+bool Lexer::CheckOffset(TokenBuffer &tokens) {
+	size_t line_offset = 0;
+	if (!SkipIndentation(line_offset)) {
+		return false;
+	}
+	for (size_t level = offset; level < line_offset; ++level) {
+		tokens.Push<token_type::Indent>();
 	}
-	is_new_line = true;
-	coment = false;
+	for (size_t level = line_offset; level < offset; ++level) {
+		tokens.Push<token_type::Dedent>();
+	}
+	offset = line_offset;
+	return true;
 }
 
 string Lexer::Unescape(const char symbol) {
@@ -181,6 +485,9 @@ string Lexer::Unescape(const char symbol) {
 	case '"':
 		result_symbol += '"';
 		break;
+	case '\\':
+		result_symbol += '\\';
+		break;
 	default:
 		result_symbol += "\\";
 		result_symbol += symbol;
@@ -188,213 +495,128 @@ string Lexer::Unescape(const char symbol) {
 	return result_symbol;
 }
 
-void Lexer::QuotesProcessing(const char &symbol, bool &open) {
-	if (!open) {
-		WriteWords(word, math_word);
-		open = true;
-	} else {
-		if (exception_symbol) {
-			str_line += Unescape(symbol);
-			exception_symbol = false;
-		} else {
-			open = false;
-			lexer_data.push_back(token_type::String { str_line });
-			str_line = "";
-		}
+// Lexes the current line, a line that produces tokens ends with Newline
+void Lexer::LexLine(TokenBuffer &tokens) {
+	if (CheckOffset(tokens) && LexLineTokens(tokens)) {
+		tokens.Push<token_type::Newline>();
 	}
 }
 
-bool Lexer::CheckOffset(const char &symbol) {
-	if (symbol == ' ') {
-		++offset_buff;
-		if (offset_buff == 2) {
-			offset_buff = 0;
-			++offset;
-			if (previous_line_offset < offset) {
-				lexer_data.push_back(token_type::Indent());
-			}
-		}
-		return true;
-	} else {
-		if (symbol != '\n' && symbol != '#') {
-			if ((previous_line_offset > offset)) {
-				for (size_t i = previous_line_offset; i > offset; --i) {
-					lexer_data.push_back(token_type::Dedent());
-				}
+// Lexes the rest of the current line, returns whether it had any tokens
+bool Lexer::LexLineTokens(TokenBuffer &tokens) {
+	const size_t first_token = tokens.Size();
+
+	while (cur_ != line_end_) {
+		const char symbol = *cur_;
+		switch (ClassOf(symbol)) {
+		case CharClass::SKIP:
+			++cur_;
+			continue;
+		case CharClass::COMMENT:
+			cur_ = line_end_;
+			continue;
+		case CharClass::QUOTE:
+			LexString(tokens);
+			continue;
+		case CharClass::MATH:
+			LexMathWord(tokens);
+			continue;
+		case CharClass::TRIGGER:
+			++cur_;
+			tokens.PushChar(symbol);
+			continue;
+		case CharClass::LETTER:
+		case CharClass::DIGIT:
+			LexWord(tokens);
+			continue;
+		case CharClass::INVALID:
+			if (options_.utf8_ids && static_cast<unsigned char>(symbol) >= 0x80) {
+				LexWord(tokens);
+				continue;
 			}
-			is_new_line = false;
-		} else {
-			offset = previous_line_offset;
+			break;
 		}
+		ThrowInvalidSymbol();
 	}
-	return false;
+	return tokens.Size() > first_token;
 }
 
-void Lexer::ParsingData(std::istream &input) {
-	using namespace std::literals;
-
-	string line="";
-	char symbol;
-	size_t line_counter=0;
-	while (getline(input, line)) {
-		++line_counter;
-		for (size_t i = 0; i < line.size(); ++i) {
-			symbol = line[i];
-
-			if(symbol == 0){
-				continue;
-			}
-
-			if (coment) {
-				continue;
-			}
-
-			if (is_new_line) {
-				if (CheckOffset(symbol)) {
-					continue;
-				}
-			}
-
-			if (symbol == '\\') {
-				exception_symbol = true;
-				continue;
-			}
-
-			if (symbol == '\'' && !double_quote_open) {
-				QuotesProcessing(symbol, single_quote_open);
-				continue;
-			}
-
-			if (single_quote_open) {
-				WriteToString(symbol);
-				continue;
-			}
-
-			if (symbol == '"' && !single_quote_open) {
-				QuotesProcessing(symbol, double_quote_open);
-				continue;
-			}
-			if (double_quote_open) {
-				WriteToString(symbol);
-				continue;
-			}
-
-			if (symbol == '#') {
-				coment = true;
-				continue;
-			}
-
-			if (math_symbols_.count(symbol)) {
-				WriteWord(word);
-				math_word += symbol;
-				if (math_word.size() > 1) {
-					if (keywords_.count(math_word)) {
-						WriteMathWord(math_word);
-					} else {
-						string ch = "";
-						ch += math_word[0];
-						WriteMathWord(ch);
-						ch = "";
-						ch += math_word[1];
-						WriteMathWord(ch);
-						math_word = "";
-					}
-				}
-				continue;
-			}
-
-			if (trigger_symbols_.count(symbol)) {
-				WriteWords(word, math_word);
-				if (symbol != ' ') {
-					lexer_data.push_back(token_type::Char { symbol });
-				}
-				continue;
-			}
-
-			if (!math_word.empty()) {
-				WriteWords(word, math_word);
-			}
-
-			if (IsLegalSymbolForId(symbol) || IsNumber(symbol)) {
-				word += symbol;
-			} else {
-				string err="";
-				if(symbol < 0){
-					err += "Most likely the wrong language is chosen\n";
-				}
-					err +="Invalid line nomber:" + to_string(line_counter) +
-							"\nFirst error symbol nomber:" + to_string(i) +
-							"\nInvalid line is:" + line;
-				throw std::invalid_argument( err );
-			}
-
+void Lexer::LexWord(TokenBuffer &tokens) {
+	const char *begin = cur_;
+	cur_ = FindIdEnd(cur_, line_end_);
+	// The kernels stop at non-ASCII bytes. Lines are checked to be valid UTF-8 before they are
+	// lexed, so such bytes make up whole symbols
+	while (options_.utf8_ids && cur_ != line_end_ && static_cast<unsigned char>(*cur_) >= 0x80) {
+		while (++cur_ != line_end_ && static_cast<unsigned char>(*cur_) >= 0x80) {
 		}
-		NewLineProcessing();
+		cur_ = FindIdEnd(cur_, line_end_);
 	}
-	WriteWords(word, math_word);
-	if (!is_new_line) {
-		lexer_data.push_back(token_type::Newline());
+	const string_view word(begin, static_cast<size_t>(cur_ - begin));
+
+	if (ClassOf(word[0]) == CharClass::DIGIT) {
+		int64_t value = 0;
+		const auto [end, error] = from_chars(begin, cur_, value);
+		if (error != errc() || end != cur_) {
+			throw LexerError("Invalid number "s + string(word) + " in line "s
+					+ to_string(line_counter_));
+		}
+		tokens.PushNumber(value);
+	} else if (const Token *keyword = FindKeyword(word)) {
+		tokens.Push(*keyword);
+	} else {
+		tokens.PushId(runtime::Symbol(word));
 	}
-	CheckOffset('e');
-	lexer_data.push_back(token_type::Eof());
 }
 
-Token Lexer::ParseToken(std::string_view word) {
-	if (word == "class"s) {
-		return token_type::Class();
-	}
-	if (word == "return"s) {
-		return token_type::Return();
-	}
-	if (word == "if"s) {
-		return token_type::If();
-	}
-	if (word == "else"s) {
-		return token_type::Else();
-	}
-	if (word == "def"s) {
-		return token_type::Def();
-	}
-	if (word == "\n"s) {
-		return token_type::Newline();
-	}
-	if (word == "print"s) {
-		return token_type::Print();
-	}
-	if (word == "and"s) {
-		return token_type::And();
-	}
-	if (word == "or"s) {
-		return token_type::Or();
-	}
-	if (word == "not"s) {
-		return token_type::Not();
-	}
-	if (word == "=="s) {
-		return token_type::Eq();
-	}
-	if (word == "!="s) {
-		return token_type::NotEq();
-	}
-	if (word == "<="s) {
-		return token_type::LessOrEq();
-	}
-	if (word == "!="s) {
-		return token_type::NotEq();
-	}
-	if (word == ">="s) {
-		return token_type::GreaterOrEq();
+// Two math symbols in a row form an operator like "==" or "<=" when there is one
+void Lexer::LexMathWord(TokenBuffer &tokens) {
+	const char *begin = cur_++;
+	if (cur_ != line_end_ && ClassOf(*cur_) == CharClass::MATH) {
+		if (const Token *op = FindKeyword(string_view(begin, 2))) {
+			++cur_;
+			tokens.Push(*op);
+			return;
+		}
 	}
-	if (word == "None"s) {
-		return token_type::None();
+	tokens.PushChar(*begin);
+}
+
+// Strings without escape sequences refer to the source text when it is in memory.
+// The lines of std::istream input are overwritten, so their strings are copied
+void Lexer::LexString(TokenBuffer &tokens) {
+	const char quote = *cur_++;
+	const char *begin = cur_;
+	cur_ = FindStringStop(cur_, line_end_, quote);
+	if (cur_ != line_end_ && *cur_ == quote) {
+		const string_view value(begin, static_cast<size_t>(cur_++ - begin));
+		if (input_ != nullptr) {
+			tokens.PushStringCopy(value);
+		} else {
+			tokens.PushString(value);
+		}
+		return;
 	}
-	if (word == "True"s) {
-		return token_type::True();
+
+	// Runs between escape sequences are copied in bulk
+	unescaped_.assign(begin, cur_);
+	while (cur_ != line_end_ && *cur_ == '\\' && ++cur_ != line_end_) {
+		unescaped_ += Unescape(*cur_++);
+		const char *run = cur_;
+		cur_ = FindStringStop(cur_, line_end_, quote);
+		unescaped_.append(run, cur_);
 	}
-	if (word == "False"s) {
-		return token_type::False();
+	if (cur_ == line_end_) {
+		throw LexerError("Unterminated string in line "s + to_string(line_counter_));
 	}
-	return token_type::Id { static_cast<string>(word) };
+	++cur_;
+	tokens.PushStringCopy(unescaped_);
+}
+
+void Lexer::ThrowInvalidSymbol() const {
+	string err = "Invalid line nomber:" + to_string(line_counter_) + "\nFirst error symbol nomber:"
+			+ to_string(cur_ - line_begin_) + "\nInvalid line is:"
+			+ string(line_begin_, line_end_);
+	throw std::invalid_argument(err);
 }
 
 }  // namespace parse
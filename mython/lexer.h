@@ -1,12 +1,17 @@
 #pragma once
 
+#include "symbol.h"
+
+#include <cstdint>
+#include <exception>
 #include <iosfwd>
+#include <memory>
 #include <optional>
-#include <set>
 #include <sstream>
 #include <stdexcept>
 #include <string>
 #include <string_view>
+#include <type_traits>
 #include <variant>
 #include <vector>
 
@@ -17,19 +22,23 @@ namespace parse {
     namespace token_type {
 
         struct Number { // Lexeme "number"
-          int value;   // number
+          int64_t value;   // number
         };
 
-        struct Id {             // Lexeme «id»
-            std::string value;  // id
+        struct Id {                 // Lexeme «id»
+            runtime::Symbol value;  // id, interned by the lexer
         };
 
         struct Char {    // Lexeme «symbol»
             char value;  // symbol code
         };
 
+        // For in-memory input the value refers to the source text and stays valid while
+        // the source exists. Strings of std::istream input and strings with escape sequences
+        // are copied into the token buffer of the lexer, they stay valid until the lexer
+        // has moved at least a block of tokens further
         struct String {  // Lexeme «string constant"
-            std::string value;
+            std::string_view value;
         };
 
         struct Class {};    // Lexeme «class»
@@ -86,28 +95,196 @@ namespace parse {
 
     std::ostream& operator<<(std::ostream& os, const Token& rhs);
 
+    namespace detail {
+        template <typename T, typename... Types>
+        constexpr uint8_t KindOf(const std::variant<Types...>* /*variant*/) {
+            constexpr bool matches[] = {std::is_same_v<T, Types>...};
+            uint8_t kind = 0;
+            while (!matches[kind]) {
+                ++kind;
+            }
+            return kind;
+        }
+    }  // namespace detail
+
+    // Token stream stored as a struct of arrays: a one-byte kind and a 32-bit payload per token.
+    // The payload is the symbol id of an Id, the code of a Char and an index into the side
+    // tables for Number and String, other tokens have no payload.
+    // Tokens are read in place, nothing is copied or allocated for it
+    class TokenBuffer {
+    public:
+        using Kind = uint8_t;
+
+        // Kind of tokens of type T, it is the index of T in TokenBase
+        template <typename T>
+        static constexpr Kind KIND = detail::KindOf<T>(static_cast<const TokenBase*>(nullptr));
+
+        [[nodiscard]] size_t Size() const {
+            return kinds_.size();
+        }
+
+        [[nodiscard]] Kind KindAt(size_t index) const {
+            return kinds_[index];
+        }
+
+        template <typename T>
+        [[nodiscard]] bool Is(size_t index) const {
+            return kinds_[index] == KIND<T>;
+        }
+
+        [[nodiscard]] int64_t NumberAt(size_t index) const {
+            return numbers_[payloads_[index]];
+        }
+
+        [[nodiscard]] runtime::Symbol IdAt(size_t index) const {
+            return runtime::Symbol::FromId(payloads_[index]);
+        }
+
+        [[nodiscard]] char CharAt(size_t index) const {
+            return static_cast<char>(payloads_[index]);
+        }
+
+        [[nodiscard]] std::string_view StringAt(size_t index) const {
+            return strings_[payloads_[index]];
+        }
+
+        // Returns the token at index, which must be of type T
+        template <typename T>
+        [[nodiscard]] T Get(size_t index) const {
+            if constexpr (std::is_same_v<T, token_type::Number>) {
+                return T{NumberAt(index)};
+            } else if constexpr (std::is_same_v<T, token_type::Id>) {
+                return T{IdAt(index)};
+            } else if constexpr (std::is_same_v<T, token_type::Char>) {
+                return T{CharAt(index)};
+            } else if constexpr (std::is_same_v<T, token_type::String>) {
+                return T{StringAt(index)};
+            } else {
+                return T{};
+            }
+        }
+
+        // Builds a Token for the token at index
+        [[nodiscard]] Token At(size_t index) const;
+
+        // The value of a String refers to the same text as the value of token
+        void Push(const Token& token);
+
+        template <typename T>
+        void Push() {
+            Append(KIND<T>, 0);
+        }
+
+        void PushNumber(int64_t value);
+        void PushId(runtime::Symbol value);
+        void PushChar(char value);
+        // The token refers to value, so the text has to outlive it
+        void PushString(std::string_view value);
+        // The buffer keeps a copy of value
+        void PushStringCopy(std::string_view value);
+        // Appends the token at index of other, the buffer keeps a copy of a string value
+        void PushCopy(const TokenBuffer& other, size_t index);
+
+        // Prepares the buffer for token_count tokens
+        void Reserve(size_t token_count);
+
+        // Removes all tokens, the memory is kept for reuse
+        void Clear();
+
+    private:
+        // String chunks grow from the first size to the full one, so that small buffers,
+        // e.g. the ones of single lines, do not hold a whole chunk for a short string
+        static constexpr size_t FIRST_STRING_CHUNK_SIZE = 256;
+        static constexpr size_t STRING_CHUNK_SIZE = 16 * 1024;
+
+        std::vector<Kind> kinds_;
+        std::vector<uint32_t> payloads_;
+        std::vector<int64_t> numbers_;
+        std::vector<std::string_view> strings_;
+
+        // Copies of string values. Chunks are reused after Clear, longer strings get their own
+        std::vector<std::unique_ptr<char[]>> string_chunks_;
+        size_t chunk_index_ = 0;
+        size_t chunk_used_ = 0;
+        std::vector<std::unique_ptr<char[]>> long_strings_;
+
+        void Append(Kind kind, uint32_t payload) {
+            kinds_.push_back(kind);
+            payloads_.push_back(payload);
+        }
+
+        static size_t ChunkSize(size_t index) {
+            return index < 6 ? FIRST_STRING_CHUNK_SIZE << index : STRING_CHUNK_SIZE;
+        }
+
+        std::string_view CopyString(std::string_view value);
+    };
+
     class LexerError : public std::runtime_error {
     public:
         using std::runtime_error::runtime_error;
     };
 
+    class IncrementalLexer;
+
+    struct LexerOptions {
+        // Ids may contain symbols that are not ASCII, e.g. Cyrillic letters. Strings and
+        // comments accept any valid UTF-8 either way
+        bool utf8_ids = false;
+    };
+
     class Lexer {
     public:
-        explicit Lexer(std::istream& input);
-
-        // Returns a reference to the current token or token_type::Eof if the token flow has ended
+        // Tokens are produced on demand, a block of lines at a time: the lexer keeps only
+        // the lines being processed and their tokens, so memory does not depend on the size
+        // of the input
+        explicit Lexer(std::istream& input, LexerOptions options = {});
+        // Lexes a program that is already in memory, e.g. a mapped file. Tokens refer to source
+        explicit Lexer(std::string_view source, LexerOptions options = {});
+        // A big source is split at line boundaries into parts that are lexed up front by up to
+        // thread_count threads, a small one is lexed as by Lexer(source). The tokens are
+        // the same as for Lexer(source), errors are reported in the same order too
+        Lexer(std::string_view source, size_t thread_count, LexerOptions options = {});
+        // Reads tokens lexed before, e.g. copied by CopyCurrentToken. They must end with Eof
+        explicit Lexer(TokenBuffer tokens);
+
+        // Returns a reference to the current token or token_type::Eof if the token flow has ended.
+        // The token is built out of the token buffer on every call, Is and Get are cheaper
         [[nodiscard]] const Token& CurrentToken() const;
 
         // Returns the following token, or token_type::Eof if the token flow has ended
-        Token NextToken();
+        const Token& NextToken();
+
+        // Moves to the following token without building it
+        void Advance();
+
+        // Appends the current token to tokens. The buffer keeps its own copy of a string value
+        void CopyCurrentToken(TokenBuffer& tokens) const;
+
+        // Returns true if the current token is of type T
+        template <typename T>
+        [[nodiscard]] bool Is() const {
+            return tokens_.Is<T>(position_);
+        }
+
+        // Returns true if the current token is the symbol c
+        [[nodiscard]] bool IsChar(char c) const {
+            return Is<token_type::Char>() && tokens_.CharAt(position_) == c;
+        }
+
+        // Returns the current token, which must be of type T
+        template <typename T>
+        [[nodiscard]] T Get() const {
+            return tokens_.Get<T>(position_);
+        }
 
-        // If the current token is of type T, the method returns a reference to it.
+        // If the current token is of type T, the method returns it.
         // Otherwise, the method throws a LexerError exception
         template <typename T>
-        const T& Expect() const {
+        T Expect() const {
             using namespace std::literals;
-            if (CurrentToken().Is<T>()) {
-                return CurrentToken().As<T>();
+            if (Is<T>()) {
+                return Get<T>();
             }
             throw LexerError("Not implemented"s);
         }
@@ -122,15 +299,12 @@ namespace parse {
             }
         }
 
-        // If the next token is of type T, the method returns a reference to it.
+        // If the next token is of type T, the method returns it.
         // Otherwise, the method throws a LexerError exception
         template <typename T>
-        const T& ExpectNext() {
-            using namespace std::literals;
-            if (NextToken().Is<T>()) {
-                return CurrentToken().As<T>();
-            }
-            throw LexerError("Not implemented"s);
+        T ExpectNext() {
+            Advance();
+            return Expect<T>();
         }
 
         // The method checks that the next token is of type T, and the token itself contains the value value.
@@ -144,55 +318,70 @@ namespace parse {
         }
 
     private:
-        size_t nomber_of_curent_token = 0;
-
-        std::string word = ""s;
-        std::string math_word = ""s;
-        std::string str_line = ""s;
-
-        size_t offset_buff = 0;
-        size_t offset = 0;
-        size_t previous_line_offset = 0;
-
-        bool is_new_line = true;
-        bool is_first_line = true;
-        bool exception_symbol = false;
-        bool single_quote_open = false;
-        bool double_quote_open = false;
-        bool coment = false;
-
-
-        const std::set<std::string> keywords_ {
-            "class"s, "return"s, "if"s, "else"s,
-            "def"s, "print"s,
-            "and"s , "or"s , "not"s , "=="s , "!="s ,
-            "<="s, ">="s, "None"s, "True"s, "False"s
-        };
-
-        const std::set<char> trigger_symbols_{
-            ' ', ',', ':', '.', '(', ')', '\\'
-        };
-
-        const std::set<char> math_symbols_{
-            '+', '-', '*', '/', '=', '<', '>', '!'
-        };
-
-        std::vector<Token> lexer_data;
-
-        bool IsNumber(char ch) const;
-        bool IsLegalSymbolForId(char ch) const;
-        void NewLineProcessing();
-        void QuotesProcessing(const char& symbol, bool& open);
-        bool CheckOffset(const char& symbol);
+        friend class IncrementalLexer;
+
+        // Initial size of the input window, it grows only for lines that do not fit into it
+        static constexpr size_t BUFFER_SIZE = 64 * 1024;
+        // Smaller parts of a source are not worth a thread
+        static constexpr size_t MIN_PART_SIZE = 256 * 1024;
+        // Typical programs have a token per three bytes, so it is enough to reserve for parts
+        static constexpr size_t BYTES_PER_TOKEN = 3;
+
+        std::istream* input_ = nullptr;
+        std::vector<char> buffer_;
+        std::string_view source_;  // the whole program when the lexer was given it in memory
+        size_t buffer_begin_ = 0;  // start of the first line that has not been read yet
+        size_t buffer_end_ = 0;    // end of the data read from input_
+        bool input_exhausted_ = false;
+        LexerOptions options_;
+
+        // The line being lexed: [line_begin_, line_end_), cur_ points to the next symbol
+        const char* line_begin_ = nullptr;
+        const char* line_end_ = nullptr;
+        const char* cur_ = nullptr;
+        size_t line_counter_ = 0;
+
+        // Tokens of the current block of lines, the spare buffer receives the next block
+        static constexpr size_t BLOCK_TOKENS = 1024;
+        TokenBuffer tokens_;
+        TokenBuffer next_tokens_;
+        size_t position_ = 0;
+        mutable Token current_token_;
+        std::exception_ptr error_;  // thrown when the tokens lexed before the error are over
+        bool eof_ = false;
+        // Parts of a source lexed up front, they become current in turn
+        std::vector<TokenBuffer> lexed_parts_;
+        size_t next_part_ = 0;
+
+        std::string unescaped_;  // value of the last string with escape sequences
+        size_t offset = 0;  // indentation of the last line with tokens, in levels of two spaces
+
+        // Creates a lexer over part, a piece of a bigger source that starts after lines_before
+        // lines at indentation level indent. It lexes nothing until asked to
+        Lexer(std::string_view part, size_t indent, size_t lines_before, LexerOptions options);
+
+        // Lexes all lines of the part. Tokens that end the input are added only to the last part
+        void LexPart(TokenBuffer& tokens, bool last);
+        // Lexes the next line on its own for IncrementalLexer: Indent, Dedent and Newline tokens
+        // are left out, level gets the indentation of a line with tokens and nullopt otherwise.
+        // Returns false when the lines are over
+        bool LexDetachedLine(TokenBuffer& tokens, std::optional<size_t>& level);
+
+        static size_t IndentBefore(std::string_view source, size_t line_begin);
+
+        const char* Data() const;
+        bool ReadLine();
+        bool SkipIndentation(size_t& level);
+        bool CheckOffset(TokenBuffer& tokens);
         std::string Unescape(const char symbol);
 
-        void WriteWords(std::string& word, std::string& math_word);
-        void WriteWord(std::string& word);
-        void WriteToString(const char symbol);
-        void WriteMathWord(std::string& math_word);
-
-        void ParsingData(std::istream& input);
-        Token ParseToken(std::string_view word);
+        void Fill();
+        void LexLine(TokenBuffer& tokens);
+        bool LexLineTokens(TokenBuffer& tokens);
+        void LexWord(TokenBuffer& tokens);
+        void LexMathWord(TokenBuffer& tokens);
+        void LexString(TokenBuffer& tokens);
+        [[noreturn]] void ThrowInvalidSymbol() const;
     };
 
 }  // namespace parse
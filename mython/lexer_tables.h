@@ -0,0 +1,125 @@
+#pragma once
+
+#include "lexer.h"
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+// Lookup tables of the lexer: symbol classes and a perfect hash of keywords
+namespace parse {
+
+// Every input byte is classified with a single table lookup
+enum class CharClass : uint8_t {
+    LETTER,   // first symbol of an id: a-z, A-Z or _
+    DIGIT,
+    MATH,     // symbols that may form two-symbol operators
+    TRIGGER,  // single-symbol tokens
+    QUOTE,
+    COMMENT,
+    SKIP,     // separators that produce no tokens
+    INVALID
+};
+
+constexpr std::array<CharClass, 256> MakeCharClasses() {
+    std::array<CharClass, 256> classes {};
+    for (size_t i = 0; i < classes.size(); ++i) {
+        classes[i] = CharClass::INVALID;
+    }
+    for (char ch = 'a'; ch <= 'z'; ++ch) {
+        classes[static_cast<unsigned char>(ch)] = CharClass::LETTER;
+    }
+    for (char ch = 'A'; ch <= 'Z'; ++ch) {
+        classes[static_cast<unsigned char>(ch)] = CharClass::LETTER;
+    }
+    classes['_'] = CharClass::LETTER;
+    for (char ch = '0'; ch <= '9'; ++ch) {
+        classes[static_cast<unsigned char>(ch)] = CharClass::DIGIT;
+    }
+    for (char ch : { '+', '-', '*', '/', '=', '<', '>', '!' }) {
+        classes[static_cast<unsigned char>(ch)] = CharClass::MATH;
+    }
+    for (char ch : { ',', ':', '.', '(', ')' }) {
+        classes[static_cast<unsigned char>(ch)] = CharClass::TRIGGER;
+    }
+    classes['\''] = CharClass::QUOTE;
+    classes['"'] = CharClass::QUOTE;
+    classes['#'] = CharClass::COMMENT;
+    classes[' '] = CharClass::SKIP;
+    classes['\0'] = CharClass::SKIP;
+    classes['\\'] = CharClass::SKIP;
+    return classes;
+}
+
+constexpr std::array<CharClass, 256> CHAR_CLASSES = MakeCharClasses();
+
+inline CharClass ClassOf(char symbol) {
+    return CHAR_CLASSES[static_cast<unsigned char>(symbol)];
+}
+
+inline bool IsIdSymbol(char symbol) {
+    const CharClass symbol_class = ClassOf(symbol);
+    return symbol_class == CharClass::LETTER || symbol_class == CharClass::DIGIT;
+}
+
+struct Keyword {
+    std::string_view word;
+    Token token;
+};
+
+// Keywords and two-symbol operators
+constexpr Keyword KEYWORDS[] = {
+    { "class", token_type::Class() }, { "return", token_type::Return() },
+    { "if", token_type::If() }, { "else", token_type::Else() },
+    { "def", token_type::Def() }, { "print", token_type::Print() },
+    { "and", token_type::And() }, { "or", token_type::Or() },
+    { "not", token_type::Not() }, { "None", token_type::None() },
+    { "True", token_type::True() }, { "False", token_type::False() },
+    { "==", token_type::Eq() }, { "!=", token_type::NotEq() },
+    { "<=", token_type::LessOrEq() }, { ">=", token_type::GreaterOrEq() },
+};
+
+constexpr size_t KEYWORD_TABLE_SIZE = 32;
+
+constexpr size_t KeywordHash(std::string_view word, uint32_t seed) {
+    return (static_cast<unsigned char>(word.front()) * seed
+            + static_cast<unsigned char>(word.back()) + word.size()) % KEYWORD_TABLE_SIZE;
+}
+
+// Finds a seed for which KeywordHash has no collisions on KEYWORDS
+constexpr uint32_t FindKeywordSeed() {
+    for (uint32_t seed = 1; seed < 1024; ++seed) {
+        bool used[KEYWORD_TABLE_SIZE] = { };
+        bool perfect = true;
+        for (const Keyword& keyword : KEYWORDS) {
+            const size_t hash = KeywordHash(keyword.word, seed);
+            perfect = perfect && !used[hash];
+            used[hash] = true;
+        }
+        if (perfect) {
+            return seed;
+        }
+    }
+    return 0;
+}
+
+constexpr uint32_t KEYWORD_SEED = FindKeywordSeed();
+static_assert(KEYWORD_SEED != 0, "KeywordHash can not be made perfect for KEYWORDS");
+
+constexpr std::array<Keyword, KEYWORD_TABLE_SIZE> MakeKeywordTable() {
+    std::array<Keyword, KEYWORD_TABLE_SIZE> table {};
+    for (const Keyword& keyword : KEYWORDS) {
+        table[KeywordHash(keyword.word, KEYWORD_SEED)] = keyword;
+    }
+    return table;
+}
+
+constexpr std::array<Keyword, KEYWORD_TABLE_SIZE> KEYWORD_TABLE = MakeKeywordTable();
+
+// Returns the keyword or operator token for word, or nullptr if word is not a keyword
+inline const Token* FindKeyword(std::string_view word) {
+    const Keyword& candidate = KEYWORD_TABLE[KeywordHash(word, KEYWORD_SEED)];
+    return candidate.word == word ? &candidate.token : nullptr;
+}
+
+}  // namespace parse
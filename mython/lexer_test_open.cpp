@@ -1,8 +1,13 @@
+#include "incremental_lexer.h"
 #include "lexer.h"
+#include "scanner.h"
 #include "test_runner_p.h"
 
+#include <random>
 #include <sstream>
+#include <stdexcept>
 #include <string>
+#include <vector>
 
 using namespace std;
 
@@ -353,6 +358,350 @@ abc#
 		ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof { }));
 	}
 }
+
+void TestInputIsReadOnDemand() {
+	string program;
+	for (int i = 0; i < 100000; ++i) {
+		program += "x = 'value'\n"s;
+	}
+	istringstream input(program);
+	Lexer lexer(input);
+
+	ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Id { "x"s }));
+	ASSERT(static_cast<size_t>(input.tellg()) < program.size());
+
+	size_t newline_count = 0;
+	while (!lexer.NextToken().Is<token_type::Eof>()) {
+		if (lexer.CurrentToken().Is<token_type::Newline>()) {
+			++newline_count;
+		}
+	}
+	ASSERT_EQUAL(newline_count, 100000u);
+}
+
+void TestUnterminatedString() {
+	istringstream input("x = 'abc\ny = 1\n"s);
+	Lexer lexer(input);
+
+	ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Id { "x"s }));
+	ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char { '=' }));
+	ASSERT_THROWS(lexer.NextToken(), LexerError);
+}
+
+void TestInMemorySourceIsNotCopied() {
+	const string source = "name = 'plain' + 'esc\\'aped'\n"s;
+	Lexer lexer(string_view { source });
+
+	ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Id { "name"s }));
+	ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char { '=' }));
+
+	const auto plain = lexer.ExpectNext<token_type::String>().value;
+	ASSERT_EQUAL(plain, "plain"sv);
+	ASSERT(plain.data() == source.data() + source.find("plain"s));
+
+	ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char { '+' }));
+	ASSERT_EQUAL(lexer.NextToken(), Token(token_type::String { "esc'aped"s }));
+	ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline { }));
+	ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof { }));
+}
+
+// Every vector kernel must stop at the same symbol as the scalar one, wherever the stop
+// symbol is relative to the vector boundaries and the end of the range
+void TestScanKernelsMatchScalar() {
+	const ScanKernels &scalar = *GetScanKernels(ScanIsa::SCALAR);
+	for (ScanIsa isa : { ScanIsa::SSE2, ScanIsa::AVX2 }) {
+		const ScanKernels *kernels = GetScanKernels(isa);
+		if (kernels == nullptr) {
+			continue;
+		}
+		for (size_t size = 0; size <= 70; ++size) {
+			for (size_t stop = 0; stop <= size; ++stop) {
+				string id(size, 'a');
+				string spaces(size, ' ');
+				string text(size, 'x');
+				if (stop < size) {
+					id[stop] = (stop % 2 == 0) ? '.' : '\x80';
+					spaces[stop] = '#';
+					text[stop] = "\n\\\xD0"[stop % 3];
+				}
+				const char *id_end = id.data() + size;
+				ASSERT(kernels->find_id_end(id.data(), id_end)
+						== scalar.find_id_end(id.data(), id_end));
+				const char *spaces_end = spaces.data() + size;
+				ASSERT(kernels->skip_spaces(spaces.data(), spaces_end)
+						== scalar.skip_spaces(spaces.data(), spaces_end));
+				const char *text_end = text.data() + size;
+				ASSERT(kernels->find_newline(text.data(), text_end)
+						== scalar.find_newline(text.data(), text_end));
+				ASSERT(kernels->find_string_stop(text.data(), text_end, '\'')
+						== scalar.find_string_stop(text.data(), text_end, '\''));
+				ASSERT(kernels->find_non_ascii(text.data(), text_end)
+						== scalar.find_non_ascii(text.data(), text_end));
+				ASSERT(kernels->find_newline_or_non_ascii(text.data(), text_end)
+						== scalar.find_newline_or_non_ascii(text.data(), text_end));
+			}
+		}
+	}
+}
+
+void TestLongTokens() {
+	const string id(100, 'z');
+	const string value = string(40, 'v') + "\\n"s + string(40, 'w');
+	const string source = string(36, ' ') + id + " = '"s + value + "'  # "s + string(50, 'c')
+			+ "\n"s;
+	Lexer lexer(string_view { source });
+
+	ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Indent { }));
+	for (int i = 1; i < 18; ++i) {
+		ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Indent { }));
+	}
+	ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id { id }));
+	ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char { '=' }));
+	ASSERT_EQUAL(lexer.NextToken(),
+			Token(token_type::String { string(40, 'v') + "\n"s + string(40, 'w') }));
+	ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline { }));
+}
+
+void TestTokenBuffer() {
+	static_assert(sizeof(TokenBuffer::Kind) == 1);
+	const vector<Token> tokens = { token_type::Number { 42 }, token_type::Id { "x"s },
+		token_type::Char { '(' }, token_type::String { "text"sv }, token_type::Eq { },
+		token_type::Indent { }, token_type::Char { '\xFF' }, token_type::Number { -7 },
+		token_type::Eof { } };
+
+	TokenBuffer buffer;
+	for (const Token &token : tokens) {
+		buffer.Push(token);
+	}
+	buffer.PushStringCopy("copied"sv);
+
+	ASSERT_EQUAL(buffer.Size(), tokens.size() + 1);
+	for (size_t i = 0; i < tokens.size(); ++i) {
+		ASSERT_EQUAL(buffer.At(i), tokens[i]);
+		ASSERT_EQUAL(static_cast<size_t>(buffer.KindAt(i)), tokens[i].index());
+	}
+	ASSERT(buffer.Is<token_type::Id>(1));
+	ASSERT_EQUAL(buffer.IdAt(1), "x"s);
+	ASSERT_EQUAL(buffer.Get<token_type::Number>(7).value, -7);
+	ASSERT_EQUAL(buffer.CharAt(6), '\xFF');
+	ASSERT_EQUAL(buffer.StringAt(tokens.size()), "copied"sv);
+
+	buffer.Clear();
+	ASSERT_EQUAL(buffer.Size(), 0u);
+}
+
+// Strings of std::istream input are copied, so they outlive the line buffer
+void TestStringsOfStreamInput() {
+	string program;
+	for (int i = 0; i < 5000; ++i) {
+		program += "s = 'value_"s + to_string(i) + "'\n"s;
+	}
+	istringstream input(program);
+	Lexer lexer(input);
+
+	int i = 0;
+	for (; !lexer.Is<token_type::Eof>(); lexer.Advance()) {
+		if (lexer.Is<token_type::String>()) {
+			ASSERT_EQUAL(lexer.Get<token_type::String>().value, "value_"s + to_string(i++));
+		}
+	}
+	ASSERT_EQUAL(i, 5000);
+}
+
+// Lexing runs ahead of the parser, but an error shows up only after the tokens before it
+void TestErrorsAreReportedInOrder() {
+	istringstream input("x = 1\ny = 2 $ 3\n"s);
+	Lexer lexer(input);
+
+	ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Id { "x"s }));
+	ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char { '=' }));
+	ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Number { 1 }));
+	ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline { }));
+	ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id { "y"s }));
+	ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char { '=' }));
+	ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Number { 2 }));
+	ASSERT_THROWS(lexer.Advance(), std::invalid_argument);
+	ASSERT_THROWS(lexer.Advance(), std::invalid_argument);
+}
+
+vector<Token> ReadAllTokens(Lexer &lexer) {
+	vector<Token> tokens { lexer.CurrentToken() };
+	while (!lexer.Is<token_type::Eof>()) {
+		tokens.push_back(lexer.NextToken());
+	}
+	return tokens;
+}
+
+// Parts of a big source start at any indentation, after blank and comment lines,
+// and in the middle of strings with escape sequences and comments full of quotes
+void TestParallelLexingMatchesSequential() {
+	string program;
+	for (int i = 0; program.size() < (2 << 20); ++i) {
+		program += "class C"s + to_string(i) + ":\n"s
+				+ "  def m(x):\n"s
+				+ "    if x > "s + to_string(i) + ":\n"s
+				+ "      return 'a\\'b # not a comment'\n"s
+				+ "\n"s
+				+ "        # a comment with 'quotes' and \"quotes\"\n"s
+				+ "    return \"x\\n\" + str(x)\n"s
+				+ "x = C"s + to_string(i) + "().m(" + to_string(i % 7) + ")\n"s;
+	}
+
+	Lexer sequential { string_view(program) };
+	const vector<Token> expected = ReadAllTokens(sequential);
+	for (size_t thread_count : { 1, 2, 3, 8 }) {
+		Lexer parallel(program, thread_count);
+		ASSERT(ReadAllTokens(parallel) == expected);
+	}
+}
+
+void TestParallelLexingReportsErrorsInOrder() {
+	string program;
+	while (program.size() < (2 << 20)) {
+		program += "x = 'value'\n"s;
+	}
+	program += "y = 1 $\n"s;
+
+	Lexer lexer(program, 4);
+	size_t newline_count = 0;
+	try {
+		for (; !lexer.Is<token_type::Eof>(); lexer.Advance()) {
+			newline_count += lexer.Is<token_type::Newline>();
+		}
+		ASSERT(false);
+	} catch (const std::invalid_argument &e) {
+		ASSERT(string(e.what()).find("Invalid line nomber:"s + to_string(newline_count + 1))
+				!= string::npos);
+	}
+}
+
+void TestUtf8() {
+	const string program = "имя = 'привет, мир' # комментарий\nprint имя, \"\\tπ\"\n"s;
+	Lexer lexer(program, LexerOptions { true });
+	ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Id { "имя"s }));
+	ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char { '=' }));
+	ASSERT_EQUAL(lexer.NextToken(), Token(token_type::String { "привет, мир"sv }));
+	ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline { }));
+	ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Print { }));
+	ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id { "имя"s }));
+	ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char { ',' }));
+	ASSERT_EQUAL(lexer.NextToken(), Token(token_type::String { "\tπ"sv }));
+
+	// Without the option only strings and comments may contain non-ASCII symbols
+	const string ascii_ids = "x = 'привет' # мир\nx1_\xD0\xB8 = 1\n"s;
+	for (const string_view source : { string_view(program), string_view(ascii_ids) }) {
+		try {
+			Lexer default_lexer { source };
+			while (!default_lexer.Is<token_type::Eof>()) {
+				default_lexer.Advance();
+			}
+			ASSERT(false);
+		} catch (const std::invalid_argument &e) {
+			ASSERT(string(e.what()).find("First error symbol nomber:"s
+					+ (source == program ? "0"s : "3"s)) != string::npos);
+		}
+	}
+	IncrementalLexer incremental(ascii_ids, LexerOptions { true });
+	ASSERT_EQUAL(incremental.LineTokens(1).At(0), Token(token_type::Id { "x1_и"s }));
+	try {
+		IncrementalLexer default_incremental(ascii_ids);
+		ASSERT(false);
+	} catch (const std::invalid_argument&) {
+	}
+
+	// Overlong encodings, surrogates, code points above U+10FFFF and broken sequences
+	for (const string &invalid : { "\xC0\x80"s, "\xE0\x80\x80"s, "\xED\xA0\x80"s,
+			"\xF4\x90\x80\x80"s, "\xF8\x88\x80\x80\x80"s, "\xD0"s, "\xD0x"s, "\x80"s }) {
+		const string text = "# ok: \xD0\xBE\xF0\x9F\x99\x82 "s + invalid + " "s;
+		ASSERT(FindInvalidUtf8(text.data(), text.data() + text.size()) == text.data() + 13);
+
+		istringstream input("x = 1\ny = 'a"s + invalid + "'\n"s);
+		Lexer invalid_lexer(input);
+		ASSERT_EQUAL(invalid_lexer.NextToken(), Token(token_type::Char { '=' }));
+		ASSERT_EQUAL(invalid_lexer.NextToken(), Token(token_type::Number { 1 }));
+		ASSERT_EQUAL(invalid_lexer.NextToken(), Token(token_type::Newline { }));
+		try {
+			invalid_lexer.NextToken();
+			ASSERT(false);
+		} catch (const LexerError &e) {
+			ASSERT_EQUAL(string(e.what()), "Invalid UTF-8 in line 2, symbol 6"s);
+		}
+	}
+}
+
+vector<Token> ToVector(const TokenBuffer &tokens) {
+	vector<Token> result;
+	for (size_t i = 0; i < tokens.Size(); ++i) {
+		result.push_back(tokens.At(i));
+	}
+	return result;
+}
+
+string JoinLines(const vector<string> &lines) {
+	string text;
+	for (const string &line : lines) {
+		text += line + '\n';
+	}
+	return text;
+}
+
+// Random edits of random lines, every token stream is compared with the one of the whole text
+void TestIncrementalLexingMatchesFullLexing() {
+	const vector<string> samples = {
+		"class A:"s, "  def m(x):"s, "    if x >= 2:"s, "      return 'a\\'b' + \"#\""s,
+		"    else:"s, "      y = x.f(1, None)"s, ""s, "   "s, "# comment"s,
+		"        # indented comment"s, "print A().m(3)"s, "  x = not True"s,
+	};
+	mt19937 random(42);
+	const auto pick = [&random](size_t bound) {
+		return static_cast<size_t>(random() % bound);
+	};
+
+	vector<string> lines;
+	for (size_t i = 0; i < 40; ++i) {
+		lines.push_back(samples[pick(samples.size())]);
+	}
+	IncrementalLexer incremental(JoinLines(lines));
+	for (int edit = 0; edit < 300; ++edit) {
+		const size_t first = pick(lines.size() + 1);
+		const size_t count = pick(min<size_t>(lines.size() - first, 3) + 1);
+		vector<string> new_lines;
+		for (size_t i = pick(4); i > 0; --i) {
+			new_lines.push_back(samples[pick(samples.size())]);
+		}
+		lines.erase(lines.begin() + first, lines.begin() + first + count);
+		lines.insert(lines.begin() + first, new_lines.begin(), new_lines.end());
+		incremental.Edit(first, count, JoinLines(new_lines));
+
+		const string text = JoinLines(lines);
+		Lexer lexer { string_view(text) };
+		ASSERT_EQUAL(incremental.LineCount(), lines.size());
+		ASSERT(ToVector(incremental.Tokens()) == ReadAllTokens(lexer));
+	}
+}
+
+void TestIncrementalLexingOfEdits() {
+	IncrementalLexer lexer("x = 1\nif x:\n  y = 'a'\n\nz = 2"s);
+	ASSERT_EQUAL(lexer.LineCount(), 5u);
+	ASSERT_EQUAL(lexer.IndentDelta(2), 1);
+	ASSERT_EQUAL(lexer.IndentDelta(4), -1);
+
+	// Indenting the last line removes its Dedent, the other lines keep theirs
+	lexer.Edit(4, 1, "  z = 2"s);
+	ASSERT_EQUAL(lexer.IndentDelta(4), 0);
+	ASSERT_EQUAL(lexer.LineTokens(4).Size(), 3u);
+	ASSERT_EQUAL(lexer.IndentDelta(2), 1);
+
+	// Removing the body of if indents the line after it
+	lexer.Edit(2, 1, ""s);
+	ASSERT_EQUAL(lexer.LineCount(), 4u);
+	ASSERT_EQUAL(lexer.IndentDelta(3), 1);
+
+	ASSERT_THROWS(lexer.Edit(3, 2, "x"s), std::out_of_range);
+	ASSERT_THROWS(lexer.Edit(1, 1, "y = 1 $\n"s), std::invalid_argument);
+	ASSERT_EQUAL(lexer.LineCount(), 4u);
+	ASSERT_EQUAL(lexer.LineTokens(1).Size(), 3u);
+}
 }  // namespace
 
 void RunOpenLexerTests(TestRunner &tr) {
@@ -369,6 +718,19 @@ void RunOpenLexerTests(TestRunner &tr) {
 	RUN_TEST(tr, parse::TestMythonProgram);
 	RUN_TEST(tr, parse::TestAlwaysEmitsNewlineAtTheEndOfNonemptyLine);
 	RUN_TEST(tr, parse::TestCommentsAreIgnored);
+	RUN_TEST(tr, parse::TestInputIsReadOnDemand);
+	RUN_TEST(tr, parse::TestUnterminatedString);
+	RUN_TEST(tr, parse::TestInMemorySourceIsNotCopied);
+	RUN_TEST(tr, parse::TestScanKernelsMatchScalar);
+	RUN_TEST(tr, parse::TestLongTokens);
+	RUN_TEST(tr, parse::TestTokenBuffer);
+	RUN_TEST(tr, parse::TestStringsOfStreamInput);
+	RUN_TEST(tr, parse::TestErrorsAreReportedInOrder);
+	RUN_TEST(tr, parse::TestParallelLexingMatchesSequential);
+	RUN_TEST(tr, parse::TestParallelLexingReportsErrorsInOrder);
+	RUN_TEST(tr, parse::TestUtf8);
+	RUN_TEST(tr, parse::TestIncrementalLexingMatchesFullLexing);
+	RUN_TEST(tr, parse::TestIncrementalLexingOfEdits);
 }
 
 }  // namespace parse
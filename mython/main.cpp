@@ -1,19 +1,118 @@
+#include "flat_ast.h"
 #include "lexer.h"
+#include "mapped_file.h"
+#include "optimizer.h"
+#include "parse.h"
+#include "program_cache.h"
 #include "runtime.h"
+#include "statement.h"
 #include "user_consol_interface.h"
 
 #include <iostream>
+#include <thread>
 
 using namespace std;
 
 namespace {
-void RunMythonProgram(istream &input, ostream &output) {
-	parse::Lexer lexer(input);
-	auto program = ParseProgram(lexer);
+// Options of a run given in the command line
+struct RunOptions {
+	bool print_stats = false;
+	bool flat = false;
+	bool use_cache = true;
+};
+
+// The file the parsed program of a script is cached in
+struct CacheEntry {
+	string path;
+	uint64_t source_hash = 0;
+};
+
+void PrintFlatStats(const ast::FlatProgram &flat, ostream &output) {
+	const size_t node_count = flat.GetNodes().size();
+	output << "Flat AST: "s << node_count << " nodes, "s
+			<< node_count * sizeof(ast::FlatProgram::Node) << " bytes"s << endl;
+}
+
+void PrintStats(const ast::Program &program, const ast::OptimizationStats &optimization,
+		const ast::FlatProgram *flat, ostream &output) {
+	const ast::Arena::Stats &stats = program.GetArena().GetStats();
+	output << "AST arena: "s << stats.object_count << " objects, "s << stats.destructor_count
+			<< " with destructors, "s << stats.bytes_used << " bytes used of "s
+			<< stats.bytes_reserved << " in "s << stats.block_count << " blocks"s << endl;
+	output << "Optimizer: "s << optimization.folded_constants << " constants folded, "s
+			<< optimization.negations << " negations, "s << optimization.resolved_conditions
+			<< " conditions resolved, "s << optimization.dropped_statements
+			<< " unreachable statements dropped, "s << optimization.devirtualized_calls
+			<< " calls devirtualized"s << endl;
+	if (flat != nullptr) {
+		PrintFlatStats(*flat, output);
+	}
+}
+
+// The cache entry is written before the run, so scripts that fail at run time are cached too.
+// The flat representation and the cache need all of the program, its method bodies are parsed
+// in parallel. A tree run parses only the methods it calls
+void RunMythonProgram(parse::Lexer &lexer, ostream &output, RunOptions options,
+		const CacheEntry *cache = nullptr) {
+	ParseOptions parse_options;
+	parse_options.lazy_methods = !options.flat && cache == nullptr;
+	parse_options.threads = thread::hardware_concurrency();
+	auto program = ParseProgram(lexer, parse_options);
+	const ast::OptimizationStats optimization = ast::Optimize(*program);
+
+	unique_ptr<ast::FlatProgram> flat;
+	if (options.flat || cache != nullptr) {
+		flat = make_unique<ast::FlatProgram>(*program);
+	}
+	if (cache != nullptr) {
+		const bool stored = ast::StoreCachedProgram(cache->path, cache->source_hash, *flat);
+		if (options.print_stats) {
+			cerr << "Program cache: "s << (stored ? "written to "s : "can not write "s)
+					<< cache->path << endl;
+		}
+	}
 
 	runtime::SimpleContext context { output };
 	runtime::Closure closure;
-	program->Execute(closure, context);
+	if (options.flat) {
+		flat->Execute(closure, context);
+	} else {
+		program->Execute(closure, context);
+	}
+	if (options.print_stats) {
+		PrintStats(*program, optimization, options.flat ? flat.get() : nullptr, cerr);
+	}
+}
+
+void RunMythonProgram(istream &input, ostream &output) {
+	parse::Lexer lexer(input);
+	RunMythonProgram(lexer, output, {});
+}
+
+// The script is mapped into memory and lexed in place, big scripts are lexed in parallel.
+// A valid cache entry of the script replaces lexing and parsing, the cached program is run
+// over the flat representation
+void RunMythonProgram(const string &script_path, ostream &output, RunOptions options) {
+	parse::MappedFile script(script_path);
+	if (!options.use_cache) {
+		parse::Lexer lexer(script.Data(), thread::hardware_concurrency());
+		RunMythonProgram(lexer, output, options);
+		return;
+	}
+
+	const CacheEntry cache { ast::GetCachePath(script_path), ast::HashSource(script.Data()) };
+	if (auto cached = ast::LoadCachedProgram(cache.path, cache.source_hash)) {
+		runtime::SimpleContext context { output };
+		runtime::Closure closure;
+		cached->Execute(closure, context);
+		if (options.print_stats) {
+			cerr << "Program cache: loaded from "s << cache.path << endl;
+			PrintFlatStats(*cached, cerr);
+		}
+		return;
+	}
+	parse::Lexer lexer(script.Data(), thread::hardware_concurrency());
+	RunMythonProgram(lexer, output, options, &cache);
 }
 }  // namespace
 
@@ -21,7 +120,11 @@ int main(int argc, char* argv[]) {
 	//Обработка параметов переданных в программу
 	UserRequest ur(argc,argv);
 	try {
-		RunMythonProgram(cin, cout);
+		if (ur.GetScriptPath().empty()) {
+			RunMythonProgram(cin, cout);
+		} else {
+			RunMythonProgram(ur.GetScriptPath(), cout, { ur.PrintStats(), ur.Flat(), ur.UseCache() });
+		}
 	} catch (const std::exception &e) {
 		std::cerr << e.what() << std::endl;
 		return 1;
@@ -0,0 +1,68 @@
+#include "mapped_file.h"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <fstream>
+#include <sstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace parse {
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& path) {
+	ifstream file(path, ios::binary);
+	if (!file) {
+		throw runtime_error("Cannot open file "s + path);
+	}
+	ostringstream contents;
+	contents << file.rdbuf();
+	contents_ = contents.str();
+	data_ = contents_.data();
+	size_ = contents_.size();
+}
+
+MappedFile::~MappedFile() = default;
+
+#else
+
+MappedFile::MappedFile(const std::string& path) {
+	const int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		throw runtime_error("Cannot open file "s + path);
+	}
+	struct stat file_stat {};
+	if (fstat(fd, &file_stat) != 0) {
+		close(fd);
+		throw runtime_error("Cannot read file "s + path);
+	}
+	size_ = static_cast<size_t>(file_stat.st_size);
+	if (size_ > 0) {
+		void* mapping = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (mapping == MAP_FAILED) {
+			close(fd);
+			throw runtime_error("Cannot map file "s + path);
+		}
+		madvise(mapping, size_, MADV_SEQUENTIAL);
+		data_ = static_cast<const char*>(mapping);
+	}
+	close(fd);
+}
+
+MappedFile::~MappedFile() {
+	if (data_ != nullptr) {
+		munmap(const_cast<char*>(data_), size_);
+	}
+}
+
+#endif
+
+}  // namespace parse
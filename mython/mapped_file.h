@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace parse {
+
+// Read-only view of a whole file mapped into memory.
+// The lexer reads the program straight from the mapping, without copying it line by line
+class MappedFile {
+public:
+    // Throws std::runtime_error if the file can not be opened or mapped
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Returns the contents of the file. The view is valid while the object exists
+    [[nodiscard]] std::string_view Data() const {
+        return {data_, size_};
+    }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    std::string contents_;
+#endif
+};
+
+}  // namespace parse
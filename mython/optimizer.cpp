@@ -0,0 +1,361 @@
+#include "optimizer.h"
+
+#include <memory>
+#include <stdexcept>
+#include <typeinfo>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+using namespace std;
+
+namespace ast {
+
+using runtime::ObjectHolder;
+
+namespace {
+const runtime::Symbol SELF = "self"sv;
+}  // namespace
+
+class Optimizer {
+public:
+	// Имена методов, объявленных в потомках класса, для каждого класса программы
+	using Overrides = unordered_map<const runtime::Class*, unordered_set<runtime::Symbol>>;
+
+	Optimizer(Arena &arena, shared_ptr<const Overrides> overrides) :
+			arena_(arena), overrides_(move(overrides)) {
+	}
+
+	// Анализ иерархии классов: у класса нет записи, если он объявлен не в этой программе
+	static shared_ptr<const Overrides> AnalyzeClasses(
+			const vector<const runtime::Class*> &classes) {
+		auto overrides = make_shared<Overrides>();
+		for (const runtime::Class *cls : classes) {
+			(*overrides)[cls];
+			for (const runtime::Class *base = cls->GetParent(); base != nullptr;
+					base = base->GetParent()) {
+				for (const runtime::Method &method : cls->GetMethods()) {
+					(*overrides)[base].insert(method.name);
+				}
+			}
+		}
+		return overrides;
+	}
+
+	void OptimizeProgram(Program &program) {
+		program.root_ = Optimize(move(program.root_));
+	}
+
+	[[nodiscard]] const OptimizationStats& GetStats() const {
+		return stats_;
+	}
+
+private:
+	// Вызовы self.method(...) в теле метода класса cls. Их можно связать с методами, только если
+	// переменной self ничего не присваивается
+	struct MethodScope {
+		const runtime::Class &cls;
+		vector<MethodCall*> self_calls {};
+		bool self_assigned = false;
+	};
+
+	Arena &arena_;
+	shared_ptr<const Overrides> overrides_;
+	MethodScope *scope_ = nullptr;
+	OptimizationStats stats_;
+	// Константы вычисляются без переменных и без вывода
+	runtime::Closure closure_;
+	runtime::DummyContext context_;
+
+	template <typename T>
+	static T* As(Statement *statement, const type_info &type) {
+		return type == typeid(T) ? static_cast<T*>(statement) : nullptr;
+	}
+
+	template <typename T>
+	static T* As(Statement *statement) {
+		return statement != nullptr ? As<T>(statement, typeid(*statement)) : nullptr;
+	}
+
+	// Сравнения - узлы разных классов с общим предком Comparison
+	static Comparison* AsComparison(Statement *statement, const type_info &type) {
+		if (type == typeid(Equal) || type == typeid(NotEqual) || type == typeid(Less)
+				|| type == typeid(Greater) || type == typeid(LessOrEqual)
+				|| type == typeid(GreaterOrEqual)) {
+			return static_cast<Comparison*>(statement);
+		}
+		return nullptr;
+	}
+
+	template <typename T, typename ... Args>
+	StatementPtr Make(Args &&... args) {
+		return {arena_.Make<T>(std::forward<Args>(args)...),
+				runtime::ExecutableDeleter::NonOwning()};
+	}
+
+	static bool IsConstant(const StatementPtr &statement) {
+		Statement *node = statement.get();
+		return As<NumericConst>(node) != nullptr || As<StringConst>(node) != nullptr
+				|| As<BoolConst>(node) != nullptr || As<None>(node) != nullptr;
+	}
+
+	// Возвращает узел-константу со значением value либо nullptr, если у значения нет констант
+	StatementPtr MakeConstant(const ObjectHolder &value) {
+		if (const auto *number = value.TryAs<runtime::Number>()) {
+			return Make<NumericConst>(number->GetValue());
+		}
+		if (const auto *str = value.TryAs<runtime::String>()) {
+			return Make<StringConst>(str->GetValue());
+		}
+		if (const auto *boolean = value.TryAs<runtime::Bool>()) {
+			return Make<BoolConst>(runtime::Bool(boolean->GetValue()));
+		}
+		return nullptr;
+	}
+
+	// Вычисляет операцию, все аргументы которой - константы
+	StatementPtr Fold(StatementPtr operation) {
+		ObjectHolder value;
+		try {
+			value = operation->Execute(closure_, context_);
+		} catch (const runtime_error&) {
+			return operation;
+		}
+		if (StatementPtr constant = MakeConstant(value)) {
+			++stats_.folded_constants;
+			return constant;
+		}
+		return operation;
+	}
+
+	StatementPtr OptimizeUnary(StatementPtr statement, UnaryOperation &operation) {
+		operation.argument_ = Optimize(move(operation.argument_));
+		return IsConstant(operation.argument_) ? Fold(move(statement)) : move(statement);
+	}
+
+	StatementPtr OptimizeBinary(StatementPtr statement, BinaryOperation &operation) {
+		operation.lhs_ = Optimize(move(operation.lhs_));
+		operation.rhs_ = Optimize(move(operation.rhs_));
+		if (IsConstant(operation.lhs_) && IsConstant(operation.rhs_)) {
+			return Fold(move(statement));
+		}
+		return statement;
+	}
+
+	// x * -1 - так парсер записывает -x
+	StatementPtr OptimizeMult(StatementPtr statement, Mult &mult) {
+		statement = OptimizeBinary(move(statement), mult);
+		// Свёрнутый узел мог быть удалён
+		if (statement.get() != &mult || !IsConstant(mult.rhs_)) {
+			return statement;
+		}
+		const ObjectHolder value = mult.rhs_->Execute(closure_, context_);
+		const auto *factor = value.TryAs<runtime::Number>();
+		if (factor == nullptr || factor->GetValue() != -1) {
+			return statement;
+		}
+		++stats_.negations;
+		return Make<Negate>(move(mult.lhs_));
+	}
+
+	// Если значение левого аргумента определяет результат, правый не вычисляется
+	StatementPtr OptimizeLogical(StatementPtr statement, BinaryOperation &operation,
+			bool result_if_lhs_is) {
+		statement = OptimizeBinary(move(statement), operation);
+		if (statement.get() != &operation || !IsConstant(operation.lhs_)) {
+			return statement;
+		}
+		if (operation.lhs_->EvaluateCondition(closure_, context_) != result_if_lhs_is) {
+			return statement;
+		}
+		++stats_.folded_constants;
+		return Make<BoolConst>(runtime::Bool(result_if_lhs_is));
+	}
+
+	StatementPtr OptimizeIfElse(StatementPtr statement, IfElse &if_else) {
+		if_else.condition_ = Optimize(move(if_else.condition_));
+		if_else.if_body_ = Optimize(move(if_else.if_body_));
+		if_else.else_body_ = Optimize(move(if_else.else_body_));
+		// Значение константы любого типа приводится к bool так же, как при выполнении
+		if (!IsConstant(if_else.condition_)) {
+			return statement;
+		}
+		++stats_.resolved_conditions;
+		const bool condition = if_else.condition_->EvaluateCondition(closure_, context_);
+		StatementPtr &body = condition ? if_else.if_body_ : if_else.else_body_;
+		return body ? move(body) : Make<Compound>();
+	}
+
+	static bool AlwaysReturns(Statement &statement) {
+		if (As<Return>(&statement) != nullptr) {
+			return true;
+		}
+		if (auto *if_else = As<IfElse>(&statement)) {
+			return if_else->if_body_ && if_else->else_body_ && AlwaysReturns(*if_else->if_body_)
+					&& AlwaysReturns(*if_else->else_body_);
+		}
+		if (auto *compound = As<Compound>(&statement)) {
+			return !compound->compound_.empty() && AlwaysReturns(*compound->compound_.back());
+		}
+		return false;
+	}
+
+	// Вложенные составные инструкции (ветки if с постоянным условием) встраиваются в эту
+	void OptimizeCompound(Compound &compound) {
+		vector<StatementPtr> statements;
+		statements.reserve(compound.compound_.size());
+		bool returns = false;
+		for (StatementPtr &statement : compound.compound_) {
+			if (returns) {
+				++stats_.dropped_statements;
+				continue;
+			}
+			StatementPtr optimized = Optimize(move(statement));
+			if (auto *nested = As<Compound>(optimized.get())) {
+				for (StatementPtr &nested_statement : nested->compound_) {
+					statements.push_back(move(nested_statement));
+				}
+			} else {
+				statements.push_back(move(optimized));
+			}
+			returns = !statements.empty() && AlwaysReturns(*statements.back());
+		}
+		compound.compound_ = move(statements);
+	}
+
+	static bool IsSelf(Statement *statement) {
+		const auto *variable = As<VariableValue>(statement);
+		return variable != nullptr && variable->dotted_ids_.size() == 1
+				&& variable->dotted_ids_.front() == SELF;
+	}
+
+	// Возвращает метод name класса или его предка, не строя тело метода
+	static const runtime::Method* FindMethod(const runtime::Class &cls, runtime::Symbol name) {
+		for (const runtime::Class *owner = &cls; owner != nullptr; owner = owner->GetParent()) {
+			for (const runtime::Method &method : owner->GetMethods()) {
+				if (method.name == name) {
+					return &method;
+				}
+			}
+		}
+		return nullptr;
+	}
+
+	// self в методе класса cls - объект cls или его потомка. Если ни один потомок не
+	// переопределяет вызываемый метод, вызывается всегда метод, найденный в cls
+	void BindSelfCalls(const MethodScope &scope) {
+		const auto it = overrides_->find(&scope.cls);
+		if (scope.self_assigned || it == overrides_->end()) {
+			return;
+		}
+		for (MethodCall *call : scope.self_calls) {
+			if (it->second.count(call->method_) != 0) {
+				continue;
+			}
+			const runtime::Method *method = FindMethod(scope.cls, call->method_);
+			// Вызов с неверным числом аргументов выбросит исключение при выполнении, как и раньше
+			if (method != nullptr && method->formal_params.size() == call->args_.size()) {
+				call->bound_method_ = method;
+				++stats_.devirtualized_calls;
+			}
+		}
+	}
+
+	void OptimizeMethod(const runtime::Method &method, const runtime::Class &cls) {
+		auto *body = As<MethodBody>(method.body.get());
+		if (body == nullptr) {
+			return;
+		}
+		MethodScope scope { cls };
+		MethodScope *outer_scope = exchange(scope_, &scope);
+		body->body_ = Optimize(move(body->body_));
+		scope_ = outer_scope;
+		BindSelfCalls(scope);
+	}
+
+	// Тело, которое ещё не разобрано (ParseOptions::lazy_methods), упрощается после разбора
+	void OptimizeMethods(runtime::Class &cls) {
+		for (runtime::Method &method : cls.GetMethods()) {
+			if (!method.build) {
+				OptimizeMethod(method, cls);
+				continue;
+			}
+			method.build = [build = move(method.build), &arena = arena_, overrides = overrides_,
+					&cls](runtime::Method &built) {
+				build(built);
+				Optimizer(arena, overrides).OptimizeMethod(built, cls);
+			};
+		}
+	}
+
+	StatementPtr Optimize(StatementPtr statement) {
+		Statement *node = statement.get();
+		if (node == nullptr) {
+			return statement;
+		}
+		const type_info &type = typeid(*node);
+		if (auto *assignment = As<Assignment>(node, type)) {
+			if (scope_ != nullptr && assignment->var_ == SELF) {
+				scope_->self_assigned = true;
+			}
+			assignment->rv_ = Optimize(move(assignment->rv_));
+		} else if (auto *field_assignment = As<FieldAssignment>(node, type)) {
+			field_assignment->rv_ = Optimize(move(field_assignment->rv_));
+		} else if (auto *print = As<Print>(node, type)) {
+			OptimizeAll(print->args_);
+		} else if (auto *call = As<MethodCall>(node, type)) {
+			OptimizeAll(call->args_);
+			call->object_ = Optimize(move(call->object_));
+			if (scope_ != nullptr && IsSelf(call->object_.get())) {
+				scope_->self_calls.push_back(call);
+			}
+		} else if (auto *instance = As<NewInstance>(node, type)) {
+			OptimizeAll(instance->args_);
+		} else if (auto *stringify = As<Stringify>(node, type)) {
+			return OptimizeUnary(move(statement), *stringify);
+		} else if (auto *negate = As<Negate>(node, type)) {
+			return OptimizeUnary(move(statement), *negate);
+		} else if (auto *not_operation = As<Not>(node, type)) {
+			return OptimizeUnary(move(statement), *not_operation);
+		} else if (auto *add = As<Add>(node, type)) {
+			return OptimizeBinary(move(statement), *add);
+		} else if (auto *sub = As<Sub>(node, type)) {
+			return OptimizeBinary(move(statement), *sub);
+		} else if (auto *mult = As<Mult>(node, type)) {
+			return OptimizeMult(move(statement), *mult);
+		} else if (auto *div = As<Div>(node, type)) {
+			return OptimizeBinary(move(statement), *div);
+		} else if (auto *comparison = AsComparison(node, type)) {
+			return OptimizeBinary(move(statement), *comparison);
+		} else if (auto *or_operation = As<Or>(node, type)) {
+			return OptimizeLogical(move(statement), *or_operation, true);
+		} else if (auto *and_operation = As<And>(node, type)) {
+			return OptimizeLogical(move(statement), *and_operation, false);
+		} else if (auto *compound = As<Compound>(node, type)) {
+			OptimizeCompound(*compound);
+		} else if (auto *body = As<MethodBody>(node, type)) {
+			body->body_ = Optimize(move(body->body_));
+		} else if (auto *return_statement = As<Return>(node, type)) {
+			return_statement->statement_ = Optimize(move(return_statement->statement_));
+		} else if (auto *definition = As<ClassDefinition>(node, type)) {
+			OptimizeMethods(*definition->cls_.TryAs<runtime::Class>());
+		} else if (auto *if_else = As<IfElse>(node, type)) {
+			return OptimizeIfElse(move(statement), *if_else);
+		}
+		return statement;
+	}
+
+	void OptimizeAll(vector<StatementPtr> &statements) {
+		for (StatementPtr &statement : statements) {
+			statement = Optimize(move(statement));
+		}
+	}
+};
+
+OptimizationStats Optimize(Program &program) {
+	Optimizer optimizer(program.GetArena(), Optimizer::AnalyzeClasses(program.GetClasses()));
+	optimizer.OptimizeProgram(program);
+	return optimizer.GetStats();
+}
+
+}  // namespace ast
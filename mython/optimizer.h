@@ -0,0 +1,33 @@
+#pragma once
+
+#include "statement.h"
+
+#include <cstddef>
+
+namespace ast {
+
+// Статистика упрощений дерева программы
+struct OptimizationStats {
+    size_t folded_constants = 0;     // выражений, заменённых константой
+    size_t negations = 0;            // умножений на -1, заменённых узлом Negate
+    size_t resolved_conditions = 0;  // инструкций if с постоянным условием
+    size_t dropped_statements = 0;   // недостижимых инструкций после return
+    size_t devirtualized_calls = 0;  // вызовов self.method(...), связанных с методом
+};
+
+/*
+Упрощает программу, созданную ParseProgram:
+- вычисляет арифметические и логические операции и сравнения, аргументы которых - константы
+- заменяет умножение на -1, которым парсер записывает унарный минус, константой либо узлом Negate
+- заменяет инструкцию if с постоянным условием той веткой, которая была бы выполнена
+- удаляет инструкции составной инструкции, следующие за return
+- связывает вызов self.method(...) в методе класса с методом, найденным в этом классе, если ни
+  один потомок класса не переопределяет метод и self в методе не присваивается. Такой вызов не
+  ищет метод по имени при выполнении. Потомки известны по классам программы (Program::GetClasses)
+Тела методов, которые ещё не разобраны, упрощаются после разбора; они не входят в статистику.
+Новые узлы создаются в арене программы. Операции над константами, которые выбрасывают
+исключение (например, деление на ноль), не вычисляются и выбрасывают его при выполнении программы
+*/
+OptimizationStats Optimize(Program& program);
+
+}  // namespace ast
@@ -3,55 +3,114 @@
 #include "lexer.h"
 #include "statement.h"
 
+#include <atomic>
+#include <cassert>
+#include <exception>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+
 using namespace std;
 
 namespace TokenType = parse::token_type;
 
 namespace {
-bool operator==(const parse::Token& token, char c) {
-    const auto* p = token.TryAs<TokenType::Char>();
-    return p != nullptr && p->value == c;
-}
+const runtime::Symbol SELF = "self"sv;
+
+// Classes of the program in the order of declaration. The objects are owned by the nodes of
+// class definitions
+struct DeclaredClasses {
+    unordered_map<runtime::Symbol, size_t> indices;
+    vector<const runtime::Class*> classes;
+};
 
-bool operator!=(const parse::Token& token, char c) {
-    return !(token == c);
-}
+// The body of a method that is parsed after the rest of the program, in parallel with other
+// bodies. The method gets its body when its class is created and the body is parsed
+struct MethodJob {
+    parse::TokenBuffer tokens;
+    size_t visible_classes = 0;
+    runtime::Method method;  // the name and the parameters, the body is parsed into it
+    runtime::Class* cls = nullptr;
+    size_t index = 0;  // of the method in the class
+    exception_ptr error;
+};
 
 class Parser {
 public:
-    explicit Parser(parse::Lexer& lexer)
-        : lexer_(lexer) {
+    // Nodes of the tree are created in arena. Only the first visible_classes classes can be
+    // instantiated or inherited: a method body parsed lazily sees the classes declared before it
+    Parser(parse::Lexer& lexer, ast::Arena& arena, shared_ptr<DeclaredClasses> declared_classes,
+           ParseOptions options, size_t visible_classes = numeric_limits<size_t>::max())
+        : lexer_(lexer)
+        , arena_(arena)
+        , declared_classes_(std::move(declared_classes))
+        , visible_classes_(visible_classes)
+        , options_(options) {
     }
 
     // Program -> eps
     //          | Statement \n Program
-    unique_ptr<ast::Statement> ParseProgram() {
-        auto result = make_unique<ast::Compound>();
-        while (!lexer_.CurrentToken().Is<TokenType::Eof>()) {
-            result->AddStatement(ParseStatement());
+    ast::StatementPtr ParseProgram() {
+        vector<MethodJob> method_jobs;
+        if (!options_.lazy_methods && options_.threads > 1) {
+            method_jobs_ = &method_jobs;
         }
 
-        return result;
+        auto* result = arena_.Make<ast::Compound>();
+        try {
+            while (!lexer_.Is<TokenType::Eof>()) {
+                result->AddStatement(ParseStatement());
+            }
+        } catch (...) {
+            // The methods scanned before the error come before it in the program
+            if (method_jobs_ != nullptr) {
+                ParseMethodJobs();
+            }
+            throw;
+        }
+
+        if (method_jobs_ != nullptr) {
+            ParseMethodJobs();
+            for (MethodJob& job : method_jobs) {
+                runtime::Method& method = job.cls->GetMethods()[job.index];
+                method.body = std::move(job.method.body);
+                method.frame_size = job.method.frame_size;
+            }
+        }
+        return Borrow(result);
     }
 
 private:
+    // Nodes are owned by the arena, pointers to them do not delete them
+    static ast::StatementPtr Borrow(ast::Statement* node) {
+        return {node, runtime::ExecutableDeleter::NonOwning()};
+    }
+
+    template <typename T, typename... Args>
+    ast::StatementPtr Make(Args&&... args) {
+        return Borrow(arena_.Make<T>(std::forward<Args>(args)...));
+    }
+
     // Suite -> NEWLINE INDENT (Statement)+ DEDENT
-    unique_ptr<ast::Statement> ParseSuite()  // NOLINT
+    ast::StatementPtr ParseSuite()  // NOLINT
     {
         lexer_.Expect<TokenType::Newline>();
         lexer_.ExpectNext<TokenType::Indent>();
 
-        lexer_.NextToken();
+        lexer_.Advance();
 
-        auto result = make_unique<ast::Compound>();
-        while (!lexer_.CurrentToken().Is<TokenType::Dedent>()) {
+        auto* result = arena_.Make<ast::Compound>();
+        while (!lexer_.Is<TokenType::Dedent>()) {
             result->AddStatement(ParseStatement());  // NOLINT
         }
 
         lexer_.Expect<TokenType::Dedent>();
-        lexer_.NextToken();
+        lexer_.Advance();
 
-        return result;
+        return Borrow(result);
     }
 
     // Methods -> [def id(Params) : Suite]*
@@ -59,76 +118,219 @@ private:
     {
         vector<runtime::Method> result;
 
-        while (lexer_.CurrentToken().Is<TokenType::Def>()) {
+        while (lexer_.Is<TokenType::Def>()) {
             runtime::Method m;
 
             m.name = lexer_.ExpectNext<TokenType::Id>().value;
             lexer_.ExpectNext<TokenType::Char>('(');
 
-            if (lexer_.NextToken().Is<TokenType::Id>()) {
-                m.formal_params.push_back(lexer_.Expect<TokenType::Id>().value);
-                while (lexer_.NextToken() == ',') {
+            lexer_.Advance();
+            if (lexer_.Is<TokenType::Id>()) {
+                m.formal_params.push_back(lexer_.Get<TokenType::Id>().value);
+                lexer_.Advance();
+                while (lexer_.IsChar(',')) {
                     m.formal_params.push_back(lexer_.ExpectNext<TokenType::Id>().value);
+                    lexer_.Advance();
                 }
             }
 
             lexer_.Expect<TokenType::Char>(')');
             lexer_.ExpectNext<TokenType::Char>(':');
-            lexer_.NextToken();
-
-            m.body = std::make_unique<ast::MethodBody>(ParseSuite());  // NOLINT
+            lexer_.Advance();
 
+            if (options_.lazy_methods || method_jobs_ != nullptr) {
+                ScanMethodBody(m, result.size());
+            } else {
+                ParseMethodBody(m);  // NOLINT
+            }
             result.push_back(std::move(m));
         }
         return result;
     }
 
+    // Parses the body of method m and sets its frame size
+    void ParseMethodBody(runtime::Method& m)  // NOLINT
+    {
+        // A class can be declared inside of a method, its methods get their own scopes
+        optional<MethodScope> outer_scope = std::move(scope_);
+        scope_.emplace();
+        for (const runtime::Symbol& param : m.formal_params) {
+            scope_->slots[param] = scope_->frame_size++;
+        }
+        scope_->slots[SELF] = scope_->frame_size++;
+
+        m.body = Make<ast::MethodBody>(ParseSuite());  // NOLINT
+        m.frame_size = scope_->frame_size;
+        scope_ = std::move(outer_scope);
+    }
+
+    // Most method bodies fit, so their token buffers rarely grow
+    static constexpr size_t METHOD_TOKENS = 64;
+
+    // Copies the tokens of the body of method m, from the Newline before it to its Dedent,
+    // and leaves the body to be parsed on the first call or by a method job. A body that
+    // declares a class is parsed at once, as the code after the method can use the class.
+    // index is the number of the method in its class
+    void ScanMethodBody(runtime::Method& m, size_t index) {
+        auto tokens = make_shared<parse::TokenBuffer>();
+        tokens->Reserve(METHOD_TOKENS);
+        lexer_.Expect<TokenType::Newline>();
+        lexer_.CopyCurrentToken(*tokens);
+        lexer_.ExpectNext<TokenType::Indent>();
+        lexer_.CopyCurrentToken(*tokens);
+
+        bool declares_class = false;
+        for (size_t depth = 1; depth > 0;) {
+            lexer_.Advance();
+            if (lexer_.Is<TokenType::Indent>()) {
+                ++depth;
+            } else if (lexer_.Is<TokenType::Dedent>()) {
+                --depth;
+            } else if (lexer_.Is<TokenType::Class>()) {
+                declares_class = true;
+            } else if (lexer_.Is<TokenType::Eof>()) {
+                throw ParseError("Unexpected end of the body of method "s + m.name.Name());
+            }
+            lexer_.CopyCurrentToken(*tokens);
+        }
+        lexer_.Advance();
+        tokens->Push<TokenType::Eof>();
+
+        const size_t visible_classes = min(visible_classes_, declared_classes_->classes.size());
+        if (declares_class) {
+            parse::Lexer body_lexer(std::move(*tokens));
+            Parser body_parser(body_lexer, arena_, declared_classes_, options_, visible_classes_);
+            body_parser.method_jobs_ = method_jobs_;
+            body_parser.ParseMethodBody(m);
+            return;
+        }
+        if (method_jobs_ != nullptr) {
+            MethodJob& job = method_jobs_->emplace_back();
+            job.tokens = std::move(*tokens);
+            job.visible_classes = visible_classes;
+            job.method.name = m.name;
+            job.method.formal_params = m.formal_params;
+            job.index = index;
+            return;
+        }
+        m.build = [tokens, &arena = arena_, declared_classes = declared_classes_,
+                   options = options_, visible_classes](runtime::Method& method) {
+            parse::Lexer body_lexer(std::move(*tokens));
+            Parser(body_lexer, arena, declared_classes, options, visible_classes)
+                .ParseMethodBody(method);
+        };
+    }
+
+    // Parses the bodies of the method jobs on up to options_.threads threads. Every thread
+    // creates nodes in an arena of its own, the arenas are merged into arena_ afterwards.
+    // Throws the error of the first method that failed to parse
+    void ParseMethodJobs() {
+        vector<MethodJob>& jobs = *method_jobs_;
+        method_jobs_ = nullptr;
+        const size_t thread_count = min(options_.threads, jobs.size());
+        if (thread_count == 0) {
+            return;
+        }
+
+        vector<ast::Arena> arenas(thread_count);
+        atomic<size_t> next_job = 0;
+        auto parse_jobs = [&](ast::Arena& arena) {
+            for (size_t i = next_job++; i < jobs.size(); i = next_job++) {
+                MethodJob& job = jobs[i];
+                try {
+                    parse::Lexer body_lexer(std::move(job.tokens));
+                    Parser(body_lexer, arena, declared_classes_, options_, job.visible_classes)
+                        .ParseMethodBody(job.method);
+                } catch (...) {
+                    job.error = current_exception();
+                }
+            }
+        };
+        vector<thread> threads;
+        for (size_t i = 1; i < thread_count; ++i) {
+            threads.emplace_back(parse_jobs, ref(arenas[i]));
+        }
+        parse_jobs(arenas[0]);
+        for (thread& t : threads) {
+            t.join();
+        }
+
+        for (ast::Arena& arena : arenas) {
+            arena_.Merge(arena);
+        }
+        for (const MethodJob& job : jobs) {
+            if (job.error) {
+                rethrow_exception(job.error);
+            }
+        }
+    }
+
+    // Returns the declared class visible to this parser or nullptr
+    const runtime::Class* FindClass(runtime::Symbol name) const {
+        auto it = declared_classes_->indices.find(name);
+        if (it == declared_classes_->indices.end() || it->second >= visible_classes_) {
+            return nullptr;
+        }
+        return declared_classes_->classes[it->second];
+    }
+
     // ClassDefinition -> Id ['(' Id ')'] : new_line indent MethodList dedent
-    unique_ptr<ast::Statement> ParseClassDefinition()  // NOLINT
+    ast::StatementPtr ParseClassDefinition()  // NOLINT
     {
-        string class_name = lexer_.Expect<TokenType::Id>().value;
+        string class_name = lexer_.Expect<TokenType::Id>().value.Name();
 
-        lexer_.NextToken();
+        lexer_.Advance();
 
         const runtime::Class* base_class = nullptr;
-        if (lexer_.CurrentToken() == '(') {
-            auto name = lexer_.ExpectNext<TokenType::Id>().value;
+        if (lexer_.IsChar('(')) {
+            string name = lexer_.ExpectNext<TokenType::Id>().value.Name();
             lexer_.ExpectNext<TokenType::Char>(')');
-            lexer_.NextToken();
+            lexer_.Advance();
 
-            auto it = declared_classes_.find(name);
-            if (it == declared_classes_.end()) {
+            base_class = FindClass(name);
+            if (base_class == nullptr) {
                 throw ParseError("Base class "s + name + " not found for class "s + class_name);
             }
-            base_class = static_cast<const runtime::Class*>(it->second.Get());  // NOLINT
         }
 
         lexer_.Expect<TokenType::Char>(':');
         lexer_.ExpectNext<TokenType::Newline>();
         lexer_.ExpectNext<TokenType::Indent>();
         lexer_.ExpectNext<TokenType::Def>();
+        const size_t first_job = method_jobs_ != nullptr ? method_jobs_->size() : 0;
         vector<runtime::Method> methods = ParseMethods();  // NOLINT
 
         lexer_.Expect<TokenType::Dedent>();
-        lexer_.NextToken();
+        lexer_.Advance();
 
-        auto [it, inserted] = declared_classes_.insert({
-            class_name,
-            runtime::ObjectHolder::Own(runtime::Class(class_name, std::move(methods), base_class)),
-        });
+        auto [it, inserted] = declared_classes_->indices.emplace(
+            class_name, declared_classes_->classes.size());
 
         if (!inserted) {
             throw ParseError("Class "s + class_name + " already exists"s);
         }
 
-        return make_unique<ast::ClassDefinition>(it->second);
+        auto cls = runtime::ObjectHolder::Own(
+            runtime::Class(class_name, std::move(methods), base_class));
+        declared_classes_->classes.push_back(cls.TryAs<runtime::Class>());
+        if (method_jobs_ != nullptr) {
+            // Classes declared in the methods have taken their jobs already
+            for (size_t i = first_job; i < method_jobs_->size(); ++i) {
+                if ((*method_jobs_)[i].cls == nullptr) {
+                    (*method_jobs_)[i].cls = cls.TryAs<runtime::Class>();
+                }
+            }
+        }
+        return Make<ast::ClassDefinition>(cls);
     }
 
-    vector<string> ParseDottedIds() {
-        vector<string> result(1, lexer_.Expect<TokenType::Id>().value);
+    vector<runtime::Symbol> ParseDottedIds() {
+        vector<runtime::Symbol> result(1, lexer_.Expect<TokenType::Id>().value);
 
-        while (lexer_.NextToken() == '.') {
+        lexer_.Advance();
+        while (lexer_.IsChar('.')) {
             result.push_back(lexer_.ExpectNext<TokenType::Id>().value);
+            lexer_.Advance();
         }
 
         return result;
@@ -136,313 +338,516 @@ private:
 
     //  AssgnOrCall -> DottedIds = Expr
     //               | DottedIds '(' ExprList ')'
-    unique_ptr<ast::Statement> ParseAssignmentOrCall() {
+    ast::StatementPtr ParseAssignmentOrCall() {
         lexer_.Expect<TokenType::Id>();
 
-        vector<string> id_list = ParseDottedIds();
-        string last_name = id_list.back();
+        vector<runtime::Symbol> id_list = ParseDottedIds();
+        runtime::Symbol last_name = id_list.back();
         id_list.pop_back();
 
-        if (lexer_.CurrentToken() == '=') {
-            lexer_.NextToken();
+        if (lexer_.IsChar('=')) {
+            lexer_.Advance();
 
             if (id_list.empty()) {
-                return make_unique<ast::Assignment>(std::move(last_name), ParseTest());
+                auto value = ParseTest();
+                // The variable gets its slot after the value is parsed: x = x + 1 reads x
+                // by name if x is not assigned before
+                const uint32_t slot = DeclareSlot(last_name);
+                return Make<ast::Assignment>(std::move(last_name), std::move(value), slot);
             }
-            return make_unique<ast::FieldAssignment>(ast::VariableValue{std::move(id_list)},
+            const uint32_t slot = FindSlot(id_list.front());
+            return Make<ast::FieldAssignment>(ast::VariableValue{std::move(id_list), slot},
                                                      std::move(last_name), ParseTest());
         }
         lexer_.Expect<TokenType::Char>('(');
-        lexer_.NextToken();
+        lexer_.Advance();
 
         if (id_list.empty()) {
-            throw ParseError("Mython doesn't support functions, only methods: "s + last_name);
+            throw ParseError("Mython doesn't support functions, only methods: "s
+                             + last_name.Name());
         }
 
-        vector<unique_ptr<ast::Statement>> args;
-        if (lexer_.CurrentToken() != ')') {
+        vector<ast::StatementPtr> args;
+        if (!lexer_.IsChar(')')) {
             args = ParseTestList();
         }
         lexer_.Expect<TokenType::Char>(')');
-        lexer_.NextToken();
+        lexer_.Advance();
 
-        return make_unique<ast::MethodCall>(make_unique<ast::VariableValue>(std::move(id_list)),
+        const uint32_t slot = FindSlot(id_list.front());
+        return Make<ast::MethodCall>(Make<ast::VariableValue>(std::move(id_list), slot),
                                             std::move(last_name), std::move(args));
     }
 
-    // Expr -> Adder ['+'/'-' Adder]*
-    unique_ptr<ast::Statement> ParseExpression()  // NOLINT
+    // Condition -> if LogicalExpr: Suite [else: Suite]
+    ast::StatementPtr ParseCondition()  // NOLINT
     {
-        unique_ptr<ast::Statement> result = ParseAdder();
-        while (lexer_.CurrentToken() == '+' || lexer_.CurrentToken() == '-') {
-            char op = lexer_.CurrentToken().As<TokenType::Char>().value;
-            lexer_.NextToken();
+        lexer_.Expect<TokenType::If>();
+        lexer_.Advance();
 
-            if (op == '+') {
-                result = make_unique<ast::Add>(std::move(result), ParseAdder());
-            } else {
-                result = make_unique<ast::Sub>(std::move(result), ParseAdder());
-            }
-        }
-        return result;
-    }
+        auto condition = ParseTest();
 
-    // Adder -> Mult ['*'/'/' Mult]*
-    unique_ptr<ast::Statement> ParseAdder()  // NOLINT
-    {
-        unique_ptr<ast::Statement> result = ParseMult();
-        while (lexer_.CurrentToken() == '*' || lexer_.CurrentToken() == '/') {
-            char op = lexer_.CurrentToken().As<TokenType::Char>().value;
-            lexer_.NextToken();
+        lexer_.Expect<TokenType::Char>(':');
+        lexer_.Advance();
 
-            if (op == '*') {
-                result = make_unique<ast::Mult>(std::move(result), ParseMult());
-            } else {
-                result = make_unique<ast::Div>(std::move(result), ParseMult());
-            }
+        auto if_body = ParseSuite();
+
+        ast::StatementPtr else_body;
+        if (lexer_.Is<TokenType::Else>()) {
+            lexer_.ExpectNext<TokenType::Char>(':');
+            lexer_.Advance();
+            else_body = ParseSuite();
         }
-        return result;
+
+        return Make<ast::IfElse>(std::move(condition), std::move(if_body),
+                                        std::move(else_body));
     }
 
-    // Mult -> '(' Expr ')'
-    //       | NUMBER
+    // Test -> AndTest [or AndTest]*
+    // AndTest -> NotTest [and NotTest]*
+    // NotTest -> not NotTest
+    //          | Comparison
+    // Comparison -> Expr [COMP_OP Expr]
+    // Expr -> Adder ['+'/'-' Adder]*
+    // Adder -> Mult ['*'/'/' Mult]*
+    // Mult -> '(' Test ')'
     //       | '-' Mult
+    //       | NUMBER
     //       | STRING
     //       | NONE
     //       | TRUE
     //       | FALSE
-    //       | DottedIds '(' ExprList ')'
+    //       | DottedIds '(' [TestList] ')'
     //       | DottedIds
-    unique_ptr<ast::Statement> ParseMult()  // NOLINT
-    {
-        if (lexer_.CurrentToken() == '(') {
-            lexer_.NextToken();
-            auto result = ParseTest();
-            lexer_.Expect<TokenType::Char>(')');
-            lexer_.NextToken();
-            return result;
-        }
-        if (lexer_.CurrentToken() == '-') {
-            lexer_.NextToken();
-            return make_unique<ast::Mult>(ParseMult(), make_unique<ast::NumericConst>(-1));
-        }
-        if (const auto* num = lexer_.CurrentToken().TryAs<TokenType::Number>()) {
-            int result = num->value;
-            lexer_.NextToken();
-            return make_unique<ast::NumericConst>(result);
-        }
-        if (const auto* str = lexer_.CurrentToken().TryAs<TokenType::String>()) {
-            string result = str->value;
-            lexer_.NextToken();
-            return make_unique<ast::StringConst>(std::move(result));
-        }
-        if (lexer_.CurrentToken().Is<TokenType::True>()) {
-            lexer_.NextToken();
-            return make_unique<ast::BoolConst>(runtime::Bool(true));
-        }
-        if (lexer_.CurrentToken().Is<TokenType::False>()) {
-            lexer_.NextToken();
-            return make_unique<ast::BoolConst>(runtime::Bool(false));
-        }
-        if (lexer_.CurrentToken().Is<TokenType::None>()) {
-            lexer_.NextToken();
-            return make_unique<ast::None>();
-        }
-
-        return ParseDottedIdsInMultExpr();
-    }
-
-    std::unique_ptr<ast::Statement> ParseDottedIdsInMultExpr() {
-        vector<string> names = ParseDottedIds();
-
-        if (lexer_.CurrentToken() == '(') {
-            // various calls
-            vector<unique_ptr<ast::Statement>> args;
-            if (lexer_.NextToken() != ')') {
-                args = ParseTestList();
-            }
+    //
+    // The grammar is parsed by precedence climbing. Operands and pending operators are kept in
+    // explicit stacks instead of a recursive call per level, so the nesting depth of
+    // parentheses, calls and unary operators is not limited by the C++ stack
+    ast::StatementPtr ParseTest() {
+        [[maybe_unused]] const size_t operand_base = operands_.size();
+        const size_t operator_base = operators_.size();
+        do {
+            ParseOperand(operator_base);
+        } while (ParseOperator(operator_base));
+
+        ReduceToFrame(operator_base);
+        if (operators_.size() > operator_base) {
+            // A parenthesis or a call is not closed
             lexer_.Expect<TokenType::Char>(')');
-            lexer_.NextToken();
-
-            auto method_name = names.back();
-            names.pop_back();
-
-            if (!names.empty()) {
-                return make_unique<ast::MethodCall>(
-                    make_unique<ast::VariableValue>(std::move(names)), std::move(method_name),
-                    std::move(args));
-            }
-            if (auto it = declared_classes_.find(method_name); it != declared_classes_.end()) {
-                return make_unique<ast::NewInstance>(
-                    static_cast<const runtime::Class&>(*it->second), std::move(args));  // NOLINT
-            }
-            if (method_name == "str"sv) {
-                if (args.size() != 1) {
-                    throw ParseError("Function str takes exactly one argument"s);
-                }
-                return make_unique<ast::Stringify>(std::move(args.front()));
-            }
-            throw ParseError("Unknown call to "s + method_name + "()"s);
         }
-        return make_unique<ast::VariableValue>(std::move(names));
+        ast::StatementPtr result = std::move(operands_.back());
+        operands_.pop_back();
+        assert(operands_.size() == operand_base);
+        return result;
     }
 
-    vector<unique_ptr<ast::Statement>> ParseTestList()  // NOLINT
+    vector<ast::StatementPtr> ParseTestList()  // NOLINT
     {
-        vector<unique_ptr<ast::Statement>> result;
+        vector<ast::StatementPtr> result;
         result.push_back(ParseTest());
 
-        while (lexer_.CurrentToken() == ',') {
-            lexer_.NextToken();
+        while (lexer_.IsChar(',')) {
+            lexer_.Advance();
             result.push_back(ParseTest());
         }
         return result;
     }
 
-    // Condition -> if LogicalExpr: Suite [else: Suite]
-    unique_ptr<ast::Statement> ParseCondition()  // NOLINT
+    // Statement -> SimpleStatement Newline
+    //           | class ClassDefinition
+    //           | if Condition
+    ast::StatementPtr ParseStatement()  // NOLINT
     {
-        lexer_.Expect<TokenType::If>();
-        lexer_.NextToken();
-
-        auto condition = ParseTest();
 
-        lexer_.Expect<TokenType::Char>(':');
-        lexer_.NextToken();
+        if (lexer_.Is<TokenType::Class>()) {
+            lexer_.Advance();
+            return ParseClassDefinition();  // NOLINT
+        }
+        if (lexer_.Is<TokenType::If>()) {
+            return ParseCondition();
+        }
+        auto result = ParseSimpleStatement();
+        lexer_.Expect<TokenType::Newline>();
+        lexer_.Advance();
+        return result;
+    }
 
-        auto if_body = ParseSuite();
+    // StatementBody -> return Expression
+    //               | print ExpressionList
+    //               | AssignmentOrCall
+    ast::StatementPtr ParseSimpleStatement() {
 
-        unique_ptr<ast::Statement> else_body;
-        if (lexer_.CurrentToken().Is<TokenType::Else>()) {
-            lexer_.ExpectNext<TokenType::Char>(':');
-            lexer_.NextToken();
-            else_body = ParseSuite();
+        if (lexer_.Is<TokenType::Return>()) {
+            lexer_.Advance();
+            return Make<ast::Return>(ParseTest());
         }
-
-        return make_unique<ast::IfElse>(std::move(condition), std::move(if_body),
-                                        std::move(else_body));
+        if (lexer_.Is<TokenType::Print>()) {
+            lexer_.Advance();
+            vector<ast::StatementPtr> args;
+            if (!lexer_.Is<TokenType::Newline>()) {
+                args = ParseTestList();
+            }
+            return Make<ast::Print>(std::move(args));
+        }
+        return ParseAssignmentOrCall();
     }
 
-    // LogicalExpr -> AndTest [OR AndTest]
-    // AndTest -> NotTest [AND NotTest]
-    // NotTest -> [NOT] NotTest
-    //          | Comparison
-    unique_ptr<ast::Statement> ParseTest()  // NOLINT
-    {
-        auto result = ParseAndTest();
-        while (lexer_.CurrentToken().Is<TokenType::Or>()) {
-            lexer_.NextToken();
-            result = make_unique<ast::Or>(std::move(result), ParseAndTest());
+    // Operators of expressions and the frames of ParseTest: an opening parenthesis and a call,
+    // whose names are in calls_
+    enum class Operator : uint8_t {
+        Or,
+        And,
+        Not,
+        Less,
+        Greater,
+        Equal,
+        NotEqual,
+        LessOrEqual,
+        GreaterOrEqual,
+        Add,
+        Sub,
+        Mult,
+        Div,
+        Negate,
+        Parenthesis,
+        Call,
+    };
+
+    struct PendingOperator {
+        Operator op;
+        size_t operand_base = 0;  // operands before the arguments of a call
+    };
+
+    static constexpr int COMPARISON_PRECEDENCE = 4;
+
+    // Frames have the lowest precedence, so reducing operators stops at them
+    static int Precedence(Operator op) {
+        switch (op) {
+            case Operator::Or:
+                return 1;
+            case Operator::And:
+                return 2;
+            case Operator::Not:
+                return 3;
+            case Operator::Add:
+            case Operator::Sub:
+                return 5;
+            case Operator::Mult:
+            case Operator::Div:
+                return 6;
+            case Operator::Negate:
+                return 7;
+            case Operator::Parenthesis:
+            case Operator::Call:
+                return 0;
+            default:
+                return COMPARISON_PRECEDENCE;
         }
-        return result;
     }
 
-    unique_ptr<ast::Statement> ParseAndTest()  // NOLINT
-    {
-        auto result = ParseNotTest();
-        while (lexer_.CurrentToken().Is<TokenType::And>()) {
-            lexer_.NextToken();
-            result = make_unique<ast::And>(std::move(result), ParseNotTest());
+    optional<Operator> BinaryOperator() const {
+        if (lexer_.Is<TokenType::Or>()) {
+            return Operator::Or;
+        }
+        if (lexer_.Is<TokenType::And>()) {
+            return Operator::And;
+        }
+        if (lexer_.Is<TokenType::Eq>()) {
+            return Operator::Equal;
+        }
+        if (lexer_.Is<TokenType::NotEq>()) {
+            return Operator::NotEqual;
+        }
+        if (lexer_.Is<TokenType::LessOrEq>()) {
+            return Operator::LessOrEqual;
+        }
+        if (lexer_.Is<TokenType::GreaterOrEq>()) {
+            return Operator::GreaterOrEqual;
+        }
+        if (!lexer_.Is<TokenType::Char>()) {
+            return nullopt;
+        }
+        switch (lexer_.Get<TokenType::Char>().value) {
+            case '<':
+                return Operator::Less;
+            case '>':
+                return Operator::Greater;
+            case '+':
+                return Operator::Add;
+            case '-':
+                return Operator::Sub;
+            case '*':
+                return Operator::Mult;
+            case '/':
+                return Operator::Div;
+            default:
+                return nullopt;
         }
-        return result;
     }
 
-    unique_ptr<ast::Statement> ParseNotTest()  // NOLINT
-    {
-        if (lexer_.CurrentToken().Is<TokenType::Not>()) {
-            lexer_.NextToken();
-            return make_unique<ast::Not>(ParseNotTest());  // NOLINT
+    // not starts a NotTest: an operand of or, and, not, of a parenthesized expression or
+    // an argument, but not of a comparison, an arithmetic operator or a unary minus
+    bool IsNotAllowed(size_t operator_base) const {
+        if (operators_.size() == operator_base) {
+            return true;
+        }
+        switch (operators_.back().op) {
+            case Operator::Or:
+            case Operator::And:
+            case Operator::Not:
+            case Operator::Parenthesis:
+            case Operator::Call:
+                return true;
+            default:
+                return false;
         }
-        return ParseComparison();
     }
 
-    // Comparison -> Expr [COMP_OP Expr]
-    unique_ptr<ast::Statement> ParseComparison()  // NOLINT
-    {
-        auto result = ParseExpression();
+    // Reads prefix operators and opening parentheses up to an operand and pushes the operand
+    void ParseOperand(size_t operator_base) {
+        while (true) {
+            if (lexer_.IsChar('(')) {
+                lexer_.Advance();
+                operators_.push_back({Operator::Parenthesis});
+            } else if (lexer_.IsChar('-')) {
+                lexer_.Advance();
+                operators_.push_back({Operator::Negate});
+            } else if (lexer_.Is<TokenType::Not>() && IsNotAllowed(operator_base)) {
+                lexer_.Advance();
+                operators_.push_back({Operator::Not});
+            } else if (ParseLiteral()) {
+                return;
+            } else {
+                vector<runtime::Symbol> names = ParseDottedIds();
+                if (!lexer_.IsChar('(')) {
+                    const uint32_t slot = FindSlot(names.front());
+                    operands_.push_back(Make<ast::VariableValue>(std::move(names), slot));
+                    return;
+                }
+                lexer_.Advance();
+                if (lexer_.IsChar(')')) {
+                    lexer_.Advance();
+                    operands_.push_back(MakeCall(std::move(names), {}));
+                    return;
+                }
+                // The first argument follows
+                calls_.push_back(std::move(names));
+                operators_.push_back({Operator::Call, operands_.size()});
+            }
+        }
+    }
 
-        const auto& tok = lexer_.CurrentToken();
+    bool ParseLiteral() {
+        if (lexer_.Is<TokenType::Number>()) {
+            operands_.push_back(Make<ast::NumericConst>(lexer_.Get<TokenType::Number>().value));
+        } else if (lexer_.Is<TokenType::String>()) {
+            operands_.push_back(
+                Make<ast::StringConst>(string(lexer_.Get<TokenType::String>().value)));
+        } else if (lexer_.Is<TokenType::True>()) {
+            operands_.push_back(Make<ast::BoolConst>(runtime::Bool(true)));
+        } else if (lexer_.Is<TokenType::False>()) {
+            operands_.push_back(Make<ast::BoolConst>(runtime::Bool(false)));
+        } else if (lexer_.Is<TokenType::None>()) {
+            operands_.push_back(Make<ast::None>());
+        } else {
+            return false;
+        }
+        lexer_.Advance();
+        return true;
+    }
 
-        if (tok == '<') {
-            lexer_.NextToken();
-            return make_unique<ast::Comparison>(runtime::Less, std::move(result),
-                                                ParseExpression());
-        }
-        if (tok == '>') {
-            lexer_.NextToken();
-            return make_unique<ast::Comparison>(runtime::Greater, std::move(result),
-                                                ParseExpression());
-        }
-        if (tok.Is<TokenType::Eq>()) {
-            lexer_.NextToken();
-            return make_unique<ast::Comparison>(runtime::Equal, std::move(result),
-                                                ParseExpression());
-        }
-        if (tok.Is<TokenType::NotEq>()) {
-            lexer_.NextToken();
-            return make_unique<ast::Comparison>(runtime::NotEqual, std::move(result),
-                                                ParseExpression());
+    // Reads the operator after an operand. Closing parentheses complete the operand, so they
+    // are read in a loop. Returns false at the end of the expression: the token belongs to
+    // the statement or it is an error reported by ParseTest
+    bool ParseOperator(size_t operator_base) {
+        while (true) {
+            if (const optional<Operator> op = BinaryOperator()) {
+                const int precedence = Precedence(*op);
+                if (precedence == COMPARISON_PRECEDENCE) {
+                    // A comparison takes one operator, a < b < c ends at the second one
+                    ReduceWhile(operator_base, COMPARISON_PRECEDENCE + 1);
+                    if (operators_.size() > operator_base
+                        && Precedence(operators_.back().op) == COMPARISON_PRECEDENCE) {
+                        return false;
+                    }
+                } else {
+                    ReduceWhile(operator_base, precedence);
+                }
+                lexer_.Advance();
+                operators_.push_back({*op});
+                return true;
+            }
+            if (!lexer_.IsChar(')') && !lexer_.IsChar(',')) {
+                return false;
+            }
+            ReduceToFrame(operator_base);
+            if (operators_.size() == operator_base) {
+                return false;
+            }
+            const PendingOperator frame = operators_.back();
+            if (lexer_.IsChar(',')) {
+                if (frame.op != Operator::Call) {
+                    return false;
+                }
+                lexer_.Advance();
+                return true;
+            }
+            lexer_.Advance();
+            operators_.pop_back();
+            if (frame.op == Operator::Call) {
+                vector<ast::StatementPtr> args(
+                    make_move_iterator(operands_.begin() + frame.operand_base),
+                    make_move_iterator(operands_.end()));
+                operands_.resize(frame.operand_base);
+                operands_.push_back(MakeCall(std::move(calls_.back()), std::move(args)));
+                calls_.pop_back();
+            }
         }
-        if (tok.Is<TokenType::LessOrEq>()) {
-            lexer_.NextToken();
-            return make_unique<ast::Comparison>(runtime::LessOrEqual, std::move(result),
-                                                ParseExpression());
+    }
+
+    void ReduceWhile(size_t operator_base, int min_precedence) {
+        while (operators_.size() > operator_base
+               && Precedence(operators_.back().op) >= min_precedence) {
+            Reduce();
         }
-        if (tok.Is<TokenType::GreaterOrEq>()) {
-            lexer_.NextToken();
-            return make_unique<ast::Comparison>(runtime::GreaterOrEqual, std::move(result),
-                                                ParseExpression());
+    }
+
+    void ReduceToFrame(size_t operator_base) {
+        ReduceWhile(operator_base, 1);
+    }
+
+    // Replaces the top operands with the node of the top operator
+    void Reduce() {
+        const Operator op = operators_.back().op;
+        operators_.pop_back();
+        ast::StatementPtr rhs = std::move(operands_.back());
+        operands_.pop_back();
+        if (op == Operator::Not) {
+            operands_.push_back(Make<ast::Not>(std::move(rhs)));
+            return;
+        }
+        if (op == Operator::Negate) {
+            operands_.push_back(Make<ast::Mult>(std::move(rhs), Make<ast::NumericConst>(-1)));
+            return;
+        }
+        ast::StatementPtr& lhs = operands_.back();
+        switch (op) {
+            case Operator::Or:
+                lhs = Make<ast::Or>(std::move(lhs), std::move(rhs));
+                break;
+            case Operator::And:
+                lhs = Make<ast::And>(std::move(lhs), std::move(rhs));
+                break;
+            case Operator::Less:
+                lhs = Make<ast::Less>(std::move(lhs), std::move(rhs));
+                break;
+            case Operator::Greater:
+                lhs = Make<ast::Greater>(std::move(lhs), std::move(rhs));
+                break;
+            case Operator::Equal:
+                lhs = Make<ast::Equal>(std::move(lhs), std::move(rhs));
+                break;
+            case Operator::NotEqual:
+                lhs = Make<ast::NotEqual>(std::move(lhs), std::move(rhs));
+                break;
+            case Operator::LessOrEqual:
+                lhs = Make<ast::LessOrEqual>(std::move(lhs), std::move(rhs));
+                break;
+            case Operator::GreaterOrEqual:
+                lhs = Make<ast::GreaterOrEqual>(std::move(lhs), std::move(rhs));
+                break;
+            case Operator::Add:
+                lhs = Make<ast::Add>(std::move(lhs), std::move(rhs));
+                break;
+            case Operator::Sub:
+                lhs = Make<ast::Sub>(std::move(lhs), std::move(rhs));
+                break;
+            case Operator::Mult:
+                lhs = Make<ast::Mult>(std::move(lhs), std::move(rhs));
+                break;
+            case Operator::Div:
+                lhs = Make<ast::Div>(std::move(lhs), std::move(rhs));
+                break;
+            default:
+                assert(false);
         }
-        return result;
     }
 
-    // Statement -> SimpleStatement Newline
-    //           | class ClassDefinition
-    //           | if Condition
-    unique_ptr<ast::Statement> ParseStatement()  // NOLINT
-    {
-        const auto& tok = lexer_.CurrentToken();
+    // Call -> DottedIds '(' [TestList] ')': a method call, a new instance or str
+    ast::StatementPtr MakeCall(vector<runtime::Symbol> names, vector<ast::StatementPtr> args) {
+        auto method_name = names.back();
+        names.pop_back();
 
-        if (tok.Is<TokenType::Class>()) {
-            lexer_.NextToken();
-            return ParseClassDefinition();  // NOLINT
+        if (!names.empty()) {
+            const uint32_t slot = FindSlot(names.front());
+            return Make<ast::MethodCall>(Make<ast::VariableValue>(std::move(names), slot),
+                                         std::move(method_name), std::move(args));
         }
-        if (tok.Is<TokenType::If>()) {
-            return ParseCondition();
+        if (const runtime::Class* cls = FindClass(method_name)) {
+            return Make<ast::NewInstance>(*cls, std::move(args));  // NOLINT
         }
-        auto result = ParseSimpleStatement();
-        lexer_.Expect<TokenType::Newline>();
-        lexer_.NextToken();
-        return result;
+        if (method_name == "str"sv) {
+            if (args.size() != 1) {
+                throw ParseError("Function str takes exactly one argument"s);
+            }
+            return Make<ast::Stringify>(std::move(args.front()));
+        }
+        throw ParseError("Unknown call to "s + method_name.Name() + "()"s);
     }
 
-    // StatementBody -> return Expression
-    //               | print ExpressionList
-    //               | AssignmentOrCall
-    unique_ptr<ast::Statement> ParseSimpleStatement() {
-        const auto& tok = lexer_.CurrentToken();
+    // Variables of the method being parsed and their slots in the frame of the method.
+    // Statements of a method run in the order they are written, so a variable read before
+    // its first assignment has no value yet and is looked up by name to fail as before
+    struct MethodScope {
+        unordered_map<runtime::Symbol, uint32_t> slots;
+        uint32_t frame_size = 0;
+    };
+
+    // Returns the slot of the variable or NO_SLOT outside of methods and for variables that
+    // are not assigned yet
+    uint32_t FindSlot(runtime::Symbol name) const {
+        if (!scope_) {
+            return ast::NO_SLOT;
+        }
+        auto it = scope_->slots.find(name);
+        return it == scope_->slots.end() ? ast::NO_SLOT : it->second;
+    }
 
-        if (tok.Is<TokenType::Return>()) {
-            lexer_.NextToken();
-            return make_unique<ast::Return>(ParseTest());
+    // Returns the slot of the assigned variable, the first assignment adds it to the frame
+    uint32_t DeclareSlot(runtime::Symbol name) {
+        if (!scope_) {
+            return ast::NO_SLOT;
         }
-        if (tok.Is<TokenType::Print>()) {
-            lexer_.NextToken();
-            vector<unique_ptr<ast::Statement>> args;
-            if (!lexer_.CurrentToken().Is<TokenType::Newline>()) {
-                args = ParseTestList();
-            }
-            return make_unique<ast::Print>(std::move(args));
+        auto [it, inserted] = scope_->slots.emplace(name, scope_->frame_size);
+        if (inserted) {
+            ++scope_->frame_size;
         }
-        return ParseAssignmentOrCall();
+        return it->second;
     }
 
     parse::Lexer& lexer_;
-    runtime::Closure declared_classes_;
+    ast::Arena& arena_;
+    shared_ptr<DeclaredClasses> declared_classes_;
+    size_t visible_classes_;
+    ParseOptions options_;
+    optional<MethodScope> scope_;
+    // Bodies of methods to parse after the program when they are parsed by several threads
+    vector<MethodJob>* method_jobs_ = nullptr;
+    // Stacks of ParseTest, an expression uses their tops above the sizes they had before it
+    vector<ast::StatementPtr> operands_;
+    vector<PendingOperator> operators_;
+    vector<vector<runtime::Symbol>> calls_;
 };
 
 }  // namespace
 
-unique_ptr<runtime::Executable> ParseProgram(parse::Lexer& lexer) {
-    return Parser{lexer}.ParseProgram();
+unique_ptr<ast::Program> ParseProgram(parse::Lexer& lexer, ParseOptions options) {
+    auto program = make_unique<ast::Program>();
+    auto declared_classes = make_shared<DeclaredClasses>();
+    program->SetRoot(
+        Parser{lexer, program->GetArena(), declared_classes, options}.ParseProgram());
+    // Lazily parsed bodies declare no classes, so all of them are known now. The bodies still
+    // look the classes up, so they are copied
+    program->SetClasses(declared_classes->classes);
+    return program;
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <memory>
 #include <stdexcept>
 
@@ -7,12 +8,26 @@ namespace parse {
 class Lexer;
 }
 
-namespace runtime {
-class Executable;
+namespace ast {
+class Program;
 }
 
 struct ParseError : std::runtime_error {
     using std::runtime_error::runtime_error;
 };
 
-std::unique_ptr<runtime::Executable> ParseProgram(parse::Lexer& lexer);
\ No newline at end of file
+struct ParseOptions {
+    // Bodies of methods are only scanned: their tokens are kept and parsed when the method is
+    // called for the first time (see runtime::Method::build), so a syntax error in a method that
+    // is never called is not reported. Bodies that declare classes are parsed in place
+    bool lazy_methods = false;
+    // Unless lazy_methods is set, bodies of methods are scanned in the same way and parsed by up
+    // to this number of threads after the rest of the program. Classes are still declared in
+    // the order of the program, and an error in a method body is reported before the errors
+    // that follow it
+    size_t threads = 1;
+};
+
+// All nodes of the tree are created in the arena of the program and freed together with it,
+// method bodies parsed lazily too. So the program must outlive the calls of its methods
+std::unique_ptr<ast::Program> ParseProgram(parse::Lexer& lexer, ParseOptions options = {});
@@ -1,8 +1,15 @@
+#include "flat_ast.h"
 #include "lexer.h"
+#include "optimizer.h"
 #include "parse.h"
+#include "program_cache.h"
 #include "statement.h"
 #include "test_runner_p.h"
 
+#include <filesystem>
+#include <fstream>
+#include <typeinfo>
+
 using namespace std;
 
 namespace parse {
@@ -245,6 +252,878 @@ print r, c, t1, t2
                  "Rect(10x20) Circle(52) Triangle(3, 4, 5) Wrong triangle\n"s);
 }
 
+void TestProgramArena() {
+    const string program = R"(
+class Counter:
+  def __init__():
+    self.value = 0
+
+  def add(n):
+    self.value = self.value + n * 2 - 1
+    return self.value
+
+c = Counter()
+c.add(3)
+print c.add(1), 'done'
+)"s;
+
+    istringstream is(program);
+    parse::Lexer lexer(is);
+    auto tree = ParseProgram(lexer);
+
+    // Expressions own nothing outside the arena and are not destroyed one by one
+    const ast::Arena::Stats& stats = tree->GetArena().GetStats();
+    ASSERT(stats.object_count > 0);
+    ASSERT(stats.destructor_count < stats.object_count);
+    ASSERT(stats.bytes_used <= stats.bytes_reserved);
+    ASSERT(stats.block_count > 0);
+
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    tree->Execute(closure, context);
+
+    ASSERT_EQUAL(context.output.str(), "6 done\n"s);
+}
+
+// Runs the program over the tree and over its flat representation, the outputs must match
+string RunTreeAndFlat(const string& program) {
+    auto tree = ParseProgramFromString(program);
+    runtime::DummyContext tree_context;
+    runtime::Closure tree_closure;
+    tree->Execute(tree_closure, tree_context);
+
+    ast::FlatProgram flat(*tree);
+    runtime::DummyContext flat_context;
+    runtime::Closure flat_closure;
+    flat.Execute(flat_closure, flat_context);
+
+    ASSERT_EQUAL(flat_context.output.str(), tree_context.output.str());
+    return flat_context.output.str();
+}
+
+void TestFlatProgram() {
+    ASSERT_EQUAL(RunTreeAndFlat(R"(
+class Point:
+  def __init__(x, y):
+    self.x = x
+    self.y = y
+
+  def __eq__(other):
+    return self.x == other.x and self.y == other.y
+
+  def __lt__(other):
+    return self.x < other.x or self.x == other.x and self.y < other.y
+
+  def __str__():
+    return '(' + str(self.x) + ', ' + str(self.y) + ')'
+
+class Point3(Point):
+  def __init__(x, y, z):
+    self.x = x
+    self.y = y
+    self.z = z
+
+  def __add__(other):
+    return self.x + other.x + self.y + other.y
+
+p = Point(1, 2)
+q = Point3(1, 3, 5)
+print p, q, p == q, p < q, not p > q, p != q
+print q + p, -q.z * 2 / 3 - 1, str(None), 'a' + "b"
+if p.x >= 1:
+  p.x = p.x - 10
+else:
+  print 'unreachable'
+print p.x, p.y, q.z, True and False, None
+)"s),
+                 "(1, 2) (1, 3) False True True True\n7 -4 None ab\n-9 2 5 False None\n"s);
+
+    ASSERT_EQUAL(RunTreeAndFlat(R"(
+class Fib:
+  def calc(n):
+    if n < 2:
+      return n
+    return self.calc(n - 1) + self.calc(n - 2)
+
+  def first():
+    if True:
+      if True:
+        return 'inner'
+      return 'outer'
+    return 'last'
+
+f = Fib()
+print f.calc(15), f.first()
+)"s),
+                 "610 inner\n"s);
+}
+
+// Children precede their parents, statements of a compound follow each other
+void TestFlatProgramLayout() {
+    auto tree = ParseProgramFromString(R"(
+x = 1 + 2 * 3
+if x > 5:
+  print x, x - 1
+y = x
+)"s);
+    ast::FlatProgram flat(*tree);
+    const auto& nodes = flat.GetNodes();
+    using Kind = ast::FlatProgram::Kind;
+
+    ASSERT_EQUAL(flat.GetRoot(), nodes.size() - 1);
+    ASSERT(nodes.back().kind == Kind::Compound);
+    for (ast::FlatProgram::NodeIndex i = 0; i < nodes.size(); ++i) {
+        const auto& node = nodes[i];
+        switch (node.kind) {
+            case Kind::Assignment:
+                ASSERT(node.b < i);
+                break;
+            case Kind::Add:
+            case Kind::Sub:
+            case Kind::Mult:
+            case Kind::Greater:
+                ASSERT(node.a < node.b && node.b < i);
+                break;
+            case Kind::IfElse:
+                ASSERT(node.a < node.b && node.b < i);
+                ASSERT_EQUAL(node.c, ast::FlatProgram::NO_NODE);
+                break;
+            default:
+                break;
+        }
+    }
+    // 1 2 3 * + x= | x 5 > | x x 1 - print {} if | x y= | {}
+    const vector<Kind> expected = {
+        Kind::Const,    Kind::Const,    Kind::Const,      Kind::Mult,     Kind::Add,
+        Kind::Assignment, Kind::Variable, Kind::Const,    Kind::Greater,  Kind::Variable,
+        Kind::Variable, Kind::Const,    Kind::Sub,        Kind::Print,    Kind::Compound,
+        Kind::IfElse,   Kind::Variable, Kind::Assignment, Kind::Compound,
+    };
+    ASSERT_EQUAL(nodes.size(), expected.size());
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        ASSERT(nodes[i].kind == expected[i]);
+    }
+}
+
+void TestOptimizer() {
+    const string program = R"(
+class Sign:
+  def of(x):
+    if x < 0:
+      return -1
+    if 2 * 3 - 6 == 0:
+      return 1 + 0
+      print 'unreachable'
+    return 'unreachable'
+
+  def negate(x):
+    return -x
+
+s = Sign()
+print s.of(-5), s.of(7), s.negate(4), s.negate(-(2 + 3)), True or -'a' == 'a'
+if not True:
+  print 'never'
+else:
+  print 'always', "ab" + 'c', 7 / 2, 1 < 2 and 3 >= 3
+print 10 / (5 - 5)
+)"s;
+    const string expected = "-1 1 -4 5 True\nalways abc 3 True\n"s;
+
+    auto run = [](ast::Statement& tree, runtime::DummyContext& context) {
+        runtime::Closure closure;
+        try {
+            tree.Execute(closure, context);
+        } catch (const runtime_error&) {
+            context.GetOutputStream() << "error"s;
+        }
+    };
+
+    istringstream is(program);
+    parse::Lexer lexer(is);
+    auto tree = ParseProgram(lexer);
+    const ast::OptimizationStats stats = ast::Optimize(*tree);
+
+    // -'a' would fail at run time but is never evaluated, division by zero stays an error
+    runtime::DummyContext context;
+    run(*tree, context);
+    ASSERT_EQUAL(context.output.str(), expected + "error"s);
+
+    ast::FlatProgram flat(*tree);
+    runtime::DummyContext flat_context;
+    run(flat, flat_context);
+    ASSERT_EQUAL(flat_context.output.str(), expected + "error"s);
+
+    // 2*3, 2*3-6, ==0, 1+0, -1, -5, 2+3, -(2+3), True or .., not True, "ab"+'c', 7/2,
+    // 1<2, 3>=3, and, 5-5; -x and -'a' become Negate
+    ASSERT_EQUAL(stats.folded_constants, 16u);
+    ASSERT_EQUAL(stats.negations, 2u);
+    ASSERT_EQUAL(stats.resolved_conditions, 2u);
+    ASSERT_EQUAL(stats.dropped_statements, 2u);
+}
+
+// Constant conditions of any type are resolved with the IsTrue rules of the interpreter
+void TestConstantConditions() {
+    const string program = R"(
+if 0:
+  print 'zero'
+else:
+  print 'not zero'
+if 1:
+  print 'one'
+if 'x':
+  print 'string'
+if '':
+  print 'empty'
+if None:
+  print 'none'
+else:
+  print 'not none'
+if 3 - 3:
+  print 'folded'
+if not 0:
+  print 'not'
+)"s;
+    const string expected = "not zero\none\nstring\nnot none\nnot\n"s;
+    ASSERT_EQUAL(RunTreeAndFlat(program), expected);
+
+    auto tree = ParseProgramFromString(program);
+    auto& root = *dynamic_cast<ast::Program*>(tree.get());
+    const ast::OptimizationStats stats = ast::Optimize(root);
+    ASSERT_EQUAL(stats.resolved_conditions, 7u);
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    tree->Execute(closure, context);
+    ASSERT_EQUAL(context.output.str(), expected);
+
+    // No branch is left for the flat program
+    ast::FlatProgram flat(*tree);
+    for (const auto& node : flat.GetNodes()) {
+        ASSERT(node.kind != ast::FlatProgram::Kind::IfElse);
+    }
+}
+
+void TestDevirtualization() {
+    const string program = R"(
+class Base:
+  def step(x):
+    return x + 1
+
+  def name():
+    return 'base'
+
+  def run(x):
+    return self.name() + ' ' + str(self.step(x))
+
+  def wrong():
+    return self.step()
+
+class Derived(Base):
+  def name():
+    return 'derived'
+
+  def run2(x):
+    return self.run(self.step(x))
+
+class Shape:
+  def area():
+    return 0
+
+  def describe():
+    return self.area()
+
+class Other:
+  def step(x):
+    return x
+
+  def reset(other):
+    self = other
+    return self.step(1)
+
+  def call(b):
+    return b.step(1)
+
+  def declare():
+    class Square(Shape):
+      def area():
+        return 4
+    return None
+
+b = Base()
+d = Derived()
+o = Other()
+print b.run(1), d.run(1), d.run2(1), o.reset(b), o.call(d)
+shape = Shape()
+square = Square()
+print shape.describe(), square.describe()
+b.wrong()
+)"s;
+    const string expected = "base 2 derived 2 derived 3 2 2\n0 4\n"s;
+
+    auto run = [](ast::Statement& tree) {
+        runtime::DummyContext context;
+        runtime::Closure closure;
+        try {
+            tree.Execute(closure, context);
+        } catch (const runtime_error&) {
+            context.GetOutputStream() << "error"s;
+        }
+        return context.output.str();
+    };
+
+    // self.step in Base.run, self.run and self.step in Derived.run2. Derived overrides name and
+    // Square overrides area, self.step() has no argument, Other.reset assigns self, b is any object
+    istringstream input(program);
+    parse::Lexer lexer(input);
+    auto tree = ParseProgram(lexer);
+    ASSERT_EQUAL(tree->GetClasses().size(), 5u);
+    const ast::OptimizationStats stats = ast::Optimize(*tree);
+    ASSERT_EQUAL(stats.devirtualized_calls, 3u);
+    ASSERT_EQUAL(run(*tree), expected + "error"s);
+
+    ast::FlatProgram flat(*tree);
+    ASSERT_EQUAL(run(flat), expected + "error"s);
+
+    // Bound calls do not look the method up by name over the flat nodes and in the cache either:
+    // after the method of the running class is renamed only they find it
+    const string counter = R"(
+class Counter:
+  def step(x):
+    return x + 1
+
+  def twice(x):
+    return self.step(self.step(x))
+
+c = Counter()
+print c.twice(1)
+print c.step(1)
+)"s;
+    auto run_renamed = [&run](ast::Statement& program) {
+        runtime::DummyContext context;
+        runtime::Closure closure;
+        program.Execute(closure, context);
+        const auto& cls = closure.at("Counter"s).TryAs<runtime::ClassInstance>()->GetClass();
+        const_cast<runtime::Class&>(cls).GetMethods().front().name = "hidden"s;
+        return context.output.str() + run(program);
+    };
+    const string renamed_expected = "3\n2\n3\nerror"s;
+    auto counter_tree = ParseProgramFromString(counter);
+    auto& counter_program = *dynamic_cast<ast::Program*>(counter_tree.get());
+    ASSERT_EQUAL(ast::Optimize(counter_program).devirtualized_calls, 2u);
+    ast::FlatProgram counter_flat(*counter_tree);
+    ostringstream saved;
+    ast::SaveProgram(counter_flat, 0, saved);
+    auto loaded = ast::LoadProgram(saved.str(), 0);
+    ASSERT(loaded != nullptr);
+    ASSERT_EQUAL(run_renamed(*counter_tree), renamed_expected);
+    ASSERT_EQUAL(run_renamed(counter_flat), renamed_expected);
+    ASSERT_EQUAL(run_renamed(*loaded), renamed_expected);
+
+    // Bodies parsed on the first call are optimized then and are not counted
+    istringstream lazy_input(program);
+    parse::Lexer lazy_lexer(lazy_input);
+    ParseOptions options;
+    options.lazy_methods = true;
+    auto lazy_tree = ParseProgram(lazy_lexer, options);
+    ASSERT_EQUAL(ast::Optimize(*lazy_tree).devirtualized_calls, 0u);
+    ASSERT_EQUAL(run(*lazy_tree), expected + "error"s);
+    ASSERT_EQUAL(run(*lazy_tree), expected + "error"s);
+}
+
+void TestMethodFrameSlots() {
+    const string program = R"(
+class Walker:
+  def __init__(start):
+    self.position = start
+
+  def walk(steps, back):
+    before = self.position
+    position = before + steps
+    position = position - back
+    self.position = position
+    return position - before
+
+  def same(self):
+    return self.position
+
+  def depth(n):
+    level = n
+    if n > 0:
+      inner = self.depth(n - 1)
+      return level + inner
+    return level
+
+  def unset(flag):
+    if flag:
+      value = 'set'
+    return value
+
+  def shadow(steps):
+    steps = steps * 10
+    x = x
+    return steps
+
+w = Walker(5)
+print w.walk(3, 1), w.position, w.same(100), w.depth(4), w.unset(True)
+)"s;
+    ASSERT_EQUAL(RunTreeAndFlat(program), "2 7 7 10 set\n"s);
+
+    // Reading a variable before it is assigned fails both over the tree and the flat nodes
+    auto throws = [](ast::Statement& statement) {
+        runtime::DummyContext context;
+        runtime::Closure closure;
+        try {
+            statement.Execute(closure, context);
+        } catch (const runtime_error&) {
+            return true;
+        }
+        return false;
+    };
+    for (const string& call : {"w.unset(False)"s, "w.shadow(1)"s}) {
+        auto tree = ParseProgramFromString(program + "print "s + call + "\n"s);
+        ast::FlatProgram flat(*tree);
+        ASSERT(throws(*tree));
+        ASSERT(throws(flat));
+    }
+
+    // walk: steps, back, self, before, position
+    auto tree = ParseProgramFromString(program);
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    tree->Execute(closure, context);
+    const runtime::Class& cls = closure.at("Walker"s).TryAs<runtime::ClassInstance>()->GetClass();
+    ASSERT_EQUAL(cls.GetMethod("walk"s)->frame_size, 5U);
+    ASSERT_EQUAL(cls.GetMethod("same"s)->frame_size, 2U);
+}
+
+void TestProgramCache() {
+    const string program = R"(
+class Shape:
+  def __init__(name):
+    self.name = name
+
+  def describe():
+    return 'фигура ' + self.name + ' ' + str(self.area())
+
+class Rect(Shape):
+  def __init__(w, h):
+    self.name = 'rect'
+    self.w = w
+    self.h = h
+
+  def area():
+    area = self.w * self.h
+    return area
+
+r = Rect(-3, 4)
+print r.describe(), r.area() < 0, r.area() >= -12, r.w != r.h
+if r.area() == -12 and not r.w == r.h:
+  print "ok", None
+else:
+  print 'fail'
+)"s;
+    const uint64_t hash = ast::HashSource(program);
+    auto tree = ParseProgramFromString(program);
+    ast::Optimize(*dynamic_cast<ast::Program*>(tree.get()));
+    ostringstream saved;
+    ast::SaveProgram(ast::FlatProgram(*tree), hash, saved);
+    const string data = saved.str();
+
+    auto loaded = ast::LoadProgram(data, hash);
+    ASSERT(loaded != nullptr);
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    loaded->Execute(closure, context);
+    ASSERT_EQUAL(context.output.str(), RunTreeAndFlat(program));
+    ASSERT_EQUAL(context.output.str(), "фигура rect -12 True True True\nok None\n"s);
+
+    // A cache of another source or written by another build of the interpreter is stale,
+    // damaged data is detected
+    ASSERT(ast::LoadProgram(data, ast::HashSource(program + " "s)) == nullptr);
+    string other_build = data;
+    other_build[8] ^= 1;
+    ASSERT(ast::LoadProgram(other_build, hash) == nullptr);
+    auto corrupt = [](string_view data, uint64_t hash) {
+        try {
+            ast::LoadProgram(data, hash);
+        } catch (const invalid_argument&) {
+            return true;
+        }
+        return false;
+    };
+    string damaged = data;
+    damaged[data.size() / 2] ^= 1;
+    ASSERT(corrupt(damaged, hash));
+
+    // A frame slot outside the frame of the method or any slot outside methods is detected even
+    // with the right checksum. The first Variable node with the slot from gets the slot to
+    auto change_slot = [](string data, uint32_t from, uint32_t to) {
+        const size_t header_size = 32;
+        auto u32 = [&data](size_t pos) {
+            uint32_t value = 0;
+            for (int i = 0; i < 4; ++i) {
+                value |= uint32_t(static_cast<uint8_t>(data[pos + i])) << (8 * i);
+            }
+            return value;
+        };
+        size_t pos = header_size;
+        const uint32_t symbol_count = u32(pos);
+        pos += 4;
+        for (uint32_t i = 0; i < symbol_count; ++i) {
+            pos += 4 + u32(pos);
+        }
+        const uint32_t node_count = u32(pos);
+        pos += 4;
+        for (uint32_t i = 0; i < node_count; ++i, pos += 13) {
+            if (data[pos] == static_cast<char>(ast::FlatProgram::Kind::Variable)
+                && u32(pos + 9) == from) {
+                for (int j = 0; j < 4; ++j) {
+                    data[pos + 9 + j] = static_cast<char>(to >> (8 * j));
+                }
+                break;
+            }
+        }
+        const uint64_t checksum = ast::HashSource(string_view(data).substr(header_size));
+        for (int j = 0; j < 8; ++j) {
+            data[header_size - 8 + j] = static_cast<char>(checksum >> (8 * j));
+        }
+        return data;
+    };
+    ASSERT(ast::LoadProgram(change_slot(data, 0, 0), hash) != nullptr);
+    ASSERT(corrupt(change_slot(data, 0, 100), hash));
+    ASSERT(corrupt(change_slot(data, ast::NO_SLOT, 0), hash));
+    ASSERT(corrupt(string_view(data).substr(0, data.size() - 1), hash));
+    ASSERT(corrupt(""sv, hash));
+
+    ASSERT_EQUAL(ast::GetCachePath("scripts/run.my"s), "scripts/run.myc"s);
+    ASSERT_EQUAL(ast::GetCachePath("run"s), "run.myc"s);
+
+    // Cache files that can not be read are ignored
+    const string path = (filesystem::temp_directory_path() / "mython_cache_test.myc").string();
+    ASSERT(ast::LoadCachedProgram(path, hash) == nullptr);
+    ASSERT(ast::StoreCachedProgram(path, hash, *loaded));
+    ASSERT(ast::LoadCachedProgram(path, hash) != nullptr);
+    ASSERT(ast::LoadCachedProgram(path, hash + 1) == nullptr);
+    ofstream(path, ios::binary | ios::trunc) << damaged;
+    ASSERT(ast::LoadCachedProgram(path, hash) == nullptr);
+    filesystem::remove(path);
+}
+
+// return outside a method fails the program the same way over the tree, the flat nodes and
+// a program loaded from the cache, its expression is not evaluated
+void TestTopLevelReturn() {
+    const string program = R"(
+class Counter:
+  def next():
+    print 'evaluated'
+    return 1
+
+c = Counter()
+print 1
+if True:
+  return c.next()
+print 2
+)"s;
+    auto run = [](ast::Statement& statement) {
+        runtime::DummyContext context;
+        runtime::Closure closure;
+        try {
+            statement.Execute(closure, context);
+        } catch (const exception& e) {
+            context.GetOutputStream() << e.what();
+        }
+        return context.output.str();
+    };
+    const string expected = "1\nreturn"s;
+
+    auto tree = ParseProgramFromString(program);
+    ast::Optimize(*dynamic_cast<ast::Program*>(tree.get()));
+    ASSERT_EQUAL(run(*tree), expected);
+
+    ast::FlatProgram flat(*tree);
+    ASSERT_EQUAL(run(flat), expected);
+
+    const uint64_t hash = ast::HashSource(program);
+    ostringstream saved;
+    ast::SaveProgram(flat, hash, saved);
+    auto loaded = ast::LoadProgram(saved.str(), hash);
+    ASSERT(loaded != nullptr);
+    ASSERT_EQUAL(run(*loaded), expected);
+}
+
+void TestLazyMethods() {
+    const string program = R"(
+class Base:
+  def greet(name):
+    return 'hi, "' + name + '"' + self.suffix(2 + 3)
+
+  def suffix(n):
+    return '!' + str(n)
+
+  def broken():
+    x = = 1
+
+class Factory(Base):
+  def make():
+    class Made:
+      def value():
+        return 42
+    return Made()
+
+  def later():
+    return Later()
+
+class Later:
+  def value():
+    return 7
+
+f = Factory()
+made = f.make()
+other = Made()
+print f.greet('lazy'), made.value(), other.value()
+)"s;
+    istringstream eager_input(program);
+    parse::Lexer eager_lexer(eager_input);
+    ASSERT_THROWS(ParseProgram(eager_lexer), parse::LexerError);
+
+    istringstream input(program);
+    parse::Lexer lexer(input);
+    ParseOptions options;
+    options.lazy_methods = true;
+    auto tree = ParseProgram(lexer, options);
+    const ast::OptimizationStats stats = ast::Optimize(*tree);
+    ASSERT_EQUAL(stats.folded_constants, 0u);
+
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    tree->Execute(closure, context);
+    ASSERT_EQUAL(context.output.str(), "hi, \"lazy\"!5 42 42\n"s);
+
+    // Only the called methods are parsed, the one that declares a class is parsed in place
+    const runtime::Class& factory =
+        closure.at("Factory"s).TryAs<runtime::ClassInstance>()->GetClass();
+    const runtime::Class& base = *factory.GetParent();
+    auto parsed = [](const runtime::Class& cls, size_t index) {
+        return cls.GetMethods()[index].body != nullptr && !cls.GetMethods()[index].build;
+    };
+    ASSERT(parsed(base, 0) && parsed(base, 1) && !parsed(base, 2));
+    ASSERT(parsed(factory, 0) && !parsed(factory, 1));
+
+    // Errors are reported on every call. Classes declared after a method are not visible in it
+    runtime::ClassInstance instance(factory);
+    ASSERT_THROWS(instance.Call("broken"s, {}, context), parse::LexerError);
+    ASSERT_THROWS(instance.Call("broken"s, {}, context), parse::LexerError);
+    ASSERT_THROWS(instance.Call("later"s, {}, context), ParseError);
+
+    // The flat representation parses all of the methods
+    string valid = program;
+    for (const string& method : {"  def broken():\n    x = = 1\n\n"s,
+                                 "  def later():\n    return Later()\n\n"s}) {
+        valid.erase(valid.find(method), method.size());
+    }
+    istringstream valid_input(valid);
+    parse::Lexer valid_lexer(valid_input);
+    auto lazy_tree = ParseProgram(valid_lexer, options);
+    ast::FlatProgram flat(*lazy_tree);
+    runtime::DummyContext flat_context;
+    runtime::Closure flat_closure;
+    flat.Execute(flat_closure, flat_context);
+    ASSERT_EQUAL(flat_context.output.str(), context.output.str());
+    ASSERT_EQUAL(RunTreeAndFlat(valid), context.output.str());
+}
+
+void TestExpressionParser() {
+    const string program = R"(
+class Pair:
+  def __init__(a, b):
+    self.a = a
+    self.b = b
+
+  def sum(k):
+    return (self.a + self.b) * k
+
+p = Pair(2, 3)
+q = Pair((1), ((2)))
+print 1 + 2 * 3 - 8 / 4, -(1 + 2) * -3, 10 - 4 - 3, 64 / 4 / 2
+print not 1 < 2 or 3 == 3 and not 4 >= 5, not (True and False), 1 + 2 < 2 * 2
+print p.sum(p.a - 1) * 2, str(-p.b + (p.a)), q.sum((1)) == (3)
+)"s;
+    ASSERT_EQUAL(RunTreeAndFlat(program), "5 9 3 8\nTrue True True\n10 -1 True\n"s);
+
+    // A comparison is not associative, not is not an operand of arithmetic
+    ASSERT_THROWS(ParseProgramFromString("print 1 < 2 < 3\n"s), parse::LexerError);
+    ASSERT_THROWS(ParseProgramFromString("print 1 + not 2\n"s), parse::LexerError);
+    ASSERT_THROWS(ParseProgramFromString("print (1, 2)\n"s), parse::LexerError);
+    ASSERT_THROWS(ParseProgramFromString("print str(1, 2)\n"s), ParseError);
+
+    // Nesting is limited by memory rather than by the call stack of the parser
+    const size_t depth = 100000;
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    auto parenthesized =
+        ParseProgramFromString("x = "s + string(depth, '(') + "1"s + string(depth, ')') + "\n"s);
+    parenthesized->Execute(closure, context);
+    ASSERT_EQUAL(closure.at("x"s).TryAs<runtime::Number>()->GetValue(), 1);
+
+    string chain;
+    for (size_t i = 0; i < depth; ++i) {
+        chain += "1 - (";
+    }
+    auto tree = ParseProgramFromString("x = " + chain + "1" + string(depth, ')') + "\n"s);
+    ASSERT(tree != nullptr);
+}
+
+void TestParallelMethods() {
+    // Every class calls the one before it, some declare classes in their methods
+    ostringstream program;
+    program << "class C0:\n  def value():\n    return 0\n\n";
+    for (int i = 1; i < 50; ++i) {
+        program << "class C" << i << "(C" << i - 1 << "):\n"
+                << "  def value():\n    prev = C" << i - 1 << "()\n"
+                << "    return prev.value() + " << i << "\n\n";
+        if (i % 10 == 0) {
+            program << "  def inner():\n    class Inner" << i << ":\n      def get():\n"
+                    << "        return " << i << "\n    return Inner" << i << "()\n\n";
+        }
+    }
+    program << "c = C49()\nn = c.inner()\nprint c.value(), n.get()\n";
+
+    auto parse = [](const string& source, size_t threads) {
+        istringstream input(source);
+        parse::Lexer lexer(input);
+        ParseOptions options;
+        options.threads = threads;
+        return ParseProgram(lexer, options);
+    };
+    auto run = [](ast::Statement& tree) {
+        runtime::DummyContext context;
+        runtime::Closure closure;
+        tree.Execute(closure, context);
+        return context.output.str();
+    };
+    auto sequential = parse(program.str(), 1);
+    auto parallel = parse(program.str(), 4);
+    ASSERT_EQUAL(run(*sequential), "1225 40\n"s);
+    ASSERT_EQUAL(run(*parallel), run(*sequential));
+    ast::FlatProgram flat(*parallel);
+    ASSERT_EQUAL(run(flat), run(*sequential));
+    ASSERT_EQUAL(parallel->GetArena().GetStats().object_count,
+                 sequential->GetArena().GetStats().object_count);
+
+    // The first error of the program is reported, whichever thread parses it
+    auto error = [&parse](const string& source, size_t threads) {
+        try {
+            parse(source, threads);
+        } catch (const exception& e) {
+            return typeid(e).name() + ": "s + e.what();
+        }
+        return ""s;
+    };
+    const string first = "class A:\n  def m():\n    return 1 +\n\n";
+    const string second = "class B:\n  def m():\n    x = Later()\n\nclass Later:\n  def m():\n"
+                          "    return 2\n\n";
+    const string valid = "class G:\n  def m():\n    return 1\n\n";
+    const string no_base = "class C(D):\n  def m():\n    return 3\n";
+    for (const string& source : {first + second, second + first, second + "x = = 1\n"s,
+                                 valid + valid, valid + no_base, first + valid + no_base,
+                                 valid + second + valid}) {
+        const string expected = error(source, 1);
+        ASSERT(!expected.empty());
+        ASSERT_EQUAL(error(source, 4), expected);
+    }
+}
+
+// Conditions of if and operands of or, and, not are converted to bool as runtime::IsTrue does,
+// the right operand is evaluated only when the left one does not decide the result
+void TestConditions() {
+    const string program = R"(
+class Probe:
+  def __init__():
+    self.calls = 0
+
+  def check(value):
+    self.calls = self.calls + 1
+    return value
+
+p = Probe()
+if 1:
+  print 'number'
+if '':
+  print 'unreachable'
+else:
+  print 'empty string'
+if not None and 'abc':
+  print 'string'
+if p:
+  print 'unreachable'
+print 0 or 'x', 2 and 0, not 0, not 'a'
+if p.check(0) or p.check(3) and not p.check(''):
+  print 'mixed'
+print p.calls
+if p.check(True) or p.check(True):
+  print p.calls
+if p.check(False) and p.check(True):
+  print 'unreachable'
+print p.calls
+x = 5
+if x > 3 and x != 4 or p.check(True):
+  print p.calls
+)"s;
+    const string expected =
+        "number\nempty string\nstring\nTrue False True False\nmixed\n3\n4\n5\n5\n"s;
+    ASSERT_EQUAL(RunTreeAndFlat(program), expected);
+
+    auto tree = ParseProgramFromString(program);
+    ast::Optimize(*dynamic_cast<ast::Program*>(tree.get()));
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    tree->Execute(closure, context);
+    ASSERT_EQUAL(context.output.str(), expected);
+}
+
+// Numbers are 64-bit, the results that overflow them become long numbers and return to 64-bit
+// ones when they fit again
+void TestBigNumbers() {
+    const string program = R"(
+class Account:
+  def __init__(balance):
+    self.balance = balance
+
+  def deposit(amount):
+    self.balance = self.balance + amount
+
+class Math:
+  def factorial(n):
+    if n < 2:
+      return 1
+    return n * self.factorial(n - 1)
+
+a = Account(9223372036854775807)
+a.deposit(1)
+print a.balance, a.balance - 1, a.balance > 9223372036854775807, a.balance == 9223372036854775807
+x = 3037000500 * 3037000500
+print x, x / 3037000500, x - x + 7, str(x) + '!'
+m = Math()
+f = m.factorial(30)
+print f, f / m.factorial(28), -m.factorial(25), f < -f
+print (0 - 9223372036854775807 - 1) / -1
+if x and not x - x:
+  print 'truth'
+)"s;
+    const string expected =
+        "9223372036854775808 9223372036854775807 True False\n"
+        "9223372037000250000 3037000500 7 9223372037000250000!\n"
+        "265252859812191058636308480000000 870 -15511210043330985984000000 False\n"
+        "9223372036854775808\ntruth\n"s;
+    ASSERT_EQUAL(RunTreeAndFlat(program), expected);
+
+    auto tree = ParseProgramFromString(program);
+    ast::Optimize(*dynamic_cast<ast::Program*>(tree.get()));
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    tree->Execute(closure, context);
+    ASSERT_EQUAL(context.output.str(), expected);
+}
+
 }  // namespace parse
 
 void TestParseProgram(TestRunner& tr) {
@@ -256,4 +1135,18 @@ void TestParseProgram(TestRunner& tr) {
     RUN_TEST(tr, parse::TestRecursion2);
     RUN_TEST(tr, parse::TestComplexLogicalExpression);
     RUN_TEST(tr, parse::TestClassicalPolymorphism);
+    RUN_TEST(tr, parse::TestProgramArena);
+    RUN_TEST(tr, parse::TestFlatProgram);
+    RUN_TEST(tr, parse::TestFlatProgramLayout);
+    RUN_TEST(tr, parse::TestOptimizer);
+    RUN_TEST(tr, parse::TestConstantConditions);
+    RUN_TEST(tr, parse::TestDevirtualization);
+    RUN_TEST(tr, parse::TestMethodFrameSlots);
+    RUN_TEST(tr, parse::TestProgramCache);
+    RUN_TEST(tr, parse::TestTopLevelReturn);
+    RUN_TEST(tr, parse::TestLazyMethods);
+    RUN_TEST(tr, parse::TestExpressionParser);
+    RUN_TEST(tr, parse::TestParallelMethods);
+    RUN_TEST(tr, parse::TestConditions);
+    RUN_TEST(tr, parse::TestBigNumbers);
 }
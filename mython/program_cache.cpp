@@ -0,0 +1,770 @@
+#include "program_cache.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+
+using namespace std;
+
+namespace ast {
+
+using runtime::ObjectHolder;
+using NodeIndex = FlatProgram::NodeIndex;
+using Kind = FlatProgram::Kind;
+
+namespace {
+// Версию формата нужно увеличивать при любом изменении записи или набора узлов FlatProgram,
+// а также значений, которые вычисляет оптимизатор: тогда файлы, записанные прежней версией,
+// считаются устаревшими. Версия 3: числа 64-битные, свёртка констант не переполняет int.
+// Версия 4: в заголовке записан идентификатор сборки интерпретатора.
+// Версия 5: узлы BoundMethodCall и таблица связанных методов
+const uint32_t SIGNATURE = 0x0043594D;  // "MYC\0"
+const uint32_t FORMAT_VERSION = 5;
+// Сигнатура, версия, идентификатор сборки, хеш исходного текста и контрольная сумма данных
+const size_t HEADER_SIZE = 4 + 4 + 8 + 8 + 8;
+
+enum class ConstantTag : uint8_t {
+	Number, String, Bool
+};
+
+// FNV-1a
+uint64_t Hash(string_view data) {
+	uint64_t hash = 14695981039346656037ULL;
+	for (const char c : data) {
+		hash ^= static_cast<unsigned char>(c);
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+// Идентификатор сборки интерпретатора. Другая сборка может иначе сворачивать константы или
+// выполнять узлы, поэтому её кэш считается устаревшим, даже если забыли увеличить версию формата.
+// Сборку определяют размер и время изменения исполняемого файла, а если его не найти (путь
+// /proc/self/exe есть только в Linux) - время компиляции этого файла
+uint64_t GetBuildId() {
+	static const uint64_t build_id = [] {
+		string identity = __VERSION__ " "s;
+		error_code error;
+		const filesystem::path executable = filesystem::read_symlink("/proc/self/exe", error);
+		const uintmax_t size = error ? 0 : filesystem::file_size(executable, error);
+		const auto modified = error ? filesystem::file_time_type() :
+				filesystem::last_write_time(executable, error);
+		if (error) {
+			identity += __DATE__ " " __TIME__;
+		} else {
+			identity += executable.string() + " "s + to_string(size) + " "s
+					+ to_string(modified.time_since_epoch().count());
+		}
+		return Hash(identity);
+	}();
+	return build_id;
+}
+
+[[noreturn]] void ThrowCorrupt() {
+	throw invalid_argument("The program cache is corrupt"s);
+}
+
+// Поле узла, в котором записан номер символа, либо nullptr. В файле вместо номеров символов
+// процесса записываются номера в таблице имён файла
+template <typename Node>
+auto SymbolField(Node &node) -> decltype(&node.a) {
+	switch (node.kind) {
+	case Kind::Assignment:
+		return &node.a;
+	case Kind::FieldAssignment:
+		return &node.b;
+	case Kind::MethodCall:
+		return &node.c;
+	default:
+		return nullptr;
+	}
+}
+
+// Числа записываются в порядке little-endian независимо от платформы
+class Output {
+public:
+	void PutByte(uint8_t value) {
+		data_.push_back(static_cast<char>(value));
+	}
+
+	void PutU32(uint32_t value) {
+		for (int i = 0; i < 4; ++i) {
+			PutByte(static_cast<uint8_t>(value >> (8 * i)));
+		}
+	}
+
+	void PutU64(uint64_t value) {
+		for (int i = 0; i < 8; ++i) {
+			PutByte(static_cast<uint8_t>(value >> (8 * i)));
+		}
+	}
+
+	void PutString(string_view value) {
+		PutU32(static_cast<uint32_t>(value.size()));
+		data_.append(value);
+	}
+
+	[[nodiscard]] const string& Data() const {
+		return data_;
+	}
+
+private:
+	string data_;
+};
+
+// Чтение за концом данных выбрасывает std::invalid_argument
+class Input {
+public:
+	explicit Input(string_view data) :
+			data_(data) {
+	}
+
+	uint8_t GetByte() {
+		return static_cast<uint8_t>(Take(1)[0]);
+	}
+
+	uint32_t GetU32() {
+		const string_view bytes = Take(4);
+		uint32_t value = 0;
+		for (int i = 0; i < 4; ++i) {
+			value |= uint32_t(static_cast<uint8_t>(bytes[i])) << (8 * i);
+		}
+		return value;
+	}
+
+	uint64_t GetU64() {
+		const string_view bytes = Take(8);
+		uint64_t value = 0;
+		for (int i = 0; i < 8; ++i) {
+			value |= uint64_t(static_cast<uint8_t>(bytes[i])) << (8 * i);
+		}
+		return value;
+	}
+
+	string_view GetString() {
+		return Take(GetU32());
+	}
+
+	// Читает количество элементов списка. Каждый элемент занимает не меньше element_size байт,
+	// поэтому испорченное количество обнаруживается до выделения памяти под список
+	uint32_t GetCount(size_t element_size) {
+		const uint32_t count = GetU32();
+		if (count > (data_.size() - position_) / element_size) {
+			ThrowCorrupt();
+		}
+		return count;
+	}
+
+	[[nodiscard]] bool AtEnd() const {
+		return position_ == data_.size();
+	}
+
+private:
+	string_view data_;
+	size_t position_ = 0;
+
+	string_view Take(size_t size) {
+		if (size > data_.size() - position_) {
+			ThrowCorrupt();
+		}
+		const string_view result = data_.substr(position_, size);
+		position_ += size;
+		return result;
+	}
+};
+}  // namespace
+
+class ProgramWriter {
+public:
+	explicit ProgramWriter(const FlatProgram &program) :
+			program_(program) {
+	}
+
+	// Таблица имён становится известна только после записи остальных данных, а читается первой
+	string Write() {
+		WriteNodes();
+		WriteNames();
+		WriteConstants();
+		WriteClasses();
+		WriteBoundMethods();
+		WriteInstances();
+		body_.PutU32(program_.root_);
+
+		Output result;
+		result.PutU32(static_cast<uint32_t>(symbols_.size()));
+		for (const runtime::Symbol symbol : symbols_) {
+			result.PutString(symbol.Name());
+		}
+		return result.Data() + body_.Data();
+	}
+
+private:
+	const FlatProgram &program_;
+	Output body_;
+	vector<runtime::Symbol> symbols_;
+	unordered_map<runtime::Symbol, uint32_t> symbol_indices_;
+
+	uint32_t SymbolIndex(runtime::Symbol symbol) {
+		const auto [it, inserted] = symbol_indices_.emplace(symbol,
+				static_cast<uint32_t>(symbols_.size()));
+		if (inserted) {
+			symbols_.push_back(symbol);
+		}
+		return it->second;
+	}
+
+	void WriteNodes() {
+		body_.PutU32(static_cast<uint32_t>(program_.nodes_.size()));
+		for (FlatProgram::Node node : program_.nodes_) {
+			if (uint32_t *symbol = SymbolField(node)) {
+				*symbol = SymbolIndex(runtime::Symbol::FromId(*symbol));
+			}
+			body_.PutByte(static_cast<uint8_t>(node.kind));
+			body_.PutU32(node.a);
+			body_.PutU32(node.b);
+			body_.PutU32(node.c);
+		}
+		body_.PutU32(static_cast<uint32_t>(program_.children_.size()));
+		for (const NodeIndex child : program_.children_) {
+			body_.PutU32(child);
+		}
+	}
+
+	void WriteNames() {
+		body_.PutU32(static_cast<uint32_t>(program_.names_.size()));
+		for (const runtime::Symbol name : program_.names_) {
+			body_.PutU32(SymbolIndex(name));
+		}
+	}
+
+	void WriteConstants() {
+		body_.PutU32(static_cast<uint32_t>(program_.constants_.size()));
+		for (const ObjectHolder &constant : program_.constants_) {
+			if (const auto *number = constant.TryAs<runtime::Number>()) {
+				body_.PutByte(static_cast<uint8_t>(ConstantTag::Number));
+				body_.PutU64(static_cast<uint64_t>(number->GetValue()));
+			} else if (const auto *str = constant.TryAs<runtime::String>()) {
+				body_.PutByte(static_cast<uint8_t>(ConstantTag::String));
+				body_.PutString(str->GetValue());
+			} else if (const auto *boolean = constant.TryAs<runtime::Bool>()) {
+				body_.PutByte(static_cast<uint8_t>(ConstantTag::Bool));
+				body_.PutByte(boolean->GetValue() ? 1 : 0);
+			} else {
+				throw invalid_argument("A constant of the program can not be saved"s);
+			}
+		}
+	}
+
+	void WriteClasses() {
+		body_.PutU32(static_cast<uint32_t>(program_.classes_.size()));
+		for (const ObjectHolder &holder : program_.classes_) {
+			const auto &cls = *holder.TryAs<runtime::Class>();
+			body_.PutString(cls.GetName());
+			body_.PutU32(cls.GetParent() != nullptr ?
+					ClassIndex(*cls.GetParent()) : FlatProgram::NO_NODE);
+			body_.PutU32(static_cast<uint32_t>(cls.GetMethods().size()));
+			for (const runtime::Method &method : cls.GetMethods()) {
+				const auto *body = dynamic_cast<const FlatMethodBody*>(method.body.get());
+				if (body == nullptr) {
+					throw invalid_argument("A method of the program can not be saved"s);
+				}
+				body_.PutU32(SymbolIndex(method.name));
+				body_.PutU32(static_cast<uint32_t>(method.formal_params.size()));
+				for (const runtime::Symbol param : method.formal_params) {
+					body_.PutU32(SymbolIndex(param));
+				}
+				body_.PutU32(body->GetBody());
+				body_.PutU32(static_cast<uint32_t>(method.frame_size));
+			}
+		}
+	}
+
+	// Метод записывается номером класса и номером метода в классе
+	void WriteBoundMethods() {
+		body_.PutU32(static_cast<uint32_t>(program_.bound_methods_.size()));
+		for (const runtime::Method *method : program_.bound_methods_) {
+			const auto [class_index, method_index] = MethodIndex(*method);
+			body_.PutU32(class_index);
+			body_.PutU32(method_index);
+		}
+	}
+
+	void WriteInstances() {
+		body_.PutU32(static_cast<uint32_t>(program_.instances_.size()));
+		for (const runtime::ClassInstance &instance : program_.instances_) {
+			body_.PutU32(ClassIndex(instance.GetClass()));
+		}
+	}
+
+	// Родители и классы объектов - всегда классы этой же программы
+	uint32_t ClassIndex(const runtime::Class &cls) const {
+		for (size_t i = 0; i < program_.classes_.size(); ++i) {
+			if (program_.classes_[i].TryAs<runtime::Class>() == &cls) {
+				return static_cast<uint32_t>(i);
+			}
+		}
+		throw invalid_argument("A class of the program can not be saved"s);
+	}
+
+	pair<uint32_t, uint32_t> MethodIndex(const runtime::Method &method) const {
+		for (size_t i = 0; i < program_.classes_.size(); ++i) {
+			const auto &methods = program_.classes_[i].TryAs<runtime::Class>()->GetMethods();
+			for (size_t j = 0; j < methods.size(); ++j) {
+				if (&methods[j] == &method) {
+					return {static_cast<uint32_t>(i), static_cast<uint32_t>(j)};
+				}
+			}
+		}
+		throw invalid_argument("A bound method of the program can not be saved"s);
+	}
+};
+
+class ProgramReader {
+public:
+	explicit ProgramReader(string_view data) :
+			input_(data), program_(new FlatProgram()) {
+	}
+
+	unique_ptr<FlatProgram> Read() {
+		ReadSymbols();
+		ReadNodes();
+		ReadNames();
+		ReadConstants();
+		ReadClasses();
+		ReadBoundMethods();
+		ReadInstances();
+		program_->root_ = input_.GetU32();
+		if (!input_.AtEnd() || program_->root_ >= program_->nodes_.size()) {
+			ThrowCorrupt();
+		}
+		Validate();
+		CheckSlots();
+		return move(program_);
+	}
+
+private:
+	Input input_;
+	unique_ptr<FlatProgram> program_;
+	vector<runtime::Symbol> symbols_;
+
+	runtime::Symbol GetSymbol() {
+		const uint32_t index = input_.GetU32();
+		if (index >= symbols_.size()) {
+			ThrowCorrupt();
+		}
+		return symbols_[index];
+	}
+
+	void ReadSymbols() {
+		symbols_.resize(input_.GetCount(4));
+		for (runtime::Symbol &symbol : symbols_) {
+			symbol = input_.GetString();
+		}
+	}
+
+	void ReadNodes() {
+		program_->nodes_.resize(input_.GetCount(13));
+		for (FlatProgram::Node &node : program_->nodes_) {
+			const uint8_t kind = input_.GetByte();
+			if (kind > static_cast<uint8_t>(Kind::IfElse)) {
+				ThrowCorrupt();
+			}
+			node.kind = static_cast<Kind>(kind);
+			node.a = input_.GetU32();
+			node.b = input_.GetU32();
+			node.c = input_.GetU32();
+			if (uint32_t *symbol = SymbolField(node)) {
+				if (*symbol >= symbols_.size()) {
+					ThrowCorrupt();
+				}
+				*symbol = symbols_[*symbol].Id();
+			}
+		}
+		program_->children_.resize(input_.GetCount(4));
+		for (NodeIndex &child : program_->children_) {
+			child = input_.GetU32();
+		}
+	}
+
+	void ReadNames() {
+		program_->names_.resize(input_.GetCount(4));
+		for (runtime::Symbol &name : program_->names_) {
+			name = GetSymbol();
+		}
+	}
+
+	void ReadConstants() {
+		const uint32_t count = input_.GetCount(2);
+		program_->constants_.reserve(count);
+		for (uint32_t i = 0; i < count; ++i) {
+			switch (static_cast<ConstantTag>(input_.GetByte())) {
+			case ConstantTag::Number:
+				program_->constants_.push_back(ObjectHolder::Own(runtime::Number(
+						static_cast<int64_t>(input_.GetU64()))));
+				break;
+			case ConstantTag::String:
+				program_->constants_.push_back(
+						ObjectHolder::Own(runtime::String(string(input_.GetString()))));
+				break;
+			case ConstantTag::Bool:
+				program_->constants_.push_back(
+						ObjectHolder::Own(runtime::Bool(input_.GetByte() != 0)));
+				break;
+			default:
+				ThrowCorrupt();
+			}
+		}
+	}
+
+	// Родитель записан раньше наследника, как его строит Flattener
+	void ReadClasses() {
+		const uint32_t count = input_.GetCount(12);
+		for (uint32_t i = 0; i < count; ++i) {
+			string name(input_.GetString());
+			const uint32_t parent_index = input_.GetU32();
+			const runtime::Class *parent = nullptr;
+			if (parent_index != FlatProgram::NO_NODE) {
+				if (parent_index >= program_->classes_.size()) {
+					ThrowCorrupt();
+				}
+				parent = program_->classes_[parent_index].TryAs<runtime::Class>();
+			}
+			vector<runtime::Method> methods(input_.GetCount(16));
+			for (runtime::Method &method : methods) {
+				method.name = GetSymbol();
+				method.formal_params.resize(input_.GetCount(4));
+				for (runtime::Symbol &param : method.formal_params) {
+					param = GetSymbol();
+				}
+				const NodeIndex body = input_.GetU32();
+				method.frame_size = input_.GetU32();
+				// В кадре за параметрами лежит self
+				if (body >= program_->nodes_.size()
+						|| (method.frame_size != 0
+								&& method.frame_size <= method.formal_params.size())) {
+					ThrowCorrupt();
+				}
+				method.body = make_unique<FlatMethodBody>(*program_, body);
+			}
+			program_->classes_.push_back(
+					ObjectHolder::Own(runtime::Class(move(name), move(methods), parent)));
+		}
+	}
+
+	void ReadBoundMethods() {
+		const uint32_t count = input_.GetCount(8);
+		program_->bound_methods_.reserve(count);
+		for (uint32_t i = 0; i < count; ++i) {
+			const uint32_t class_index = input_.GetU32();
+			const uint32_t method_index = input_.GetU32();
+			CheckIndex(class_index, program_->classes_.size());
+			const auto &methods =
+					program_->classes_[class_index].TryAs<runtime::Class>()->GetMethods();
+			CheckIndex(method_index, methods.size());
+			program_->bound_methods_.push_back(&methods[method_index]);
+		}
+	}
+
+	void ReadInstances() {
+		const uint32_t count = input_.GetCount(4);
+		for (uint32_t i = 0; i < count; ++i) {
+			const uint32_t index = input_.GetU32();
+			if (index >= program_->classes_.size()) {
+				ThrowCorrupt();
+			}
+			program_->instances_.emplace_back(*program_->classes_[index].TryAs<runtime::Class>());
+		}
+	}
+
+	// Потомки узла записаны раньше него, поэтому испорченные данные не могут зациклить выполнение
+	void CheckChild(NodeIndex child, NodeIndex parent) const {
+		if (child >= parent) {
+			ThrowCorrupt();
+		}
+	}
+
+	void CheckOptionalChild(NodeIndex child, NodeIndex parent) const {
+		if (child != FlatProgram::NO_NODE) {
+			CheckChild(child, parent);
+		}
+	}
+
+	void CheckList(uint32_t first, uint64_t count, NodeIndex parent) const {
+		if (first + count > program_->children_.size()) {
+			ThrowCorrupt();
+		}
+		for (uint64_t i = first; i < first + count; ++i) {
+			CheckChild(program_->children_[i], parent);
+		}
+	}
+
+	static void CheckIndex(uint32_t index, size_t size) {
+		if (index >= size) {
+			ThrowCorrupt();
+		}
+	}
+
+	void Validate() const {
+		const auto &nodes = program_->nodes_;
+		for (NodeIndex index = 0; index < nodes.size(); ++index) {
+			const FlatProgram::Node &node = nodes[index];
+			switch (node.kind) {
+			case Kind::Const:
+				CheckIndex(node.a, program_->constants_.size());
+				break;
+			case Kind::None:
+				break;
+			case Kind::Variable:
+				if (uint64_t(node.a) + node.b > program_->names_.size()) {
+					ThrowCorrupt();
+				}
+				break;
+			case Kind::Assignment:
+				CheckChild(node.b, index);
+				break;
+			case Kind::FieldAssignment:
+				CheckChild(node.a, index);
+				CheckChild(node.c, index);
+				if (nodes[node.a].kind != Kind::Variable) {
+					ThrowCorrupt();
+				}
+				break;
+			case Kind::Print:
+			case Kind::Compound:
+				CheckList(node.a, node.b, index);
+				break;
+			case Kind::MethodCall:
+				CheckList(node.a, uint64_t(node.b) + 1, index);
+				break;
+			case Kind::BoundMethodCall:
+				// Связанный метод вызывается без проверки числа аргументов
+				CheckList(node.a, uint64_t(node.b) + 1, index);
+				CheckIndex(node.c, program_->bound_methods_.size());
+				if (program_->bound_methods_[node.c]->formal_params.size() != node.b) {
+					ThrowCorrupt();
+				}
+				break;
+			case Kind::NewInstance:
+				CheckIndex(node.a, program_->instances_.size());
+				CheckList(node.b, node.c, index);
+				break;
+			case Kind::Stringify:
+			case Kind::Not:
+			case Kind::Negate:
+			case Kind::MethodBody:
+			case Kind::Return:
+				CheckChild(node.a, index);
+				break;
+			case Kind::Add:
+			case Kind::Sub:
+			case Kind::Mult:
+			case Kind::Div:
+			case Kind::Or:
+			case Kind::And:
+			case Kind::Equal:
+			case Kind::NotEqual:
+			case Kind::Less:
+			case Kind::Greater:
+			case Kind::LessOrEqual:
+			case Kind::GreaterOrEqual:
+				CheckChild(node.a, index);
+				CheckChild(node.b, index);
+				break;
+			case Kind::ClassDefinition:
+				CheckIndex(node.a, program_->classes_.size());
+				break;
+			case Kind::IfElse:
+				CheckChild(node.a, index);
+				CheckOptionalChild(node.b, index);
+				CheckOptionalChild(node.c, index);
+				break;
+			}
+		}
+	}
+
+	// Вызывает f для каждого потомка узла. Узел уже проверен Validate
+	template <typename F>
+	void ForEachChild(const FlatProgram::Node &node, F f) const {
+		const auto for_list = [this, &f](uint32_t first, uint64_t count) {
+			for (uint64_t i = first; i < first + count; ++i) {
+				f(program_->children_[i]);
+			}
+		};
+		switch (node.kind) {
+		case Kind::Const:
+		case Kind::None:
+		case Kind::Variable:
+		case Kind::ClassDefinition:
+			break;
+		case Kind::Assignment:
+			f(node.b);
+			break;
+		case Kind::FieldAssignment:
+			f(node.a);
+			f(node.c);
+			break;
+		case Kind::Print:
+		case Kind::Compound:
+			for_list(node.a, node.b);
+			break;
+		case Kind::MethodCall:
+		case Kind::BoundMethodCall:
+			for_list(node.a, uint64_t(node.b) + 1);
+			break;
+		case Kind::NewInstance:
+			for_list(node.b, node.c);
+			break;
+		case Kind::Stringify:
+		case Kind::Not:
+		case Kind::Negate:
+		case Kind::MethodBody:
+		case Kind::Return:
+			f(node.a);
+			break;
+		case Kind::Add:
+		case Kind::Sub:
+		case Kind::Mult:
+		case Kind::Div:
+		case Kind::Or:
+		case Kind::And:
+		case Kind::Equal:
+		case Kind::NotEqual:
+		case Kind::Less:
+		case Kind::Greater:
+		case Kind::LessOrEqual:
+		case Kind::GreaterOrEqual:
+			f(node.a);
+			f(node.b);
+			break;
+		case Kind::IfElse:
+			f(node.a);
+			if (node.b != FlatProgram::NO_NODE) {
+				f(node.b);
+			}
+			if (node.c != FlatProgram::NO_NODE) {
+				f(node.c);
+			}
+			break;
+		}
+	}
+
+	// ExecuteVariable и Assignment обращаются к слоту кадра без проверки. Узлы, достижимые из
+	// тела метода, должны ссылаться на слоты меньше frame_size метода, а достижимые из корня
+	// программы - не ссылаться на слоты вовсе. Для узла запоминается наименьший размер кадра,
+	// с которым он проверен, поэтому общие для нескольких родителей узлы не проверяются заново
+	void CheckSlots() const {
+		vector<uint64_t> checked(program_->nodes_.size(), UINT64_MAX);
+		CheckSlots(program_->root_, 0, checked);
+		for (const ObjectHolder &holder : program_->classes_) {
+			for (const runtime::Method &method : holder.TryAs<runtime::Class>()->GetMethods()) {
+				CheckSlots(static_cast<const FlatMethodBody&>(*method.body).GetBody(),
+						method.frame_size, checked);
+			}
+		}
+	}
+
+	void CheckSlots(NodeIndex root, uint64_t frame_size, vector<uint64_t> &checked) const {
+		vector<NodeIndex> stack { root };
+		while (!stack.empty()) {
+			const NodeIndex index = stack.back();
+			stack.pop_back();
+			if (checked[index] <= frame_size) {
+				continue;
+			}
+			checked[index] = frame_size;
+			const FlatProgram::Node &node = program_->nodes_[index];
+			if ((node.kind == Kind::Variable || node.kind == Kind::Assignment)
+					&& node.c != NO_SLOT && node.c >= frame_size) {
+				ThrowCorrupt();
+			}
+			ForEachChild(node, [&stack](NodeIndex child) {
+				stack.push_back(child);
+			});
+		}
+	}
+};
+
+uint64_t HashSource(string_view source) {
+	return Hash(source);
+}
+
+void SaveProgram(const FlatProgram &program, uint64_t source_hash, ostream &output) {
+	const string data = ProgramWriter(program).Write();
+	Output header;
+	header.PutU32(SIGNATURE);
+	header.PutU32(FORMAT_VERSION);
+	header.PutU64(GetBuildId());
+	header.PutU64(source_hash);
+	header.PutU64(Hash(data));
+	output.write(header.Data().data(), static_cast<streamsize>(header.Data().size()));
+	output.write(data.data(), static_cast<streamsize>(data.size()));
+}
+
+unique_ptr<FlatProgram> LoadProgram(string_view data, uint64_t source_hash) {
+	Input header(data.substr(0, HEADER_SIZE));
+	if (header.GetU32() != SIGNATURE) {
+		ThrowCorrupt();
+	}
+	if (header.GetU32() != FORMAT_VERSION || header.GetU64() != GetBuildId()
+			|| header.GetU64() != source_hash) {
+		return nullptr;
+	}
+	data.remove_prefix(HEADER_SIZE);
+	if (header.GetU64() != Hash(data)) {
+		ThrowCorrupt();
+	}
+	return ProgramReader(data).Read();
+}
+
+string GetCachePath(const string &script_path) {
+	const string_view extension = ".my"sv;
+	if (script_path.size() >= extension.size()
+			&& script_path.compare(script_path.size() - extension.size(), extension.size(),
+					extension) == 0) {
+		return script_path + "c"s;
+	}
+	return script_path + ".myc"s;
+}
+
+unique_ptr<FlatProgram> LoadCachedProgram(const string &cache_path, uint64_t source_hash) {
+	ifstream input(cache_path, ios::binary);
+	if (!input) {
+		return nullptr;
+	}
+	const string data { istreambuf_iterator<char>(input), istreambuf_iterator<char>() };
+	try {
+		return LoadProgram(data, source_hash);
+	} catch (const invalid_argument&) {
+		return nullptr;
+	}
+}
+
+bool StoreCachedProgram(const string &cache_path, uint64_t source_hash,
+		const FlatProgram &program) {
+	const string temp_path = cache_path + ".tmp"s + to_string(random_device { }());
+	try {
+		ofstream output(temp_path, ios::binary | ios::trunc);
+		if (!output) {
+			return false;
+		}
+		SaveProgram(program, source_hash, output);
+		output.close();
+		if (output) {
+			filesystem::rename(temp_path, cache_path);
+			return true;
+		}
+	} catch (const exception&) {
+		// Кэш необязателен: программа выполняется и без него
+	}
+	error_code ignored;
+	filesystem::remove(temp_path, ignored);
+	return false;
+}
+
+}  // namespace ast
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "flat_ast.h"
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+namespace ast {
+
+/*
+Кэш разобранных программ. Плоское представление программы (FlatProgram) записывается в компактный
+двоичный формат: таблица имён, узлы, списки потомков, константы, классы с методами, методы,
+с которыми связаны вызовы, и объекты NewInstance. Загрузка кэша заменяет лексический и синтаксический разбор и оптимизацию.
+
+Запись начинается с заголовка: сигнатура, версия формата, идентификатор сборки интерпретатора,
+хеш исходного текста программы и контрольная сумма остальных данных. Кэш другого текста или
+записанный другой сборкой интерпретатора считается устаревшим, а данные, которые не совпадают
+с контрольной суммой или ссылаются на несуществующие узлы или слоты кадра, - повреждёнными
+*/
+
+// Возвращает хеш исходного текста программы, по которому проверяется актуальность кэша
+uint64_t HashSource(std::string_view source);
+
+// Записывает программу, построенную по тексту с хешем source_hash. Если программа содержит
+// объект, который нельзя записать, выбрасывает std::invalid_argument
+void SaveProgram(const FlatProgram& program, uint64_t source_hash, std::ostream& output);
+
+// Загружает программу, записанную SaveProgram. Возвращает nullptr, если программа построена по
+// другому тексту или записана другой сборкой интерпретатора. Если данные повреждены, выбрасывает
+// std::invalid_argument
+std::unique_ptr<FlatProgram> LoadProgram(std::string_view data, uint64_t source_hash);
+
+// Возвращает путь файла кэша, который лежит рядом со скриптом: script.my -> script.myc
+std::string GetCachePath(const std::string& script_path);
+
+// Загружает программу из файла кэша. Возвращает nullptr, если файла нет либо он устарел
+// или повреждён
+std::unique_ptr<FlatProgram> LoadCachedProgram(const std::string& cache_path,
+                                               uint64_t source_hash);
+
+// Записывает файл кэша. Файл сначала пишется под временным именем и затем переименовывается,
+// поэтому параллельно запущенные программы не прочитают его недописанным. Возвращает false,
+// если записать кэш не удалось
+bool StoreCachedProgram(const std::string& cache_path, uint64_t source_hash,
+                        const FlatProgram& program);
+
+}  // namespace ast
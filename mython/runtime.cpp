@@ -2,6 +2,7 @@
 
 #include <algorithm>
 #include <cassert>
+#include <exception>
 #include <optional>
 #include <sstream>
 
@@ -9,17 +10,15 @@ using namespace std;
 
 namespace runtime {
 
-ObjectHolder::ObjectHolder(std::shared_ptr<Object> data)
-    : data_(std::move(data)) {
-}
+namespace {
+const Symbol STR_METHOD = "__str__"sv;
+const Symbol EQ_METHOD = "__eq__"sv;
+const Symbol LT_METHOD = "__lt__"sv;
+const Symbol SELF = "self"sv;
+}  // namespace
 
 void ObjectHolder::AssertIsValid() const {
-    assert(data_ != nullptr);
-}
-
-ObjectHolder ObjectHolder::Share(Object& object) {
-	// Return a non-owning shared_ptr (its deleter does nothing)
-    return ObjectHolder(std::shared_ptr<Object>(&object, [](auto* /*p*/) { /* do nothing */ }));
+    assert(object_ != nullptr);
 }
 
 ObjectHolder ObjectHolder::None() {
@@ -36,37 +35,31 @@ Object* ObjectHolder::operator->() const {
     return Get();
 }
 
-Object* ObjectHolder::Get() const {
-    return data_.get();
-}
-
-ObjectHolder::operator bool() const {
-    return Get() != nullptr;
-}
-
 bool IsTrue(const ObjectHolder& object) {
-    if (object.TryAs<String>() != nullptr) {
-        return !object.TryAs<String>()->GetValue().empty();
-    }
-    if (object.TryAs<Number>() != nullptr) {
-        return object.TryAs<Number>()->GetValue() !=0? true:false;
-    }
-    if (object.TryAs<Bool>() != nullptr) {
-        return object.TryAs<Bool>()->GetValue();
+    switch (object.GetType()) {
+    case ObjectType::String:
+        return !ValueOf<String>(object).empty();
+    case ObjectType::Number:
+        return ValueOf<Number>(object) != 0;
+    case ObjectType::BigNumber:
+        return !ValueOf<BigNumber>(object).IsZero();
+    case ObjectType::Bool:
+        return ValueOf<Bool>(object);
+    default:
+        return false;
     }
-    return false;
 }
 
 void ClassInstance::Print(std::ostream& os, Context& context) {
-    if (cls_.GetMethod("__str__"s) != nullptr) {
-        Call("__str__"s, {}, context).Get()->Print(os, context);
+    if (cls_.GetMethod(STR_METHOD) != nullptr) {
+        Call(STR_METHOD, {}, context).Get()->Print(os, context);
     }
     else {
         os << this;
     }
 }
 
-bool ClassInstance::HasMethod(const std::string& method, size_t argument_count) const {
+bool ClassInstance::HasMethod(Symbol method, size_t argument_count) const {
     auto getm_metod = cls_.GetMethod(method);
     if (getm_metod != nullptr) {
         if (getm_metod->formal_params.size() == argument_count) {
@@ -84,36 +77,53 @@ const Closure& ClassInstance::Fields() const {
     return fields_table_;
 }
 
-ClassInstance::ClassInstance(const Class& cls):cls_(cls) {
+const Class& ClassInstance::GetClass() const {
+    return cls_;
+}
+
+ClassInstance::ClassInstance(const Class& cls):Object(ObjectType::Instance), cls_(cls) {
 }
 
-ObjectHolder ClassInstance::Call(const std::string& method,
+ObjectHolder ClassInstance::Call(Symbol method,
                                  const std::vector<ObjectHolder>& actual_args,
                                  Context& context) {
-    if (HasMethod(method, actual_args.size())) {
-        Closure args_table_;
-        size_t i = 0;
-        for (const auto& arg_name : cls_.GetMethod(method)->formal_params) {
-            args_table_[arg_name] = actual_args[i++];
-        }       
-        args_table_["self"s] = ObjectHolder::Share(*this);
-        return cls_.GetMethod(method)->body.get()->Execute(args_table_, context);
+    const Method* called_method = cls_.GetMethod(method);
+    if (called_method != nullptr && called_method->formal_params.size() == actual_args.size()) {
+        return Call(*called_method, actual_args, context);
     }
     else {
         throw std::runtime_error("Not implemented"s);
     }
 }
 
+ObjectHolder ClassInstance::Call(const Method& method,
+                                 const std::vector<ObjectHolder>& actual_args,
+                                 Context& context) {
+    Closure args_table_;
+    if (method.frame_size > 0) {
+        args_table_.slots.resize(method.frame_size);
+        std::copy(actual_args.begin(), actual_args.end(), args_table_.slots.begin());
+        args_table_.slots[actual_args.size()] = ObjectHolder::Share(*this);
+        return method.body->Execute(args_table_, context);
+    }
+    size_t i = 0;
+    for (const auto& arg_name : method.formal_params) {
+        args_table_[arg_name] = actual_args[i++];
+    }
+    args_table_[SELF] = ObjectHolder::Share(*this);
+    return method.body.get()->Execute(args_table_, context);
+}
+
 Class::Class(std::string name, std::vector<Method> methods, const Class* parent):
-    name_(name), methods_(move(methods)), parent_(parent)
+    Object(ObjectType::Class), name_(name), methods_(move(methods)), parent_(parent)
 {
 }
 
-const Method* Class::GetMethod(const std::string& name) const {
+const Method* Class::GetMethod(Symbol name) const {
     auto name_check = [name](const Method& method) { return method.name == name; };
     auto result = find_if(methods_.begin(), methods_.end(), name_check);
     if (result != methods_.end()) {
-
+        Build(*result);
         return &(*result);
     }
     else {
@@ -128,6 +138,40 @@ const Method* Class::GetMethod(const std::string& name) const {
     return name_;
 }
 
+const std::vector<Method>& Class::GetMethods() const {
+    return methods_;
+}
+
+std::vector<Method>& Class::GetMethods() {
+    return methods_;
+}
+
+void Class::BuildMethods() const {
+    for (Method& method : methods_) {
+        Build(method);
+    }
+}
+
+void Class::Build(Method& method) {
+    if (!method.build) {
+        return;
+    }
+    auto build = std::move(method.build);
+    method.build = nullptr;
+    try {
+        build(method);
+    } catch (...) {
+        method.build = [error = std::current_exception()](Method&) {
+            std::rethrow_exception(error);
+        };
+        throw;
+    }
+}
+
+const Class* Class::GetParent() const {
+    return parent_;
+}
+
 void Class::Print(ostream& os, [[maybe_unused]] Context& context) {
     os << "Class "s << name_;
 }
@@ -137,50 +181,58 @@ void Bool::Print(std::ostream& os, [[maybe_unused]] Context& context) {
 }
 
 bool Equal(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
-    if (lhs.TryAs<String>() != nullptr && rhs.TryAs<String>() != nullptr) {
-        return lhs.TryAs<String>()->GetValue() == rhs.TryAs<String>()->GetValue();
-    }
-    if (lhs.TryAs<Number>() != nullptr && rhs.TryAs<Number>() != nullptr) {
-        return lhs.TryAs<Number>()->GetValue() == rhs.TryAs<Number>()->GetValue();
-    }
-    if (lhs.TryAs<Bool>() != nullptr && rhs.TryAs<Bool>() != nullptr) {
-        return lhs.TryAs<Bool>()->GetValue() == rhs.TryAs<Bool>()->GetValue();
-    }
-    if (lhs.TryAs<ClassInstance>() != nullptr && rhs.TryAs<ClassInstance>() != nullptr) {
-        if (lhs.TryAs<ClassInstance>()->HasMethod("__eq__"s,1)) {
-            Closure args_table_;
-            string argument_name = "rhs"s;
-            args_table_[argument_name] = ObjectHolder::Share(*rhs);
-            return IsTrue(
-                lhs.TryAs<ClassInstance>()->Call("__eq__"s, { rhs }, context)
-            );
+    switch (TypePair(lhs, rhs)) {
+    case TypePair(ObjectType::String, ObjectType::String):
+        return ValueOf<String>(lhs) == ValueOf<String>(rhs);
+    case TypePair(ObjectType::Number, ObjectType::Number):
+        return ValueOf<Number>(lhs) == ValueOf<Number>(rhs);
+    case TypePair(ObjectType::BigNumber, ObjectType::BigNumber):
+        return ValueOf<BigNumber>(lhs) == ValueOf<BigNumber>(rhs);
+    // BigNumber не помещается в int64_t, поэтому не равен никакому Number
+    case TypePair(ObjectType::Number, ObjectType::BigNumber):
+    case TypePair(ObjectType::BigNumber, ObjectType::Number):
+        return false;
+    case TypePair(ObjectType::Bool, ObjectType::Bool):
+        return ValueOf<Bool>(lhs) == ValueOf<Bool>(rhs);
+    case TypePair(ObjectType::Instance, ObjectType::Instance): {
+        auto* instance = lhs.TryAs<ClassInstance>();
+        if (instance->HasMethod(EQ_METHOD, 1)) {
+            return IsTrue(instance->Call(EQ_METHOD, { rhs }, context));
         }
+        break;
     }
-    if (!lhs && !rhs) {
+    case TypePair(ObjectType::None, ObjectType::None):
         return true;
+    default:
+        break;
     }
     throw std::runtime_error("Cannot compare objects for equality"s);
 }
 
 bool Less(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
-    if (lhs.TryAs<String>() != nullptr && rhs.TryAs<String>() != nullptr) {
-        return lhs.TryAs<String>()->GetValue() < rhs.TryAs<String>()->GetValue();
-    }
-    if (lhs.TryAs<Number>() != nullptr && rhs.TryAs<Number>() != nullptr) {
-        return lhs.TryAs<Number>()->GetValue() < rhs.TryAs<Number>()->GetValue();
-    }
-    if (lhs.TryAs<Bool>() != nullptr && rhs.TryAs<Bool>() != nullptr) {
-        return lhs.TryAs<Bool>()->GetValue() < rhs.TryAs<Bool>()->GetValue();
-    }
-    if (lhs.TryAs<ClassInstance>() != nullptr && rhs.TryAs<ClassInstance>() != nullptr) {
-        if (lhs.TryAs<ClassInstance>()->HasMethod("__lt__"s, 1)) {
-            Closure args_table_;
-            string argument_name = "rhs"s;
-            args_table_[argument_name] = ObjectHolder::Share(*rhs);
-            return IsTrue(
-                lhs.TryAs<ClassInstance>()->Call("__lt__"s, { rhs }, context)
-            );
+    switch (TypePair(lhs, rhs)) {
+    case TypePair(ObjectType::String, ObjectType::String):
+        return ValueOf<String>(lhs) < ValueOf<String>(rhs);
+    case TypePair(ObjectType::Number, ObjectType::Number):
+        return ValueOf<Number>(lhs) < ValueOf<Number>(rhs);
+    case TypePair(ObjectType::BigNumber, ObjectType::BigNumber):
+        return ValueOf<BigNumber>(lhs) < ValueOf<BigNumber>(rhs);
+    // Положительный BigNumber больше любого Number, отрицательный - меньше
+    case TypePair(ObjectType::Number, ObjectType::BigNumber):
+        return !ValueOf<BigNumber>(rhs).IsNegative();
+    case TypePair(ObjectType::BigNumber, ObjectType::Number):
+        return ValueOf<BigNumber>(lhs).IsNegative();
+    case TypePair(ObjectType::Bool, ObjectType::Bool):
+        return ValueOf<Bool>(lhs) < ValueOf<Bool>(rhs);
+    case TypePair(ObjectType::Instance, ObjectType::Instance): {
+        auto* instance = lhs.TryAs<ClassInstance>();
+        if (instance->HasMethod(LT_METHOD, 1)) {
+            return IsTrue(instance->Call(LT_METHOD, { rhs }, context));
         }
+        break;
+    }
+    default:
+        break;
     }
     throw std::runtime_error("Cannot compare objects for equality"s);
 }
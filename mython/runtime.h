@@ -1,9 +1,19 @@
 #pragma once
 
+#include "bigint.h"
+#include "symbol.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <new>
+#include <optional>
 #include <sstream>
 #include <string>
+#include <type_traits>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace runtime {
@@ -18,30 +28,204 @@ protected:
     ~Context() = default;
 };
 
+class ObjectHolder;
+class Bool;
+class Class;
+class ClassInstance;
+
+template <typename T>
+class ValueObject;
+
+// Строковое значение
+using String = ValueObject<std::string>;
+// Числовое значение
+using Number = ValueObject<int64_t>;
+// Число, которое не помещается в int64_t. Арифметика над Number переходит к нему при
+// переполнении и возвращается к Number, когда значение снова помещается в int64_t
+using BigNumber = ValueObject<BigInt>;
+
+// Тип объекта Mython. Встроенные операции выбирают вариант по типам аргументов, не вызывая
+// dynamic_cast
+enum class ObjectType : uint8_t {
+    None,  // пустой ObjectHolder
+    Number,
+    BigNumber,
+    String,
+    Bool,
+    Class,
+    Instance,
+    Other,  // остальные наследники Object
+};
+
+// Возвращает тип объектов класса T либо ObjectType::Other, если тип T не известен
+template <typename T>
+constexpr ObjectType TypeOf() {
+    if constexpr (std::is_same_v<T, Number>) {
+        return ObjectType::Number;
+    } else if constexpr (std::is_same_v<T, BigNumber>) {
+        return ObjectType::BigNumber;
+    } else if constexpr (std::is_same_v<T, String>) {
+        return ObjectType::String;
+    } else if constexpr (std::is_same_v<T, Bool>) {
+        return ObjectType::Bool;
+    } else if constexpr (std::is_same_v<T, Class>) {
+        return ObjectType::Class;
+    } else if constexpr (std::is_same_v<T, ClassInstance>) {
+        return ObjectType::Instance;
+    } else {
+        return ObjectType::Other;
+    }
+}
+
 // Базовый класс для всех объектов языка Mython
 class Object {
 public:
+    explicit Object(ObjectType type = ObjectType::Other) noexcept
+        : type_(type) {
+    }
+
+    // Копия объекта - новый объект, ссылки на оригинал на неё не переходят
+    Object(const Object& other) noexcept
+        : type_(other.type_) {
+    }
+    Object& operator=(const Object& /*other*/) noexcept {
+        return *this;
+    }
+
     virtual ~Object() = default;
     // выводит в os своё представление в виде строки
     virtual void Print(std::ostream& os, Context& context) = 0;
+
+    [[nodiscard]] ObjectType GetType() const {
+        return type_;
+    }
+
+private:
+    friend class ObjectHolder;
+
+    // Число владеющих объектом ObjectHolder. Программа выполняется одним потоком, поэтому
+    // счётчик не атомарный, если не задан MYTHON_ATOMIC_REFCOUNT
+#ifdef MYTHON_ATOMIC_REFCOUNT
+    std::atomic<uint32_t> ref_count_{0};
+#else
+    uint32_t ref_count_ = 0;
+#endif
+    ObjectType type_;
+};
+
+// Объект-значение, хранящий значение типа T
+template <typename T>
+class ValueObject : public Object {
+public:
+    ValueObject(T v)  // NOLINT(google-explicit-constructor,hicpp-explicit-conversions)
+        : Object(TypeOf<ValueObject>())
+        , value_(std::move(v)) {
+    }
+
+    void Print(std::ostream& os, [[maybe_unused]] Context& context) override {
+        os << value_;
+    }
+
+    [[nodiscard]] const T& GetValue() const {
+        return value_;
+    }
+
+protected:
+    ValueObject(T v, ObjectType type)
+        : Object(type)
+        , value_(std::move(v)) {
+    }
+
+private:
+    T value_;
 };
 
-// Специальный класс-обёртка, предназначенный для хранения объекта в Mython-программе
+// Логическое значение
+class Bool : public ValueObject<bool> {
+public:
+    Bool(bool v)  // NOLINT(google-explicit-constructor,hicpp-explicit-conversions)
+        : ValueObject<bool>(v, ObjectType::Bool) {
+    }
+
+    void Print(std::ostream& os, Context& context) override;
+};
+
+/*
+Специальный класс-обёртка, предназначенный для хранения объекта в Mython-программе.
+Числа (Number) и логические значения (Bool) хранятся внутри самого ObjectHolder, поэтому
+арифметика и сравнения не выделяют память в куче. Указатель на такое значение, полученный от
+Get или TryAs, действителен, пока жив и не изменён ObjectHolder, из которого он получен.
+Остальные объекты, созданные Own, хранятся в куче, копии ObjectHolder разделяют их и считают
+ссылки в самом объекте (Object). ObjectHolder, созданный Share, ссылку не считает.
+
+Get и TryAs возвращают указатель на настоящий объект, поэтому число хранится целым объектом
+Number с таблицей виртуальных функций, счётчиком ссылок и типом, а тип нельзя упаковать в
+указатель или в само значение (NaN-boxing). На 64-битной платформе ObjectHolder занимает
+32 байта: 24 байта Number и указатель на значение. Прежний ObjectHolder на std::shared_ptr
+занимал 16 байт, но каждое число выделяло память в куче
+*/
 class ObjectHolder {
 public:
     // Создаёт пустое значение
-    ObjectHolder() = default;
+    ObjectHolder() noexcept
+        : owns_(false) {
+    }
+
+    ObjectHolder(const ObjectHolder& other) noexcept {
+        CopyFrom(other);
+    }
+
+    ObjectHolder(ObjectHolder&& other) noexcept {
+        MoveFrom(other);
+    }
+
+    // other может принадлежать объекту, который хранится в этом ObjectHolder, поэтому значение
+    // other забирается до того, как освобождается прежнее значение
+    ObjectHolder& operator=(const ObjectHolder& other) noexcept {
+        if (this != &other) {
+            ObjectHolder copy(other);
+            *this = std::move(copy);
+        }
+        return *this;
+    }
+
+    ObjectHolder& operator=(ObjectHolder&& other) noexcept {
+        if (this != &other) {
+            ObjectHolder taken(std::move(other));
+            Release();
+            MoveFrom(taken);
+        }
+        return *this;
+    }
+
+    ~ObjectHolder() {
+        Release();
+    }
 
     // Возвращает ObjectHolder, владеющий объектом типа T
     // Тип T - конкретный класс-наследник Object.
-    // object копируется или перемещается в кучу
+    // object копируется или перемещается в ObjectHolder, если это Number или Bool, иначе в кучу
     template <typename T>
     [[nodiscard]] static ObjectHolder Own(T&& object) {
-        return ObjectHolder(std::make_shared<T>(std::forward<T>(object)));
+        ObjectHolder result;
+        if constexpr (std::is_same_v<T, Number> || std::is_same_v<T, Bool>) {
+            result.object_ = result.Construct<T>(std::forward<T>(object));
+        } else {
+            result.object_ = new T(std::forward<T>(object));
+            result.object_->ref_count_ = 1;
+            result.owns_ = true;
+        }
+        return result;
+    }
+
+    // Создаёт ObjectHolder, не владеющий объектом (аналог слабой ссылки). Память не выделяется,
+    // счётчик ссылок объекта не меняется
+    [[nodiscard]] static ObjectHolder Share(Object& object) noexcept {
+        ObjectHolder result;
+        result.object_ = &object;
+        return result;
     }
 
-    // Создаёт ObjectHolder, не владеющий объектом (аналог слабой ссылки)
-    [[nodiscard]] static ObjectHolder Share(Object& object);
     // Создаёт пустой ObjectHolder, соответствующий значению None
     [[nodiscard]] static ObjectHolder None();
 
@@ -51,47 +235,122 @@ public:
 
     Object* operator->() const;
 
-    [[nodiscard]] Object* Get() const;
+    [[nodiscard]] Object* Get() const {
+        return object_;
+    }
 
     // Возвращает указатель на объект типа T либо nullptr, если внутри ObjectHolder не хранится
-    // объект данного типа
+    // объект данного типа. Встроенные типы проверяются по GetType, остальные - dynamic_cast
     template <typename T>
     [[nodiscard]] T* TryAs() const {
-        return dynamic_cast<T*>(this->Get());
+        if constexpr (TypeOf<T>() != ObjectType::Other) {
+            return GetType() == TypeOf<T>() ? static_cast<T*>(object_) : nullptr;
+        } else {
+            return dynamic_cast<T*>(this->Get());
+        }
+    }
+
+    // Возвращает тип хранимого объекта, ObjectType::None для пустого ObjectHolder
+    [[nodiscard]] ObjectType GetType() const {
+        return object_ != nullptr ? object_->type_ : ObjectType::None;
     }
 
     // Возвращает true, если ObjectHolder не пуст
-    explicit operator bool() const;
+    explicit operator bool() const {
+        return object_ != nullptr;
+    }
 
 private:
-    explicit ObjectHolder(std::shared_ptr<Object> data);
     void AssertIsValid() const;
 
-    std::shared_ptr<Object> data_;
-};
+    [[nodiscard]] bool IsInline() const {
+        return object_ == static_cast<const Object*>(&number_)
+               || object_ == static_cast<const Object*>(&bool_);
+    }
 
-// Объект-значение, хранящий значение типа T
-template <typename T>
-class ValueObject : public Object {
-public:
-    ValueObject(T v)  // NOLINT(google-explicit-constructor,hicpp-explicit-conversions)
-        : value_(v) {
+    template <typename T, typename Value>
+    T* Construct(Value&& value) {
+        if constexpr (std::is_same_v<T, Bool>) {
+            return new (&bool_) Bool(std::forward<Value>(value));
+        } else {
+            return new (&number_) Number(std::forward<Value>(value));
+        }
     }
 
-    void Print(std::ostream& os, [[maybe_unused]] Context& context) override {
-        os << value_;
+    // Конструирует копию other в ObjectHolder без значения
+    void CopyFrom(const ObjectHolder& other) noexcept {
+        if (!other.IsInline()) {
+            owns_ = other.owns_;
+            object_ = other.object_;
+            if (owns_) {
+                ++object_->ref_count_;
+            }
+        } else if (other.object_->type_ == ObjectType::Bool) {
+            object_ = Construct<Bool>(other.bool_);
+        } else {
+            object_ = Construct<Number>(other.number_);
+        }
     }
 
-    [[nodiscard]] const T& GetValue() const {
-        return value_;
+    // Забирает значение other, other остаётся пустым, если его объект хранится вне его
+    void MoveFrom(ObjectHolder& other) noexcept {
+        if (other.IsInline()) {
+            CopyFrom(other);
+            return;
+        }
+        owns_ = std::exchange(other.owns_, false);
+        object_ = std::exchange(other.object_, nullptr);
     }
 
-private:
-    T value_;
+    // Освобождает ссылку на объект кучи. Деструкторы Number и Bool не вызываются: они ничего не
+    // освобождают
+    void Release() noexcept {
+        if (!IsInline() && owns_ && --object_->ref_count_ == 0) {
+            delete object_;
+        }
+    }
+
+    // Значение, на которое указывает object_, либо признак того, что ObjectHolder владеет
+    // ссылкой на объект вне его
+    union {
+        Number number_;
+        Bool bool_;
+        bool owns_;
+    };
+    Object* object_ = nullptr;
 };
 
-// Таблица символов, связывающая имя объекта с его значением
-using Closure = std::unordered_map<std::string, ObjectHolder>;
+// Кроме значения и указателя на него ObjectHolder ничего не хранит: признак владения объектом
+// кучи лежит в объединении со значением
+static_assert(sizeof(ObjectHolder) == sizeof(Number) + sizeof(Object*));
+
+// Возвращает номер пары типов аргументов бинарной операции. Операции выбирают вариант по нему
+// в switch, например case TypePair(ObjectType::Number, ObjectType::Number)
+constexpr unsigned TypePair(ObjectType lhs, ObjectType rhs) {
+    return static_cast<unsigned>(lhs) << 8 | static_cast<unsigned>(rhs);
+}
+
+inline unsigned TypePair(const ObjectHolder& lhs, const ObjectHolder& rhs) {
+    return TypePair(lhs.GetType(), rhs.GetType());
+}
+
+// Возвращает значение объекта-значения типа T (Number, BigNumber, String или Bool). Тип объекта должен быть
+// проверен по GetType
+template <typename T>
+[[nodiscard]] const auto& ValueOf(const ObjectHolder& holder) {
+    return static_cast<const T*>(holder.Get())->GetValue();
+}
+
+// Таблица символов, связывающая имя объекта с его значением.
+// Переменные методов, имена которых разрешены при разборе программы, хранятся не в таблице,
+// а в слотах кадра и читаются по номеру слота без поиска по имени
+class Closure : public std::unordered_map<Symbol, ObjectHolder> {
+public:
+    using unordered_map::unordered_map;
+
+    // Слоты кадра метода. Пустой слот - переменная, которой ещё не присвоено значение
+    std::vector<std::optional<ObjectHolder>> slots;
+};
 
 // Проверяет, содержится ли в object значение, приводимое к True
 // Для отличных от нуля чисел, True и непустых строк возвращается true. В остальных случаях - false.
@@ -104,54 +363,98 @@ public:
     // Выполняет действие над объектами внутри closure, используя context
     // Возвращает результирующее значение либо None
     virtual ObjectHolder Execute(Closure& closure, Context& context) = 0;
+    // Вычисляет значение как условие и приводит его к bool по правилам IsTrue. Сравнения
+    // и логические операции переопределяют метод и не создают объект Bool
+    virtual bool EvaluateCondition(Closure& closure, Context& context) {
+        return IsTrue(Execute(closure, context));
+    }
 };
 
-// Строковое значение
-using String = ValueObject<std::string>;
-// Числовое значение
-using Number = ValueObject<int>;
-
-// Логическое значение
-class Bool : public ValueObject<bool> {
+// Удаляет инструкцию, если указатель ею владеет. Инструкции из арены (ast::Arena) не удаляются
+// по одной: их память освобождает арена
+class ExecutableDeleter {
 public:
-    using ValueObject<bool>::ValueObject;
+    ExecutableDeleter() = default;
 
-    void Print(std::ostream& os, Context& context) override;
+    // Указатели, полученные из std::unique_ptr, владеют инструкцией
+    template <typename T>
+    ExecutableDeleter(const std::default_delete<T>& /*deleter*/) noexcept {  // NOLINT
+    }
+
+    // Возвращает удалитель указателя, который не владеет инструкцией
+    [[nodiscard]] static ExecutableDeleter NonOwning() noexcept {
+        ExecutableDeleter deleter;
+        deleter.owns_ = false;
+        return deleter;
+    }
+
+    void operator()(Executable* executable) const {
+        if (owns_) {
+            delete executable;
+        }
+    }
+
+private:
+    bool owns_ = true;
 };
 
+using ExecutablePtr = std::unique_ptr<Executable, ExecutableDeleter>;
+
 // Метод класса
 struct Method {
     // Имя метода
-    std::string name;
+    Symbol name;
     // Имена формальных параметров метода
-    std::vector<std::string> formal_params;
+    std::vector<Symbol> formal_params;
     // Тело метода
-    std::unique_ptr<Executable> body;
+    ExecutablePtr body;
+    // Число слотов кадра метода: параметры по порядку, self и локальные переменные.
+    // 0 - все переменные метода хранятся в Closure по именам
+    size_t frame_size = 0;
+    // Если задана, тело метода ещё не построено: функция строит его и заполняет body и
+    // frame_size, когда метод понадобится впервые (см. Class::GetMethod)
+    std::function<void(Method&)> build {};
 };
 
 // Класс
-class Class : public Object {
+class Class final : public Object {
 public:
     // Создаёт класс с именем name и набором методов methods, унаследованный от класса parent
     // Если parent равен nullptr, то создаётся базовый класс
     explicit Class(std::string name, std::vector<Method> methods, const Class* parent);
 
-    // Возвращает указатель на метод name или nullptr, если метод с таким именем отсутствует
-    [[nodiscard]] const Method* GetMethod(const std::string& name) const;
+    // Возвращает указатель на метод name или nullptr, если метод с таким именем отсутствует.
+    // Тело найденного метода строится, если оно ещё не построено. Если построить его не удалось,
+    // исключение выбрасывается при этом и при каждом следующем обращении к методу
+    [[nodiscard]] const Method* GetMethod(Symbol name) const;
 
     // Возвращает имя класса
     [[nodiscard]] const std::string& GetName() const;
 
+    // Возвращает методы, объявленные в самом классе, без унаследованных.
+    // Тела методов могут быть ещё не построены, см. BuildMethods
+    [[nodiscard]] const std::vector<Method>& GetMethods() const;
+    [[nodiscard]] std::vector<Method>& GetMethods();
+
+    // Строит тела всех методов класса, которые ещё не построены
+    void BuildMethods() const;
+
+    // Возвращает родительский класс либо nullptr
+    [[nodiscard]] const Class* GetParent() const;
+
     // Выводит в os строку "Class <имя класса>", например "Class cat"
     void Print(std::ostream& os, Context& context) override;
 private:
     const std::string name_;
-    std::vector<Method> methods_;
+    // Построение тела метода не меняет поведения класса, поэтому возможно и у константного класса
+    mutable std::vector<Method> methods_;
     const Class* parent_;
+
+    static void Build(Method& method);
 };
 
 // Экземпляр класса
-class ClassInstance : public Object {
+class ClassInstance final : public Object {
 public:
     explicit ClassInstance(const Class& cls);
 
@@ -167,16 +470,24 @@ public:
      * Если ни сам класс, ни его родители не содержат метод method, метод выбрасывает исключение
      * runtime_error
      */
-    ObjectHolder Call(const std::string& method, const std::vector<ObjectHolder>& actual_args,
+    ObjectHolder Call(Symbol method, const std::vector<ObjectHolder>& actual_args,
+                      Context& context);
+
+    // Вызывает метод method, найденный заранее, без поиска по имени в классе и его родителях.
+    // Тело метода должно быть построено, а число его параметров - совпадать с числом аргументов
+    ObjectHolder Call(const Method& method, const std::vector<ObjectHolder>& actual_args,
                       Context& context);
 
     // Возвращает true, если объект имеет метод method, принимающий argument_count параметров
-    [[nodiscard]] bool HasMethod(const std::string& method, size_t argument_count) const;
+    [[nodiscard]] bool HasMethod(Symbol method, size_t argument_count) const;
 
     // Возвращает ссылку на Closure, содержащий поля объекта
     [[nodiscard]] Closure& Fields();
     // Возвращает константную ссылку на Closure, содержащую поля объекта
     [[nodiscard]] const Closure& Fields() const;
+
+    // Возвращает класс объекта
+    [[nodiscard]] const Class& GetClass() const;
 private:
     const Class& cls_;
     Closure fields_table_;
@@ -2,6 +2,10 @@
 #include "test_runner_p.h"
 
 #include <functional>
+#include <limits>
+#include <random>
+#include <string>
+#include <thread>
 
 using namespace std;
 
@@ -19,13 +23,15 @@ public:
     }
 
     Logger(const Logger& rhs)
-        : id_(rhs.id_)  //
+        : Object(rhs)
+        , id_(rhs.id_)  //
     {
         ++instance_count;
     }
 
     Logger(Logger&& rhs) noexcept
-        : id_(rhs.id_)  //
+        : Object(rhs)
+        , id_(rhs.id_)  //
     {
         ++instance_count;
     }
@@ -529,6 +535,92 @@ void TestClassInstance() {
     ASSERT_THROWS(instance.Call("missing_method"s, {}, ctx), runtime_error);
 }
 
+void TestSymbols() {
+    const Symbol x = "symbol_test_x"s;
+    ASSERT(x == Symbol("symbol_test_x"sv));
+    ASSERT(x != Symbol("symbol_test_y"sv));
+    ASSERT_EQUAL(x.Name(), "symbol_test_x"s);
+    ASSERT_EQUAL(x, "symbol_test_x"s);
+    ASSERT_EQUAL(Symbol().Name(), ""s);
+    ASSERT_EQUAL(hash<Symbol>{}(x), x.Id());
+
+    // Names interned concurrently get one id each
+    vector<vector<Symbol>> interned(4);
+    vector<thread> threads;
+    for (auto& symbols : interned) {
+        threads.emplace_back([&symbols] {
+            for (int i = 0; i < 1000; ++i) {
+                symbols.emplace_back("symbol_test_"s + to_string(i));
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    for (const auto& symbols : interned) {
+        for (int i = 0; i < 1000; ++i) {
+            ASSERT(symbols[i] == interned.front()[i]);
+            ASSERT_EQUAL(symbols[i].Name(), "symbol_test_"s + to_string(i));
+        }
+    }
+}
+
+void TestBigInt() {
+    const int64_t max = numeric_limits<int64_t>::max();
+    const int64_t min = numeric_limits<int64_t>::min();
+    for (int64_t value : {int64_t(0), int64_t(1), int64_t(-1), max, min}) {
+        ASSERT_EQUAL(BigInt(value).ToInt64().value(), value);
+        ASSERT_EQUAL(BigInt(value).ToString(), to_string(value));
+    }
+    ASSERT_EQUAL((BigInt(max) + BigInt(1)).ToString(), "9223372036854775808"s);
+    ASSERT(!(BigInt(max) + BigInt(1)).ToInt64());
+    ASSERT_EQUAL((-BigInt(min)).ToString(), "9223372036854775808"s);
+    ASSERT_EQUAL((BigInt(min) - BigInt(1)).ToString(), "-9223372036854775809"s);
+    ASSERT_EQUAL((BigInt(min) - BigInt(1) + BigInt(1)).ToInt64().value(), min);
+    ASSERT_EQUAL((BigInt(min) * BigInt(min)).ToString(), "85070591730234615865843651857942052864"s);
+    ASSERT(BigInt(min) < BigInt(max) && BigInt(-5) < BigInt(-3) && !(BigInt(2) < BigInt(2)));
+
+    // Products of int64_t values fit in __int128, the quotients are truncated like C++ ones
+    auto to_string_128 = [](__int128 value) {
+        const bool negative = value < 0;
+        string digits;
+        do {
+            const int digit = static_cast<int>(value % 10);
+            digits += static_cast<char>('0' + (negative ? -digit : digit));
+            value /= 10;
+        } while (value != 0);
+        return (negative ? "-"s : ""s) + string(digits.rbegin(), digits.rend());
+    };
+    mt19937_64 random(42);
+    for (int i = 0; i < 1000; ++i) {
+        const auto lhs = static_cast<int64_t>(random()) >> (random() % 64);
+        const auto rhs = static_cast<int64_t>(random()) >> (random() % 64);
+        ASSERT_EQUAL((BigInt(lhs) * BigInt(rhs)).ToString(), to_string_128(__int128(lhs) * rhs));
+        ASSERT_EQUAL((BigInt(lhs) + BigInt(rhs)).ToString(), to_string_128(__int128(lhs) + rhs));
+        ASSERT_EQUAL((BigInt(lhs) - BigInt(rhs)).ToString(), to_string_128(__int128(lhs) - rhs));
+        if (rhs != 0) {
+            const BigInt dividend = BigInt(lhs) * BigInt(max) + BigInt(rhs);
+            ASSERT_EQUAL((dividend / BigInt(rhs)).ToString(),
+                         to_string_128((__int128(lhs) * max + rhs) / rhs));
+        }
+    }
+    ASSERT_THROWS(BigInt(1) / BigInt(0), domain_error);
+
+    // Numbers of 2000 bits are multiplied by the Karatsuba algorithm
+    BigInt power(1);
+    for (int i = 0; i < 600; ++i) {
+        power = power * BigInt(10);
+    }
+    const BigInt nines = power - BigInt(1);
+    ASSERT_EQUAL((power * power).ToString(), "1"s + string(1200, '0'));
+    ASSERT_EQUAL((nines * nines).ToString(),
+                 string(599, '9') + "8"s + string(599, '0') + "1"s);
+    ASSERT_EQUAL(nines * nines / nines, nines);
+    ASSERT_EQUAL((nines * nines + nines - BigInt(1)) / nines, nines);
+    ASSERT_EQUAL((nines * nines + nines) / nines, power);
+    ASSERT_EQUAL(-(nines * -nines) / (BigInt(0) - power), BigInt(0) - nines + BigInt(1));
+}
+
 }  // namespace
 
 void RunObjectsTests(TestRunner& tr) {
@@ -540,6 +632,8 @@ void RunObjectsTests(TestRunner& tr) {
     RUN_TEST(tr, runtime::TestComparison);
     RUN_TEST(tr, runtime::TestClass);
     RUN_TEST(tr, runtime::TestClassInstance);
+    RUN_TEST(tr, runtime::TestSymbols);
+    RUN_TEST(tr, runtime::TestBigInt);
 }
 
 void RunObjectHolderTests(TestRunner& tr) {
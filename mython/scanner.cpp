@@ -0,0 +1,459 @@
+#include "scanner.h"
+
+#include "lexer_tables.h"
+
+#include <algorithm>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__) \
+		&& (defined(__GNUC__) || defined(__clang__))
+#define MYTHON_SCAN_X86
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace parse {
+
+namespace {
+
+const char* FindIdEndScalar(const char *begin, const char *end) {
+	while (begin != end && IsIdSymbol(*begin)) {
+		++begin;
+	}
+	return begin;
+}
+
+const char* SkipSpacesScalar(const char *begin, const char *end) {
+	while (begin != end && *begin == ' ') {
+		++begin;
+	}
+	return begin;
+}
+
+const char* FindNewlineScalar(const char *begin, const char *end) {
+	while (begin != end && *begin != '\n') {
+		++begin;
+	}
+	return begin;
+}
+
+const char* FindStringStopScalar(const char *begin, const char *end, char quote) {
+	while (begin != end && *begin != quote && *begin != '\\') {
+		++begin;
+	}
+	return begin;
+}
+
+const char* FindNonAsciiScalar(const char *begin, const char *end) {
+	while (begin != end && static_cast<unsigned char>(*begin) < 0x80) {
+		++begin;
+	}
+	return begin;
+}
+
+const char* FindNewlineOrNonAsciiScalar(const char *begin, const char *end) {
+	while (begin != end && *begin != '\n' && static_cast<unsigned char>(*begin) < 0x80) {
+		++begin;
+	}
+	return begin;
+}
+
+constexpr ScanKernels SCALAR_KERNELS { FindIdEndScalar, SkipSpacesScalar, FindNewlineScalar,
+	FindStringStopScalar, FindNonAsciiScalar, FindNewlineOrNonAsciiScalar };
+
+#ifdef MYTHON_SCAN_X86
+
+// Each kernel processes whole vectors while they fit into [begin, end) and leaves the tail
+// to the scalar version, so the source is never read past its end
+
+// Bytes of x in [lo, hi]. SSE2 compares only signed bytes, so the range is moved to the bottom
+__m128i InRange(__m128i x, char lo, char hi) {
+	const __m128i shifted = _mm_add_epi8(x, _mm_set1_epi8(static_cast<char>(0x80 - lo)));
+	return _mm_cmplt_epi8(shifted, _mm_set1_epi8(static_cast<char>(0x80 + (hi - lo) + 1)));
+}
+
+__m128i IdSymbols(__m128i x) {
+	const __m128i letters = InRange(_mm_or_si128(x, _mm_set1_epi8(0x20)), 'a', 'z');
+	const __m128i digits = InRange(x, '0', '9');
+	const __m128i underscores = _mm_cmpeq_epi8(x, _mm_set1_epi8('_'));
+	return _mm_or_si128(_mm_or_si128(letters, digits), underscores);
+}
+
+__m128i Load(const char *data) {
+	return _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+}
+
+const char* FindIdEndSse2(const char *begin, const char *end) {
+	for (; end - begin >= 16; begin += 16) {
+		const unsigned stops = ~static_cast<unsigned>(_mm_movemask_epi8(IdSymbols(Load(begin))))
+				& 0xFFFFu;
+		if (stops != 0) {
+			return begin + __builtin_ctz(stops);
+		}
+	}
+	return FindIdEndScalar(begin, end);
+}
+
+const char* SkipSpacesSse2(const char *begin, const char *end) {
+	const __m128i spaces = _mm_set1_epi8(' ');
+	for (; end - begin >= 16; begin += 16) {
+		const unsigned stops = ~static_cast<unsigned>(_mm_movemask_epi8(
+				_mm_cmpeq_epi8(Load(begin), spaces))) & 0xFFFFu;
+		if (stops != 0) {
+			return begin + __builtin_ctz(stops);
+		}
+	}
+	return SkipSpacesScalar(begin, end);
+}
+
+const char* FindNewlineSse2(const char *begin, const char *end) {
+	const __m128i newlines = _mm_set1_epi8('\n');
+	for (; end - begin >= 16; begin += 16) {
+		const unsigned stops = static_cast<unsigned>(_mm_movemask_epi8(
+				_mm_cmpeq_epi8(Load(begin), newlines)));
+		if (stops != 0) {
+			return begin + __builtin_ctz(stops);
+		}
+	}
+	return FindNewlineScalar(begin, end);
+}
+
+const char* FindStringStopSse2(const char *begin, const char *end, char quote) {
+	const __m128i quotes = _mm_set1_epi8(quote);
+	const __m128i backslashes = _mm_set1_epi8('\\');
+	for (; end - begin >= 16; begin += 16) {
+		const __m128i chunk = Load(begin);
+		const unsigned stops = static_cast<unsigned>(_mm_movemask_epi8(
+				_mm_or_si128(_mm_cmpeq_epi8(chunk, quotes), _mm_cmpeq_epi8(chunk, backslashes))));
+		if (stops != 0) {
+			return begin + __builtin_ctz(stops);
+		}
+	}
+	return FindStringStopScalar(begin, end, quote);
+}
+
+// The sign bits of the bytes are the bits of non-ASCII bytes
+const char* FindNonAsciiSse2(const char *begin, const char *end) {
+	for (; end - begin >= 16; begin += 16) {
+		const unsigned stops = static_cast<unsigned>(_mm_movemask_epi8(Load(begin)));
+		if (stops != 0) {
+			return begin + __builtin_ctz(stops);
+		}
+	}
+	return FindNonAsciiScalar(begin, end);
+}
+
+const char* FindNewlineOrNonAsciiSse2(const char *begin, const char *end) {
+	const __m128i newlines = _mm_set1_epi8('\n');
+	for (; end - begin >= 16; begin += 16) {
+		const __m128i chunk = Load(begin);
+		const unsigned stops = static_cast<unsigned>(_mm_movemask_epi8(
+				_mm_or_si128(_mm_cmpeq_epi8(chunk, newlines), chunk)));
+		if (stops != 0) {
+			return begin + __builtin_ctz(stops);
+		}
+	}
+	return FindNewlineOrNonAsciiScalar(begin, end);
+}
+
+constexpr ScanKernels SSE2_KERNELS { FindIdEndSse2, SkipSpacesSse2, FindNewlineSse2,
+	FindStringStopSse2, FindNonAsciiSse2, FindNewlineOrNonAsciiSse2 };
+
+#define MYTHON_AVX2 __attribute__((target("avx2")))
+
+MYTHON_AVX2 __m256i InRange(__m256i x, char lo, char hi) {
+	const __m256i shifted = _mm256_add_epi8(x, _mm256_set1_epi8(static_cast<char>(0x80 - lo)));
+	return _mm256_cmpgt_epi8(_mm256_set1_epi8(static_cast<char>(0x80 + (hi - lo) + 1)), shifted);
+}
+
+MYTHON_AVX2 __m256i IdSymbols(__m256i x) {
+	const __m256i letters = InRange(_mm256_or_si256(x, _mm256_set1_epi8(0x20)), 'a', 'z');
+	const __m256i digits = InRange(x, '0', '9');
+	const __m256i underscores = _mm256_cmpeq_epi8(x, _mm256_set1_epi8('_'));
+	return _mm256_or_si256(_mm256_or_si256(letters, digits), underscores);
+}
+
+MYTHON_AVX2 __m256i Load256(const char *data) {
+	return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+}
+
+// The AVX2 kernels do not leave the tail to the SSE2 and scalar ones. Most stops of the lexer
+// are close, so the first 32 bytes are checked by 16-byte vectors and only the rest by 32-byte
+// ones. The bytes after the last whole vector are checked by one more vector that ends at end
+// and overlaps checked bytes: they have no stops, so its first stop is the first stop of the
+// range. Only ranges shorter than 16 bytes are checked symbol by symbol. Stops gives the bit
+// masks of the stop bytes for both vector widths
+template <typename Stops>
+MYTHON_AVX2 const char* FindStopAvx2(const char *begin, const char *end, const Stops &stops) {
+	const ptrdiff_t size = end - begin;
+	if (size < 16) {
+		return stops.Scalar(begin, end);
+	}
+	for (const char *head_end = begin + min<ptrdiff_t>(size, 32); head_end - begin >= 16;
+			begin += 16) {
+		if (const unsigned mask = stops(Load(begin)); mask != 0) {
+			return begin + __builtin_ctz(mask);
+		}
+	}
+	for (; end - begin >= 32; begin += 32) {
+		if (const unsigned mask = stops(Load256(begin)); mask != 0) {
+			return begin + __builtin_ctz(mask);
+		}
+	}
+	if (begin == end) {
+		return end;
+	}
+	if (size >= 32) {
+		const unsigned mask = stops(Load256(end - 32));
+		return mask != 0 ? end - 32 + __builtin_ctz(mask) : end;
+	}
+	const unsigned mask = stops(Load(end - 16));
+	return mask != 0 ? end - 16 + __builtin_ctz(mask) : end;
+}
+
+struct IdEndStops {
+	MYTHON_AVX2 unsigned operator()(__m256i x) const {
+		return ~static_cast<unsigned>(_mm256_movemask_epi8(IdSymbols(x)));
+	}
+
+	MYTHON_AVX2 unsigned operator()(__m128i x) const {
+		return ~static_cast<unsigned>(_mm_movemask_epi8(IdSymbols(x))) & 0xFFFFu;
+	}
+
+	const char* Scalar(const char *begin, const char *end) const {
+		return FindIdEndScalar(begin, end);
+	}
+};
+
+struct SpaceStops {
+	MYTHON_AVX2 unsigned operator()(__m256i x) const {
+		return ~static_cast<unsigned>(_mm256_movemask_epi8(
+				_mm256_cmpeq_epi8(x, _mm256_set1_epi8(' '))));
+	}
+
+	MYTHON_AVX2 unsigned operator()(__m128i x) const {
+		return ~static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(x, _mm_set1_epi8(' '))))
+				& 0xFFFFu;
+	}
+
+	const char* Scalar(const char *begin, const char *end) const {
+		return SkipSpacesScalar(begin, end);
+	}
+};
+
+struct NewlineStops {
+	MYTHON_AVX2 unsigned operator()(__m256i x) const {
+		return static_cast<unsigned>(_mm256_movemask_epi8(
+				_mm256_cmpeq_epi8(x, _mm256_set1_epi8('\n'))));
+	}
+
+	MYTHON_AVX2 unsigned operator()(__m128i x) const {
+		return static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(x, _mm_set1_epi8('\n'))));
+	}
+
+	const char* Scalar(const char *begin, const char *end) const {
+		return FindNewlineScalar(begin, end);
+	}
+};
+
+struct StringStops {
+	char quote;
+
+	MYTHON_AVX2 unsigned operator()(__m256i x) const {
+		return static_cast<unsigned>(_mm256_movemask_epi8(_mm256_or_si256(
+				_mm256_cmpeq_epi8(x, _mm256_set1_epi8(quote)),
+				_mm256_cmpeq_epi8(x, _mm256_set1_epi8('\\')))));
+	}
+
+	MYTHON_AVX2 unsigned operator()(__m128i x) const {
+		return static_cast<unsigned>(_mm_movemask_epi8(_mm_or_si128(
+				_mm_cmpeq_epi8(x, _mm_set1_epi8(quote)), _mm_cmpeq_epi8(x, _mm_set1_epi8('\\')))));
+	}
+
+	const char* Scalar(const char *begin, const char *end) const {
+		return FindStringStopScalar(begin, end, quote);
+	}
+};
+
+// The sign bits of the bytes are the bits of non-ASCII bytes
+struct NonAsciiStops {
+	MYTHON_AVX2 unsigned operator()(__m256i x) const {
+		return static_cast<unsigned>(_mm256_movemask_epi8(x));
+	}
+
+	MYTHON_AVX2 unsigned operator()(__m128i x) const {
+		return static_cast<unsigned>(_mm_movemask_epi8(x));
+	}
+
+	const char* Scalar(const char *begin, const char *end) const {
+		return FindNonAsciiScalar(begin, end);
+	}
+};
+
+struct NewlineOrNonAsciiStops {
+	MYTHON_AVX2 unsigned operator()(__m256i x) const {
+		return static_cast<unsigned>(_mm256_movemask_epi8(
+				_mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('\n')), x)));
+	}
+
+	MYTHON_AVX2 unsigned operator()(__m128i x) const {
+		return static_cast<unsigned>(_mm_movemask_epi8(
+				_mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('\n')), x)));
+	}
+
+	const char* Scalar(const char *begin, const char *end) const {
+		return FindNewlineOrNonAsciiScalar(begin, end);
+	}
+};
+
+MYTHON_AVX2 const char* FindIdEndAvx2(const char *begin, const char *end) {
+	return FindStopAvx2(begin, end, IdEndStops { });
+}
+
+MYTHON_AVX2 const char* SkipSpacesAvx2(const char *begin, const char *end) {
+	return FindStopAvx2(begin, end, SpaceStops { });
+}
+
+MYTHON_AVX2 const char* FindNewlineAvx2(const char *begin, const char *end) {
+	return FindStopAvx2(begin, end, NewlineStops { });
+}
+
+MYTHON_AVX2 const char* FindStringStopAvx2(const char *begin, const char *end, char quote) {
+	return FindStopAvx2(begin, end, StringStops { quote });
+}
+
+MYTHON_AVX2 const char* FindNonAsciiAvx2(const char *begin, const char *end) {
+	return FindStopAvx2(begin, end, NonAsciiStops { });
+}
+
+MYTHON_AVX2 const char* FindNewlineOrNonAsciiAvx2(const char *begin, const char *end) {
+	return FindStopAvx2(begin, end, NewlineOrNonAsciiStops { });
+}
+
+#undef MYTHON_AVX2
+
+constexpr ScanKernels AVX2_KERNELS { FindIdEndAvx2, SkipSpacesAvx2, FindNewlineAvx2,
+	FindStringStopAvx2, FindNonAsciiAvx2, FindNewlineOrNonAsciiAvx2 };
+
+#endif  // MYTHON_SCAN_X86
+
+ScanIsa DetectScanIsa() {
+#ifdef MYTHON_SCAN_X86
+	if (__builtin_cpu_supports("avx2")) {
+		return ScanIsa::AVX2;
+	}
+	return ScanIsa::SSE2;
+#else
+	return ScanIsa::SCALAR;
+#endif
+}
+
+// Returns the end of the UTF-8 sequence that starts with a non-ASCII byte at begin
+// or begin if the sequence is invalid
+const char* SkipUtf8Sequence(const char *begin, const char *end) {
+	const auto byte_at = [begin](ptrdiff_t i) {
+		return static_cast<unsigned char>(begin[i]);
+	};
+	const unsigned char lead = byte_at(0);
+	ptrdiff_t length = 0;
+	// The second byte has a narrower range after the leads of overlong encodings,
+	// surrogates and code points above U+10FFFF
+	unsigned char second_min = 0x80;
+	unsigned char second_max = 0xBF;
+	if (lead >= 0xC2 && lead <= 0xDF) {
+		length = 2;
+	} else if (lead >= 0xE0 && lead <= 0xEF) {
+		length = 3;
+		second_min = lead == 0xE0 ? 0xA0 : 0x80;
+		second_max = lead == 0xED ? 0x9F : 0xBF;
+	} else if (lead >= 0xF0 && lead <= 0xF4) {
+		length = 4;
+		second_min = lead == 0xF0 ? 0x90 : 0x80;
+		second_max = lead == 0xF4 ? 0x8F : 0xBF;
+	} else {
+		return begin;
+	}
+	if (end - begin < length || byte_at(1) < second_min || byte_at(1) > second_max) {
+		return begin;
+	}
+	for (ptrdiff_t i = 2; i < length; ++i) {
+		if ((byte_at(i) & 0xC0) != 0x80) {
+			return begin;
+		}
+	}
+	return begin + length;
+}
+
+ScanIsa selected_isa = DetectScanIsa();
+const ScanKernels *selected_kernels = GetScanKernels(selected_isa);
+
+}  // namespace
+
+const ScanKernels* GetScanKernels(ScanIsa isa) {
+	switch (isa) {
+	case ScanIsa::SCALAR:
+		return &SCALAR_KERNELS;
+#ifdef MYTHON_SCAN_X86
+	case ScanIsa::SSE2:
+		return &SSE2_KERNELS;
+	case ScanIsa::AVX2:
+		return __builtin_cpu_supports("avx2") ? &AVX2_KERNELS : nullptr;
+#endif
+	default:
+		return nullptr;
+	}
+}
+
+bool SelectScanKernels(ScanIsa isa) {
+	const ScanKernels *kernels = GetScanKernels(isa);
+	if (kernels == nullptr) {
+		return false;
+	}
+	selected_isa = isa;
+	selected_kernels = kernels;
+	return true;
+}
+
+ScanIsa GetSelectedScanIsa() {
+	return selected_isa;
+}
+
+const char* FindIdEnd(const char *begin, const char *end) {
+	return selected_kernels->find_id_end(begin, end);
+}
+
+const char* SkipSpaces(const char *begin, const char *end) {
+	return selected_kernels->skip_spaces(begin, end);
+}
+
+const char* FindNewline(const char *begin, const char *end) {
+	return selected_kernels->find_newline(begin, end);
+}
+
+const char* FindStringStop(const char *begin, const char *end, char quote) {
+	return selected_kernels->find_string_stop(begin, end, quote);
+}
+
+const char* FindNonAscii(const char *begin, const char *end) {
+	return selected_kernels->find_non_ascii(begin, end);
+}
+
+const char* FindNewlineOrNonAscii(const char *begin, const char *end) {
+	return selected_kernels->find_newline_or_non_ascii(begin, end);
+}
+
+const char* FindInvalidUtf8(const char *begin, const char *end) {
+	while ((begin = FindNonAscii(begin, end)) != end) {
+		// Non-ASCII symbols usually go in words, the whole word is decoded at once
+		do {
+			const char *next = SkipUtf8Sequence(begin, end);
+			if (next == begin) {
+				return begin;
+			}
+			begin = next;
+		} while (begin != end && static_cast<unsigned char>(*begin) >= 0x80);
+	}
+	return end;
+}
+
+}  // namespace parse
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+
+namespace parse {
+
+// Instruction sets of the scanning kernels
+enum class ScanIsa {
+    SCALAR,
+    SSE2,
+    AVX2,
+};
+
+// Kernels that scan runs of source symbols for the lexer.
+// Every kernel looks only at [begin, end) and returns end if the searched symbol is not found
+struct ScanKernels {
+    // Returns the first symbol that can not be a part of an ASCII id or a number
+    const char* (*find_id_end)(const char* begin, const char* end);
+    // Returns the first symbol that is not a space
+    const char* (*skip_spaces)(const char* begin, const char* end);
+    // Returns the first '\n'
+    const char* (*find_newline)(const char* begin, const char* end);
+    // Returns the first quote or backslash
+    const char* (*find_string_stop)(const char* begin, const char* end, char quote);
+    // Returns the first byte that is not ASCII
+    const char* (*find_non_ascii)(const char* begin, const char* end);
+    // Returns the first '\n' or byte that is not ASCII
+    const char* (*find_newline_or_non_ascii)(const char* begin, const char* end);
+};
+
+// Returns the kernels for isa or nullptr if the processor does not support it
+const ScanKernels* GetScanKernels(ScanIsa isa);
+
+// Makes the lexer use the kernels for isa. Returns false if the processor does not support it.
+// By default the widest instruction set available at runtime is used
+bool SelectScanKernels(ScanIsa isa);
+
+// Returns the instruction set of the kernels used by the lexer
+ScanIsa GetSelectedScanIsa();
+
+const char* FindIdEnd(const char* begin, const char* end);
+const char* SkipSpaces(const char* begin, const char* end);
+const char* FindNewline(const char* begin, const char* end);
+const char* FindStringStop(const char* begin, const char* end, char quote);
+const char* FindNonAscii(const char* begin, const char* end);
+const char* FindNewlineOrNonAscii(const char* begin, const char* end);
+
+// Returns the first byte of the first invalid UTF-8 sequence in [begin, end) or end.
+// Overlong encodings, surrogates and code points above U+10FFFF are invalid.
+// Runs of ASCII symbols are skipped by find_non_ascii, only other symbols are decoded
+const char* FindInvalidUtf8(const char* begin, const char* end);
+
+}  // namespace parse
@@ -1,6 +1,10 @@
 #include "statement.h"
 
+#include <functional>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <optional>
 #include <sstream>
 
 using namespace std;
@@ -10,67 +14,145 @@ namespace ast {
 using runtime::Closure;
 using runtime::Context;
 using runtime::ObjectHolder;
+using runtime::ObjectType;
 
 namespace {
-const string ADD_METHOD = "__add__"s;
-const string INIT_METHOD = "__init__"s;
+const runtime::Symbol ADD_METHOD = "__add__"sv;
+const runtime::Symbol INIT_METHOD = "__init__"sv;
+
+// Сравнивает два числа или две строки, не вызывая функций runtime. Для значений других типов
+// возвращает nullopt
+template <typename Compare>
+optional<bool> CompareValues(const ObjectHolder &lhs, const ObjectHolder &rhs, Compare compare) {
+	switch (runtime::TypePair(lhs, rhs)) {
+	case runtime::TypePair(ObjectType::Number, ObjectType::Number):
+		return compare(runtime::ValueOf<runtime::Number>(lhs),
+				runtime::ValueOf<runtime::Number>(rhs));
+	case runtime::TypePair(ObjectType::String, ObjectType::String):
+		return compare(runtime::ValueOf<runtime::String>(lhs),
+				runtime::ValueOf<runtime::String>(rhs));
+	default:
+		return nullopt;
+	}
+}
+
+// Истинно, если оба аргумента - числа
+bool AreNumbers(const ObjectHolder &lhs, const ObjectHolder &rhs) {
+	return runtime::TypePair(lhs, rhs) == runtime::TypePair(ObjectType::Number, ObjectType::Number);
+}
+
+bool IsInteger(ObjectType type) {
+	return type == ObjectType::Number || type == ObjectType::BigNumber;
+}
+
+// Истинно, если оба аргумента - целые числа любой длины
+bool AreIntegers(const ObjectHolder &lhs, const ObjectHolder &rhs) {
+	return IsInteger(lhs.GetType()) && IsInteger(rhs.GetType());
+}
+
+runtime::BigInt ToBigInt(const ObjectHolder &value) {
+	if (value.GetType() == ObjectType::Number) {
+		return runtime::BigInt(runtime::ValueOf<runtime::Number>(value));
+	}
+	return runtime::ValueOf<runtime::BigNumber>(value);
+}
+
+// Возвращает Number, если значение помещается в int64_t, иначе BigNumber
+ObjectHolder MakeInteger(runtime::BigInt value) {
+	if (const optional<int64_t> small = value.ToInt64()) {
+		return ObjectHolder::Own(runtime::Number(*small));
+	}
+	return ObjectHolder::Own(runtime::BigNumber(move(value)));
+}
+
+// Вычисляет операцию над длинными числами. Вызывается, когда один из аргументов - BigNumber
+// либо результат операции над Number переполняет int64_t
+template <typename Operation>
+ObjectHolder ApplyToBigInts(const ObjectHolder &lhs, const ObjectHolder &rhs,
+		Operation operation) {
+	return MakeInteger(operation(ToBigInt(lhs), ToBigInt(rhs)));
+}
 }  // namespace
 
 ObjectHolder Assignment::Execute(Closure &closure, Context &context) {
-	closure[var_] = move(rv_->Execute(closure, context));
-	return closure[var_];
+	if (slot_ != NO_SLOT) {
+		return *(closure.slots[slot_] = rv_->Execute(closure, context));
+	}
+	return closure[var_] = rv_->Execute(closure, context);
 }
 
-Assignment::Assignment(std::string var, std::unique_ptr<Statement> rv) :
-		var_(var), rv_(move(rv)) {
+Assignment::Assignment(runtime::Symbol var, StatementPtr rv, uint32_t slot) :
+		var_(var), rv_(move(rv)), slot_(slot) {
 }
 
-VariableValue::VariableValue(const std::string &var_name) {
+VariableValue::VariableValue(runtime::Symbol var_name) {
 	dotted_ids_.push_back(var_name);
 }
 
-VariableValue::VariableValue(std::vector<std::string> dotted_ids) :
-		dotted_ids_(dotted_ids) {
+VariableValue::VariableValue(std::vector<runtime::Symbol> dotted_ids) :
+		dotted_ids_(move(dotted_ids)) {
+}
+
+VariableValue::VariableValue(const std::vector<std::string> &dotted_ids) :
+		dotted_ids_(dotted_ids.begin(), dotted_ids.end()) {
+}
+
+VariableValue::VariableValue(std::vector<runtime::Symbol> dotted_ids, uint32_t slot) :
+		dotted_ids_(move(dotted_ids)), slot_(slot) {
 }
 
 ObjectHolder VariableValue::Execute(Closure &closure, Context&) {
-	Closure temp_closure = closure;
+	const Closure *scope = &closure;
 	ObjectHolder result;
-	for (const auto &id : dotted_ids_) {
-		if (temp_closure.count(id)) {
-			result = temp_closure.at(id);
+	for (size_t i = 0; i < dotted_ids_.size(); ++i) {
+		if (i == 0 && slot_ != NO_SLOT) {
+			const optional<ObjectHolder> &value = closure.slots[slot_];
+			if (!value) {
+				throw std::runtime_error("Not implemented"s);
+			}
+			result = *value;
+		} else if (auto it = scope->find(dotted_ids_[i]); it != scope->end()) {
+			result = it->second;
 		} else {
 			throw std::runtime_error("Not implemented"s);
 		}
-		if (result.TryAs<runtime::ClassInstance>() != nullptr) {
-			temp_closure = result.TryAs<runtime::ClassInstance>()->Fields();
+		if (const auto *instance = result.TryAs<runtime::ClassInstance>()) {
+			scope = &instance->Fields();
 		}
 	}
 	return result;
 }
 
-unique_ptr<Print> Print::Variable(const std::string &name) {
+unique_ptr<Print> Print::Variable(runtime::Symbol name) {
 	auto var = make_unique<VariableValue>(VariableValue(name));
 	auto print = make_unique<Print>(move(var));
 	return print;
 }
 
-Print::Print(unique_ptr<Statement> argument) {
+Print::Print(StatementPtr argument) {
 	args_.push_back(move(argument));
 }
 
-Print::Print(vector<unique_ptr<Statement>> args) :
+Print::Print(vector<StatementPtr> args) :
 		args_(move(args)) {
 }
-void Print::ExecutePrint(size_t pos, runtime::Closure &closure,
-		runtime::Context &context) {
-	auto executed_arg = args_[pos]->Execute(closure, context);
-	if (executed_arg) {
-		executed_arg.Get()->Print(context.GetOutputStream(), context);
+
+Print::Print(vector<unique_ptr<Statement>> args) :
+		args_(make_move_iterator(args.begin()), make_move_iterator(args.end())) {
+}
+
+void Print::PrintValue(const ObjectHolder &value, Context &context) {
+	if (value) {
+		value.Get()->Print(context.GetOutputStream(), context);
 	} else {
 		context.GetOutputStream() << "None"s;
 	}
 }
+
+void Print::ExecutePrint(size_t pos, runtime::Closure &closure,
+		runtime::Context &context) {
+	PrintValue(args_[pos]->Execute(closure, context), context);
+}
 ObjectHolder Print::Execute(Closure &closure, Context &context) {
 	if (!args_.empty()) {
 		size_t i = 0;
@@ -84,8 +166,8 @@ ObjectHolder Print::Execute(Closure &closure, Context &context) {
 	return ObjectHolder();
 }
 
-MethodCall::MethodCall(std::unique_ptr<Statement> object, std::string method,
-		std::vector<std::unique_ptr<Statement>> args) :
+MethodCall::MethodCall(StatementPtr object, runtime::Symbol method,
+		std::vector<StatementPtr> args) :
 		object_(move(object)), method_(method), args_(move(args)) {
 }
 
@@ -95,85 +177,137 @@ ObjectHolder MethodCall::Execute(Closure &closure, Context &context) {
 		args_converted.push_back(
 				move(args_[i].get()->Execute(closure, context)));
 	}
+	if (bound_method_ != nullptr && !bound_method_->build) {
+		return object_.get()->Execute(closure, context).TryAs<runtime::ClassInstance>()->Call(
+				*bound_method_, args_converted, context);
+	}
 	return object_.get()->Execute(closure, context).TryAs<runtime::ClassInstance>()->Call(
 			method_, args_converted, context);
 }
 
 ObjectHolder Stringify::Execute(Closure &closure, Context &context) {
+	return Apply(argument_->Execute(closure, context), context);
+}
+
+ObjectHolder Stringify::Apply(const ObjectHolder &value, Context &context) {
 	ostringstream string_stream;
-	if (argument_.get()->Execute(closure, context)) {
-		argument_.get()->Execute(closure, context)->Print(string_stream,
-				context);
+	if (value) {
+		value->Print(string_stream, context);
 	} else {
 		string_stream << "None"s;
 	}
-	string str = string_stream.str();
-	return ObjectHolder::Own(runtime::String(str));
+	return ObjectHolder::Own(runtime::String(string_stream.str()));
+}
+
+ObjectHolder Negate::Execute(Closure &closure, Context &context) {
+	return Apply(argument_->Execute(closure, context), context);
+}
+
+ObjectHolder Negate::Apply(const ObjectHolder &value, Context&) {
+	switch (value.GetType()) {
+	case ObjectType::Number: {
+		int64_t result = 0;
+		if (!__builtin_sub_overflow(int64_t(0), runtime::ValueOf<runtime::Number>(value),
+				&result)) {
+			return ObjectHolder::Own(runtime::Number(result));
+		}
+		return MakeInteger(-ToBigInt(value));
+	}
+	case ObjectType::BigNumber:
+		return MakeInteger(-runtime::ValueOf<runtime::BigNumber>(value));
+	default:
+		break;
+	}
+	throw std::runtime_error("Cannot compare objects for equality"s);
 }
 
 ObjectHolder Add::Execute(Closure &closure, Context &context) {
-	const auto &lhs = lhs_.get()->Execute(closure, context);
-	const auto &rhs = rhs_.get()->Execute(closure, context);
-
-	if (lhs.TryAs<runtime::String>() != nullptr
-			&& rhs.TryAs<runtime::String>() != nullptr) {
-		const auto &lhs_val = lhs.TryAs<runtime::String>()->GetValue();
-		const auto &rhs_val = rhs.TryAs<runtime::String>()->GetValue();
-		return ObjectHolder::Own(runtime::String(lhs_val + rhs_val));
-	}
-	if (lhs.TryAs<runtime::Number>() != nullptr
-			&& rhs.TryAs<runtime::Number>() != nullptr) {
-		const auto &lhs_val = lhs.TryAs<runtime::Number>()->GetValue();
-		const auto &rhs_val = rhs.TryAs<runtime::Number>()->GetValue();
-		return ObjectHolder::Own(runtime::Number(lhs_val + rhs_val));
-	}
-	if (lhs.TryAs<runtime::ClassInstance>() != nullptr) {
-		const auto &lhs_cl = lhs.TryAs<runtime::ClassInstance>();
-		if (lhs_cl->HasMethod("__add__"s, 1)) {
-			Closure args_table_;
-			string argument_name = "rhs"s;
-			args_table_[argument_name] = ObjectHolder::Share(*rhs);
-			return lhs_cl->Call("__add__"s, { rhs }, context);
+	const auto &lhs = lhs_->Execute(closure, context);
+	return Apply(lhs, rhs_->Execute(closure, context), context);
+}
+
+ObjectHolder Add::Apply(const ObjectHolder &lhs, const ObjectHolder &rhs, Context &context) {
+	switch (runtime::TypePair(lhs, rhs)) {
+	case runtime::TypePair(ObjectType::String, ObjectType::String):
+		return ObjectHolder::Own(runtime::String(runtime::ValueOf<runtime::String>(lhs)
+				+ runtime::ValueOf<runtime::String>(rhs)));
+	case runtime::TypePair(ObjectType::Number, ObjectType::Number): {
+		int64_t result = 0;
+		if (!__builtin_add_overflow(runtime::ValueOf<runtime::Number>(lhs),
+				runtime::ValueOf<runtime::Number>(rhs), &result)) {
+			return ObjectHolder::Own(runtime::Number(result));
+		}
+		break;
+	}
+	default:
+		break;
+	}
+	if (AreIntegers(lhs, rhs)) {
+		return ApplyToBigInts(lhs, rhs, plus<>());
+	}
+	if (auto *instance = lhs.TryAs<runtime::ClassInstance>()) {
+		if (instance->HasMethod(ADD_METHOD, 1)) {
+			return instance->Call(ADD_METHOD, { rhs }, context);
 		}
 	}
 	throw std::runtime_error("Cannot compare objects for equality"s);
 }
 
 ObjectHolder Sub::Execute(Closure &closure, Context &context) {
-	const auto &lhs = lhs_.get()->Execute(closure, context);
-	const auto &rhs = rhs_.get()->Execute(closure, context);
-	if (lhs.TryAs<runtime::Number>() != nullptr
-			&& rhs.TryAs<runtime::Number>() != nullptr) {
-		const auto &lhs_val = lhs.TryAs<runtime::Number>()->GetValue();
-		const auto &rhs_val = rhs.TryAs<runtime::Number>()->GetValue();
-		return ObjectHolder::Own(runtime::Number(lhs_val - rhs_val));
+	const auto &lhs = lhs_->Execute(closure, context);
+	return Apply(lhs, rhs_->Execute(closure, context), context);
+}
+
+ObjectHolder Sub::Apply(const ObjectHolder &lhs, const ObjectHolder &rhs, Context&) {
+	if (AreNumbers(lhs, rhs)) {
+		int64_t result = 0;
+		if (!__builtin_sub_overflow(runtime::ValueOf<runtime::Number>(lhs),
+				runtime::ValueOf<runtime::Number>(rhs), &result)) {
+			return ObjectHolder::Own(runtime::Number(result));
+		}
+	}
+	if (AreIntegers(lhs, rhs)) {
+		return ApplyToBigInts(lhs, rhs, minus<>());
 	}
 	throw std::runtime_error("Cannot compare objects for equality"s);
 }
 
 ObjectHolder Mult::Execute(Closure &closure, Context &context) {
-	const auto &lhs = lhs_.get()->Execute(closure, context);
-	const auto &rhs = rhs_.get()->Execute(closure, context);
-	if (lhs.TryAs<runtime::Number>() != nullptr
-			&& rhs.TryAs<runtime::Number>() != nullptr) {
-		const auto &lhs_val = lhs.TryAs<runtime::Number>()->GetValue();
-		const auto &rhs_val = rhs.TryAs<runtime::Number>()->GetValue();
-		return ObjectHolder::Own(runtime::Number(lhs_val * rhs_val));
+	const auto &lhs = lhs_->Execute(closure, context);
+	return Apply(lhs, rhs_->Execute(closure, context), context);
+}
+
+ObjectHolder Mult::Apply(const ObjectHolder &lhs, const ObjectHolder &rhs, Context&) {
+	if (AreNumbers(lhs, rhs)) {
+		int64_t result = 0;
+		if (!__builtin_mul_overflow(runtime::ValueOf<runtime::Number>(lhs),
+				runtime::ValueOf<runtime::Number>(rhs), &result)) {
+			return ObjectHolder::Own(runtime::Number(result));
+		}
+	}
+	if (AreIntegers(lhs, rhs)) {
+		return ApplyToBigInts(lhs, rhs, multiplies<>());
 	}
 	throw std::runtime_error("Cannot compare objects for equality"s);
 }
 
 ObjectHolder Div::Execute(Closure &closure, Context &context) {
-	const auto &lhs = lhs_.get()->Execute(closure, context);
-	const auto &rhs = rhs_.get()->Execute(closure, context);
-	if (lhs.TryAs<runtime::Number>() != nullptr
-			&& rhs.TryAs<runtime::Number>() != nullptr) {
-		const auto &lhs_val = lhs.TryAs<runtime::Number>()->GetValue();
-		const auto &rhs_val = rhs.TryAs<runtime::Number>()->GetValue();
-		if (rhs_val != 0) {
-			return ObjectHolder::Own(runtime::Number(lhs_val / rhs_val));
+	const auto &lhs = lhs_->Execute(closure, context);
+	return Apply(lhs, rhs_->Execute(closure, context), context);
+}
+
+ObjectHolder Div::Apply(const ObjectHolder &lhs, const ObjectHolder &rhs, Context&) {
+	if (AreNumbers(lhs, rhs)) {
+		const int64_t dividend = runtime::ValueOf<runtime::Number>(lhs);
+		const int64_t divisor = runtime::ValueOf<runtime::Number>(rhs);
+		// Частное INT64_MIN / -1 - единственное, которое не помещается в int64_t
+		if (divisor != 0 && (divisor != -1 || dividend != numeric_limits<int64_t>::min())) {
+			return ObjectHolder::Own(runtime::Number(dividend / divisor));
 		}
 	}
+	if (AreIntegers(lhs, rhs) && runtime::IsTrue(rhs)) {
+		return ApplyToBigInts(lhs, rhs, divides<>());
+	}
 	throw std::runtime_error("Cannot compare objects for equality"s);
 }
 
@@ -185,7 +319,7 @@ ObjectHolder Compound::Execute(Closure &closure, Context &context) {
 }
 
 ObjectHolder Return::Execute(Closure& /*closure*/, Context& /*context*/) {
-	throw ReturnException(statement_);
+	throw ReturnException(statement_.get());
 	return ObjectHolder();
 }
 
@@ -199,8 +333,8 @@ ObjectHolder ClassDefinition::Execute(Closure &closure, Context&) {
 	return ObjectHolder();
 }
 
-FieldAssignment::FieldAssignment(VariableValue object, std::string field_name,
-		std::unique_ptr<Statement> rv) :
+FieldAssignment::FieldAssignment(VariableValue object, runtime::Symbol field_name,
+		StatementPtr rv) :
 		object_(object), field_name_(field_name), rv_(move(rv)) {
 }
 
@@ -212,15 +346,13 @@ ObjectHolder FieldAssignment::Execute(Closure &closure, Context &context) {
 	return result;
 }
 
-IfElse::IfElse(std::unique_ptr<Statement> condition,
-		std::unique_ptr<Statement> if_body,
-		std::unique_ptr<Statement> else_body) :
+IfElse::IfElse(StatementPtr condition, StatementPtr if_body, StatementPtr else_body) :
 		condition_(move(condition)), if_body_(move(if_body)), else_body_(
 				move(else_body)) {
 }
 
 ObjectHolder IfElse::Execute(Closure &closure, Context &context) {
-	if (condition_.get()->Execute(closure, context).TryAs<runtime::Bool>()->GetValue()) {
+	if (condition_->EvaluateCondition(closure, context)) {
 		if (if_body_.get() != nullptr) {
 			return if_body_->Execute(closure, context);
 		}
@@ -233,57 +365,135 @@ ObjectHolder IfElse::Execute(Closure &closure, Context &context) {
 }
 
 ObjectHolder Or::Execute(Closure &closure, Context &context) {
-	const auto &lhs = lhs_.get()->Execute(closure, context);
-	runtime::Bool true_obj(true);
-	if (runtime::Equal(lhs, ObjectHolder::Share(true_obj), context)) {
-		return ObjectHolder::Own(runtime::Bool(true));
+	return ObjectHolder::Own(runtime::Bool(EvaluateCondition(closure, context)));
+}
+
+bool Or::EvaluateCondition(Closure &closure, Context &context) {
+	return lhs_->EvaluateCondition(closure, context) || rhs_->EvaluateCondition(closure, context);
+}
+
+ObjectHolder And::Execute(Closure &closure, Context &context) {
+	return ObjectHolder::Own(runtime::Bool(EvaluateCondition(closure, context)));
+}
+
+bool And::EvaluateCondition(Closure &closure, Context &context) {
+	return lhs_->EvaluateCondition(closure, context) && rhs_->EvaluateCondition(closure, context);
+}
+
+ObjectHolder Not::Execute(Closure &closure, Context &context) {
+	return ObjectHolder::Own(runtime::Bool(EvaluateCondition(closure, context)));
+}
+
+bool Not::EvaluateCondition(Closure &closure, Context &context) {
+	return !argument_->EvaluateCondition(closure, context);
+}
+
+ObjectHolder Comparison::MakeBool(bool value) {
+	// Объекты Bool не изменяются, поэтому результаты сравнений не создаются заново
+	static runtime::Bool true_value(true);
+	static runtime::Bool false_value(false);
+	return ObjectHolder::Share(value ? true_value : false_value);
+}
+
+bool Equal::Apply(const ObjectHolder &lhs, const ObjectHolder &rhs, Context &context) {
+	if (const optional<bool> result = CompareValues(lhs, rhs, equal_to<>())) {
+		return *result;
 	}
-	const auto &rhs = rhs_.get()->Execute(closure, context);
-	if (runtime::Equal(rhs, ObjectHolder::Share(true_obj), context)) {
-		return ObjectHolder::Own(runtime::Bool(true));
+	return runtime::Equal(lhs, rhs, context);
+}
+
+ObjectHolder Equal::Execute(Closure &closure, Context &context) {
+	return MakeBool(EvaluateCondition(closure, context));
+}
+
+bool Equal::EvaluateCondition(Closure &closure, Context &context) {
+	const ObjectHolder lhs = lhs_->Execute(closure, context);
+	return Apply(lhs, rhs_->Execute(closure, context), context);
+}
+
+bool NotEqual::Apply(const ObjectHolder &lhs, const ObjectHolder &rhs, Context &context) {
+	if (const optional<bool> result = CompareValues(lhs, rhs, not_equal_to<>())) {
+		return *result;
 	}
-	return ObjectHolder::Own(runtime::Bool(false));
+	return runtime::NotEqual(lhs, rhs, context);
 }
 
-ObjectHolder And::Execute(Closure &closure, Context &context) {
-	const auto &lhs = lhs_.get()->Execute(closure, context);
-	runtime::Bool true_obj(true);
-	if (!runtime::Equal(lhs, ObjectHolder::Share(true_obj), context)) {
-		return ObjectHolder::Own(runtime::Bool(false));
+ObjectHolder NotEqual::Execute(Closure &closure, Context &context) {
+	return MakeBool(EvaluateCondition(closure, context));
+}
+
+bool NotEqual::EvaluateCondition(Closure &closure, Context &context) {
+	const ObjectHolder lhs = lhs_->Execute(closure, context);
+	return Apply(lhs, rhs_->Execute(closure, context), context);
+}
+
+bool Less::Apply(const ObjectHolder &lhs, const ObjectHolder &rhs, Context &context) {
+	if (const optional<bool> result = CompareValues(lhs, rhs, less<>())) {
+		return *result;
 	}
-	const auto &rhs = rhs_.get()->Execute(closure, context);
-	if (!runtime::Equal(rhs, ObjectHolder::Share(true_obj), context)) {
-		return ObjectHolder::Own(runtime::Bool(false));
+	return runtime::Less(lhs, rhs, context);
+}
+
+ObjectHolder Less::Execute(Closure &closure, Context &context) {
+	return MakeBool(EvaluateCondition(closure, context));
+}
+
+bool Less::EvaluateCondition(Closure &closure, Context &context) {
+	const ObjectHolder lhs = lhs_->Execute(closure, context);
+	return Apply(lhs, rhs_->Execute(closure, context), context);
+}
+
+bool Greater::Apply(const ObjectHolder &lhs, const ObjectHolder &rhs, Context &context) {
+	if (const optional<bool> result = CompareValues(lhs, rhs, greater<>())) {
+		return *result;
 	}
-	return ObjectHolder::Own(runtime::Bool(true));
+	return runtime::Greater(lhs, rhs, context);
 }
 
-ObjectHolder Not::Execute(Closure &closure, Context &context) {
-	const auto &argument = argument_.get()->Execute(closure, context);
-	runtime::Bool true_obj(true);
-	if (runtime::Equal(argument, ObjectHolder::Share(true_obj), context)) {
-		return ObjectHolder::Own(runtime::Bool(false));
+ObjectHolder Greater::Execute(Closure &closure, Context &context) {
+	return MakeBool(EvaluateCondition(closure, context));
+}
+
+bool Greater::EvaluateCondition(Closure &closure, Context &context) {
+	const ObjectHolder lhs = lhs_->Execute(closure, context);
+	return Apply(lhs, rhs_->Execute(closure, context), context);
+}
+
+bool LessOrEqual::Apply(const ObjectHolder &lhs, const ObjectHolder &rhs, Context &context) {
+	if (const optional<bool> result = CompareValues(lhs, rhs, less_equal<>())) {
+		return *result;
 	}
-	return ObjectHolder::Own(runtime::Bool(true));
+	return runtime::LessOrEqual(lhs, rhs, context);
 }
 
-Comparison::Comparison(Comparator cmp, unique_ptr<Statement> lhs,
-		unique_ptr<Statement> rhs) :
-		BinaryOperation(std::move(lhs), std::move(rhs)), comparator_(move(cmp)) {
+ObjectHolder LessOrEqual::Execute(Closure &closure, Context &context) {
+	return MakeBool(EvaluateCondition(closure, context));
 }
 
-ObjectHolder Comparison::Execute(Closure &closure, Context &context) {
-	if (comparator_(lhs_.get()->Execute(closure, context),
-			rhs_.get()->Execute(closure, context), context)) {
-		return ObjectHolder::Own(runtime::Bool(true));
-	} else {
-		return ObjectHolder::Own(runtime::Bool(false));
+bool LessOrEqual::EvaluateCondition(Closure &closure, Context &context) {
+	const ObjectHolder lhs = lhs_->Execute(closure, context);
+	return Apply(lhs, rhs_->Execute(closure, context), context);
+}
+
+bool GreaterOrEqual::Apply(const ObjectHolder &lhs, const ObjectHolder &rhs,
+		Context &context) {
+	if (const optional<bool> result = CompareValues(lhs, rhs, greater_equal<>())) {
+		return *result;
 	}
-	return {};
+	return runtime::GreaterOrEqual(lhs, rhs, context);
+}
+
+ObjectHolder GreaterOrEqual::Execute(Closure &closure, Context &context) {
+	return MakeBool(EvaluateCondition(closure, context));
+}
+
+bool GreaterOrEqual::EvaluateCondition(Closure &closure, Context &context) {
+	const ObjectHolder lhs = lhs_->Execute(closure, context);
+	return Apply(lhs, rhs_->Execute(closure, context), context);
 }
 
 NewInstance::NewInstance(const runtime::Class &class_,
-		std::vector<std::unique_ptr<Statement>> args) :
+		std::vector<StatementPtr> args) :
 		new_class_(class_), args_(move(args)) {
 }
 
@@ -292,18 +502,18 @@ NewInstance::NewInstance(const runtime::Class &class_) :/*clas_ptr(std::make_sha
 }
 
 ObjectHolder NewInstance::Execute(Closure &closure, Context &context) {
-	if (new_class_.HasMethod("__init__"s, args_.size())) {
+	if (new_class_.HasMethod(INIT_METHOD, args_.size())) {
 		vector<ObjectHolder> param_vect;
 		for (const auto &param : args_) {
 			param_vect.push_back(param.get()->Execute(closure, context));
 		}
-		new_class_.Call("__init__"s, param_vect, context);
+		new_class_.Call(INIT_METHOD, param_vect, context);
 		return ObjectHolder::Share(new_class_);
 	}
 	return ObjectHolder::Share(new_class_);
 }
 
-MethodBody::MethodBody(std::unique_ptr<Statement> &&body) :
+MethodBody::MethodBody(StatementPtr &&body) :
 		body_(move(body)) {
 }
 
@@ -1,28 +1,37 @@
 #pragma once
 
+#include "arena.h"
 #include "runtime.h"
 
-#include <functional>
+#include <cstdint>
 #include <optional>
 
 namespace ast {
 
 using Statement = runtime::Executable;
 
+// Переводит дерево программы в плоское представление (см. flat_ast.h), поэтому имеет доступ
+// к потомкам узлов
+class Flattener;
+// Упрощает дерево программы (см. optimizer.h), заменяя потомков узлов
+class Optimizer;
+// Указатель на дочерний узел. Узлы, созданные парсером, живут в арене программы и не удаляются
+// по одному, а узлы из std::unique_ptr удаляются вместе с родителем
+using StatementPtr = runtime::ExecutablePtr;
+
 class ReturnException : public std::domain_error {
 public:
-    ReturnException(std::shared_ptr<Statement> statement)
-        : std::domain_error("return") {
-        if (statement_.get() == nullptr) {
-            statement_ = statement;
-        }
-    };
+    explicit ReturnException(Statement* statement)
+        : std::domain_error("return"), statement_(statement) {
+    }
 
-    std::shared_ptr<Statement> GetReturn() {
+    // Выражение инструкции return. Оно живёт дольше исключения, пока существует сама инструкция.
+    // Плоская программа (см. flat_ast.h) выбрасывает исключение без выражения
+    Statement* GetReturn() const {
         return statement_;
     }
 private:
-    std::shared_ptr<Statement> statement_;
+    Statement* statement_;
 };
 
 // Выражение, возвращающее значение типа T,
@@ -40,6 +49,8 @@ public:
     }
 
 private:
+    friend class Flattener;
+
     T value_;
 };
 
@@ -47,6 +58,9 @@ using NumericConst = ValueStatement<runtime::Number>;
 using StringConst = ValueStatement<runtime::String>;
 using BoolConst = ValueStatement<runtime::Bool>;
 
+// Номер слота кадра (runtime::Closure::slots) у переменной, которая хранится в Closure по имени
+inline constexpr uint32_t NO_SLOT = UINT32_MAX;
+
 /*
 Вычисляет значение переменной либо цепочки вызовов полей объектов id1.id2.id3.
 Например, выражение circle.center.x - цепочка вызовов полей объектов в инструкции:
@@ -54,36 +68,51 @@ x = circle.center.x
 */
 class VariableValue : public Statement {
 public:
-    explicit VariableValue(const std::string& var_name);
-    explicit VariableValue(std::vector<std::string> dotted_ids);
+    explicit VariableValue(runtime::Symbol var_name);
+    explicit VariableValue(std::vector<runtime::Symbol> dotted_ids);
+    explicit VariableValue(const std::vector<std::string>& dotted_ids);
+    // Переменная id1 хранится в слоте slot кадра метода
+    VariableValue(std::vector<runtime::Symbol> dotted_ids, uint32_t slot);
 
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 private:
-    std::vector<std::string> dotted_ids_;
+    friend class Flattener;
+    friend class Optimizer;
+
+    std::vector<runtime::Symbol> dotted_ids_;
+    uint32_t slot_ = NO_SLOT;
 };
 
 // Присваивает переменной, имя которой задано в параметре var, значение выражения rv
 class Assignment : public Statement {
 public:
-    Assignment(std::string var, std::unique_ptr<Statement> rv);
+    // Если задан slot, переменная хранится в слоте кадра метода, а не в Closure по имени
+    Assignment(runtime::Symbol var, StatementPtr rv, uint32_t slot = NO_SLOT);
 
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 
 private:
-    std::string var_;
-    std::unique_ptr<Statement> rv_;
+    friend class Flattener;
+    friend class Optimizer;
+
+    runtime::Symbol var_;
+    StatementPtr rv_;
+    uint32_t slot_;
 };
 
 // Присваивает полю object.field_name значение выражения rv
 class FieldAssignment : public Statement {
 public:
-    FieldAssignment(VariableValue object, std::string field_name, std::unique_ptr<Statement> rv);
+    FieldAssignment(VariableValue object, runtime::Symbol field_name, StatementPtr rv);
 
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 private:
+    friend class Flattener;
+    friend class Optimizer;
+
     VariableValue object_;
-    std::string field_name_;
-    std::unique_ptr<Statement> rv_;
+    runtime::Symbol field_name_;
+    StatementPtr rv_;
 };
 
 // Значение None
@@ -99,32 +128,44 @@ public:
 class Print : public Statement {
 public:
     // Инициализирует команду print для вывода значения выражения argument
-    explicit Print(std::unique_ptr<Statement> argument);
+    explicit Print(StatementPtr argument);
     // Инициализирует команду print для вывода списка значений args
+    explicit Print(std::vector<StatementPtr> args);
     explicit Print(std::vector<std::unique_ptr<Statement>> args);
 
     // Инициализирует команду print для вывода значения переменной name
-    static std::unique_ptr<Print> Variable(const std::string& name);
+    static std::unique_ptr<Print> Variable(runtime::Symbol name);
 
     // Во время выполнения команды print вывод должен осуществляться в поток, возвращаемый из
     // context.GetOutputStream()
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+    // Выводит одно значение так же, как его выводит команда print
+    static void PrintValue(const runtime::ObjectHolder& value, runtime::Context& context);
 private:
-     std::vector<std::unique_ptr<Statement>> args_;
+     friend class Flattener;
+     friend class Optimizer;
+
+     std::vector<StatementPtr> args_;
      void ExecutePrint(size_t pos, runtime::Closure& closure, runtime::Context& context);
 };
 
 // Вызывает метод object.method со списком параметров args
 class MethodCall : public Statement {
 public:
-    MethodCall(std::unique_ptr<Statement> object, std::string method,
-               std::vector<std::unique_ptr<Statement>> args);
+    MethodCall(StatementPtr object, runtime::Symbol method, std::vector<StatementPtr> args);
 
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 private:
-    std::unique_ptr<Statement> object_;
-    std::string method_;
-    std::vector<std::unique_ptr<Statement>> args_;
+    friend class Flattener;
+    friend class Optimizer;
+
+    StatementPtr object_;
+    runtime::Symbol method_;
+    std::vector<StatementPtr> args_;
+    // Метод, который вызывается всегда, независимо от класса объекта (см. Optimize). Пока его
+    // тело не построено, метод ищется по имени
+    const runtime::Method* bound_method_ = nullptr;
 };
 
 /*
@@ -143,22 +184,28 @@ p.set_name("Ivan")
 class NewInstance : public Statement {
 public:
     explicit NewInstance(const runtime::Class& class_);
-    NewInstance(const runtime::Class& class_, std::vector<std::unique_ptr<Statement>> args);
+    NewInstance(const runtime::Class& class_, std::vector<StatementPtr> args);
     // Возвращает объект, содержащий значение типа ClassInstance
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 private:
+    friend class Flattener;
+    friend class Optimizer;
+
     std::shared_ptr <runtime::Class> clas_ptr;
     runtime::ClassInstance new_class_;
-    std::vector<std::unique_ptr<Statement>> args_;
+    std::vector<StatementPtr> args_;
 };
 
 // Базовый класс для унарных операций
 class UnaryOperation : public Statement {
 public:
-    explicit UnaryOperation(std::unique_ptr<Statement> argument):argument_(move(argument)) {
+    explicit UnaryOperation(StatementPtr argument):argument_(move(argument)) {
     }
 protected:
-    std::unique_ptr<Statement> argument_;
+    friend class Flattener;
+    friend class Optimizer;
+
+    StatementPtr argument_;
 };
 
 // Операция str, возвращающая строковое значение своего аргумента
@@ -166,19 +213,40 @@ class Stringify : public UnaryOperation {
 public:
     using UnaryOperation::UnaryOperation;
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+    // Возвращает строковое значение уже вычисленного аргумента
+    static runtime::ObjectHolder Apply(const runtime::ObjectHolder& value,
+                                       runtime::Context& context);
+};
+
+// Унарный минус. Поддерживается только для чисел, для остальных значений выбрасывается
+// исключение runtime_error
+class Negate : public UnaryOperation {
+public:
+    using UnaryOperation::UnaryOperation;
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+    static runtime::ObjectHolder Apply(const runtime::ObjectHolder& value,
+                                       runtime::Context& context);
 };
 
 // Родительский класс Бинарная операция с аргументами lhs и rhs
 class BinaryOperation : public Statement {
 public:
-    BinaryOperation(std::unique_ptr<Statement> lhs, std::unique_ptr<Statement> rhs):
+    BinaryOperation(StatementPtr lhs, StatementPtr rhs):
         lhs_(move(lhs)), rhs_(move(rhs)) {
     }
 protected:
-    std::unique_ptr<Statement> lhs_;
-    std::unique_ptr<Statement> rhs_;
+    friend class Flattener;
+    friend class Optimizer;
+
+    StatementPtr lhs_;
+    StatementPtr rhs_;
 };
 
+// Арифметические операции над числами не переполняются: результат, который не помещается
+// в int64_t, становится длинным числом BigNumber (см. runtime.h)
+
 // Возвращает результат операции + над аргументами lhs и rhs
 class Add : public BinaryOperation {
 public:
@@ -190,6 +258,11 @@ public:
     //  объект1 + объект2, если у объект1 - пользовательский класс с методом _add__(rhs)
     // В противном случае при вычислении выбрасывается runtime_error
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+    // Складывает уже вычисленные значения аргументов
+    static runtime::ObjectHolder Apply(const runtime::ObjectHolder& lhs,
+                                       const runtime::ObjectHolder& rhs,
+                                       runtime::Context& context);
 };
 
 // Возвращает результат вычитания аргументов lhs и rhs
@@ -201,6 +274,10 @@ public:
     //  число - число
     // Если lhs и rhs - не числа, выбрасывается исключение runtime_error
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+    static runtime::ObjectHolder Apply(const runtime::ObjectHolder& lhs,
+                                       const runtime::ObjectHolder& rhs,
+                                       runtime::Context& context);
 };
 
 // Возвращает результат умножения аргументов lhs и rhs
@@ -212,6 +289,10 @@ public:
     //  число * число
     // Если lhs и rhs - не числа, выбрасывается исключение runtime_error
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+    static runtime::ObjectHolder Apply(const runtime::ObjectHolder& lhs,
+                                       const runtime::ObjectHolder& rhs,
+                                       runtime::Context& context);
 };
 
 // Возвращает результат деления lhs и rhs
@@ -224,6 +305,10 @@ public:
     // Если lhs и rhs - не числа, выбрасывается исключение runtime_error
     // Если rhs равен 0, выбрасывается исключение runtime_error
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+    static runtime::ObjectHolder Apply(const runtime::ObjectHolder& lhs,
+                                       const runtime::ObjectHolder& rhs,
+                                       runtime::Context& context);
 };
 
 // Возвращает результат вычисления логической операции or над lhs и rhs
@@ -231,8 +316,9 @@ class Or : public BinaryOperation {
 public:
     using BinaryOperation::BinaryOperation;
     // Значение аргумента rhs вычисляется, только если значение lhs
-    // после приведения к Bool равно False
+    // после приведения к Bool (см. runtime::IsTrue) равно False
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    bool EvaluateCondition(runtime::Closure& closure, runtime::Context& context) override;
 };
 
 // Возвращает результат вычисления логической операции and над lhs и rhs
@@ -240,8 +326,9 @@ class And : public BinaryOperation {
 public:
     using BinaryOperation::BinaryOperation;
     // Значение аргумента rhs вычисляется, только если значение lhs
-    // после приведения к Bool равно True
+    // после приведения к Bool (см. runtime::IsTrue) равно True
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    bool EvaluateCondition(runtime::Closure& closure, runtime::Context& context) override;
 };
 
 // Возвращает результат вычисления логической операции not над единственным аргументом операции
@@ -249,12 +336,13 @@ class Not : public UnaryOperation {
 public:
     using UnaryOperation::UnaryOperation;
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    bool EvaluateCondition(runtime::Closure& closure, runtime::Context& context) override;
 };
 
 // Составная инструкция (например: тело метода, содержимое ветки if, либо else)
 class Compound : public Statement {
 public:   
-    // Конструирует Compound из нескольких инструкций типа unique_ptr<Statement>
+    // Конструирует Compound из нескольких инструкций типа StatementPtr или unique_ptr<Statement>
     template <typename... Args>
     explicit Compound(Args&&... args) {
         if constexpr (sizeof...(args) != 0) {
@@ -263,14 +351,17 @@ public:
     }
 
     // Добавляет очередную инструкцию в конец составной инструкции
-    void AddStatement(std::unique_ptr<Statement> stmt) {
+    void AddStatement(StatementPtr stmt) {
         compound_.push_back(move(stmt));
     }
 
     // Последовательно выполняет добавленные инструкции. Возвращает None
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 private:
-    std::vector<std::unique_ptr<Statement>> compound_;
+    friend class Flattener;
+    friend class Optimizer;
+
+    std::vector<StatementPtr> compound_;
 
     template <typename T0,typename... Args>
     void PutArg(T0&& first_arg, Args&&... args) {
@@ -284,27 +375,33 @@ private:
 // Тело метода. Как правило, содержит составную инструкцию
 class MethodBody : public Statement {
 public:
-    explicit MethodBody(std::unique_ptr<Statement>&& body);
+    explicit MethodBody(StatementPtr&& body);
 
     // Вычисляет инструкцию, переданную в качестве body.
     // Если внутри body была выполнена инструкция return, возвращает результат return
     // В противном случае возвращает None
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 private:
-    std::unique_ptr<Statement> body_;
+    friend class Flattener;
+    friend class Optimizer;
+
+    StatementPtr body_;
 };
 
 // Выполняет инструкцию return с выражением statement
 class Return : public Statement {
 public:
-    explicit Return(std::unique_ptr<Statement> statement):statement_(move(statement)) {
+    explicit Return(StatementPtr statement):statement_(move(statement)) {
     }
 
     // Останавливает выполнение текущего метода. После выполнения инструкции return метод,
     // внутри которого она была исполнена, должен вернуть результат вычисления выражения statement.
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 private:
-    std::shared_ptr<Statement> statement_;
+    friend class Flattener;
+    friend class Optimizer;
+
+    StatementPtr statement_;
 };
 
 // Объявляет класс
@@ -316,39 +413,178 @@ public:
     // Создаёт внутри closure новый объект, совпадающий с именем класса и значением, переданным в
     // конструктор
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
-private:  
+private:
+    friend class Flattener;
+    friend class Optimizer;
+
     runtime::ObjectHolder cls_;
    // runtime::Class cls_;
 };
 
-// Инструкция if <condition> <if_body> else <else_body>
+// Инструкция if <condition> <if_body> else <else_body>. Условие приводится к bool по правилам
+// runtime::IsTrue
 class IfElse : public Statement {
 public:
     // Параметр else_body может быть равен nullptr
-    IfElse(std::unique_ptr<Statement> condition, std::unique_ptr<Statement> if_body,
-           std::unique_ptr<Statement> else_body);
+    IfElse(StatementPtr condition, StatementPtr if_body,
+           StatementPtr else_body);
 
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 private:
-    std::unique_ptr<Statement> condition_; 
-    std::unique_ptr<Statement> if_body_;
-    std::unique_ptr<Statement> else_body_;
+    friend class Flattener;
+    friend class Optimizer;
+
+    StatementPtr condition_; 
+    StatementPtr if_body_;
+    StatementPtr else_body_;
 };
 
-// Операция сравнения
+// Операция сравнения. Каждому оператору соответствует свой класс-наследник. Числа и строки
+// сравниваются на месте, значения других типов - функциями runtime::Equal, runtime::Less и
+// производными от них. Результат - один из двух общих объектов Bool, см. MakeBool
 class Comparison : public BinaryOperation {
 public:
-    // Comparator задаёт функцию, выполняющую сравнение значений аргументов
-    using Comparator = std::function<bool(const runtime::ObjectHolder&,
-                                          const runtime::ObjectHolder&, runtime::Context&)>;
+    using BinaryOperation::BinaryOperation;
 
-    Comparison(Comparator cmp, std::unique_ptr<Statement> lhs, std::unique_ptr<Statement> rhs);
+    // Возвращает общий объект True или False
+    static runtime::ObjectHolder MakeBool(bool value);
+};
+
+// lhs == rhs
+class Equal final : public Comparison {
+public:
+    using Comparison::Comparison;
+
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    bool EvaluateCondition(runtime::Closure& closure, runtime::Context& context) override;
+
+    // Сравнивает уже вычисленные значения аргументов
+    static bool Apply(const runtime::ObjectHolder& lhs, const runtime::ObjectHolder& rhs,
+                      runtime::Context& context);
+};
+
+// lhs != rhs
+class NotEqual final : public Comparison {
+public:
+    using Comparison::Comparison;
 
-    // Вычисляет значение выражений lhs и rhs и возвращает результат работы comparator,
-    // приведённый к типу runtime::Bool
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    bool EvaluateCondition(runtime::Closure& closure, runtime::Context& context) override;
+
+    static bool Apply(const runtime::ObjectHolder& lhs, const runtime::ObjectHolder& rhs,
+                      runtime::Context& context);
+};
+
+// lhs < rhs
+class Less final : public Comparison {
+public:
+    using Comparison::Comparison;
+
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    bool EvaluateCondition(runtime::Closure& closure, runtime::Context& context) override;
+
+    static bool Apply(const runtime::ObjectHolder& lhs, const runtime::ObjectHolder& rhs,
+                      runtime::Context& context);
+};
+
+// lhs > rhs
+class Greater final : public Comparison {
+public:
+    using Comparison::Comparison;
+
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    bool EvaluateCondition(runtime::Closure& closure, runtime::Context& context) override;
+
+    static bool Apply(const runtime::ObjectHolder& lhs, const runtime::ObjectHolder& rhs,
+                      runtime::Context& context);
+};
+
+// lhs <= rhs
+class LessOrEqual final : public Comparison {
+public:
+    using Comparison::Comparison;
+
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    bool EvaluateCondition(runtime::Closure& closure, runtime::Context& context) override;
+
+    static bool Apply(const runtime::ObjectHolder& lhs, const runtime::ObjectHolder& rhs,
+                      runtime::Context& context);
+};
+
+// lhs >= rhs
+class GreaterOrEqual final : public Comparison {
+public:
+    using Comparison::Comparison;
+
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    bool EvaluateCondition(runtime::Closure& closure, runtime::Context& context) override;
+
+    static bool Apply(const runtime::ObjectHolder& lhs, const runtime::ObjectHolder& rhs,
+                      runtime::Context& context);
+};
+
+// Программа: корневая инструкция и арена, в которой созданы все узлы дерева программы
+class Program : public Statement {
+public:
+    [[nodiscard]] Arena& GetArena() {
+        return arena_;
+    }
+
+    [[nodiscard]] const Arena& GetArena() const {
+        return arena_;
+    }
+
+    // Задаёт корневую инструкцию, созданную в арене программы
+    void SetRoot(StatementPtr root) {
+        root_ = std::move(root);
+    }
+
+    // Задаёт классы программы, включая объявленные в телах методов
+    void SetClasses(std::vector<const runtime::Class*> classes) {
+        classes_ = std::move(classes);
+    }
+
+    [[nodiscard]] const std::vector<const runtime::Class*>& GetClasses() const {
+        return classes_;
+    }
+
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override {
+        return root_->Execute(closure, context);
+    }
+
 private:
-    Comparator comparator_;
+    friend class Flattener;
+    friend class Optimizer;
+
+    Arena arena_;
+    StatementPtr root_;
+    // Классами владеют узлы ClassDefinition
+    std::vector<const runtime::Class*> classes_;
 };
 
+// Деструкторы узлов без векторов, строк и объектов не освобождают ничего, кроме потомков,
+// а потомки узлов из арены тоже созданы в ней
+template <> struct IsArenaTrivial<NumericConst> : std::true_type {};
+template <> struct IsArenaTrivial<BoolConst> : std::true_type {};
+template <> struct IsArenaTrivial<None> : std::true_type {};
+template <> struct IsArenaTrivial<Assignment> : std::true_type {};
+template <> struct IsArenaTrivial<Stringify> : std::true_type {};
+template <> struct IsArenaTrivial<Negate> : std::true_type {};
+template <> struct IsArenaTrivial<Add> : std::true_type {};
+template <> struct IsArenaTrivial<Sub> : std::true_type {};
+template <> struct IsArenaTrivial<Mult> : std::true_type {};
+template <> struct IsArenaTrivial<Div> : std::true_type {};
+template <> struct IsArenaTrivial<Or> : std::true_type {};
+template <> struct IsArenaTrivial<And> : std::true_type {};
+template <> struct IsArenaTrivial<Not> : std::true_type {};
+template <> struct IsArenaTrivial<Equal> : std::true_type {};
+template <> struct IsArenaTrivial<NotEqual> : std::true_type {};
+template <> struct IsArenaTrivial<Less> : std::true_type {};
+template <> struct IsArenaTrivial<Greater> : std::true_type {};
+template <> struct IsArenaTrivial<LessOrEqual> : std::true_type {};
+template <> struct IsArenaTrivial<GreaterOrEqual> : std::true_type {};
+template <> struct IsArenaTrivial<MethodBody> : std::true_type {};
+template <> struct IsArenaTrivial<Return> : std::true_type {};
+template <> struct IsArenaTrivial<IfElse> : std::true_type {};
+
 }  // namespace ast
\ No newline at end of file
@@ -453,6 +453,55 @@ void TestNot() {
     test_not(false);
 }
 
+template <typename T>
+bool Compare(StatementPtr lhs, StatementPtr rhs) {
+    Closure closure;
+    runtime::DummyContext context;
+    const ObjectHolder result = T(std::move(lhs), std::move(rhs)).Execute(closure, context);
+    return result.TryAs<runtime::Bool>()->GetValue();
+}
+
+void TestComparisons() {
+    auto number = [](int value) {
+        return make_unique<NumericConst>(value);
+    };
+    auto str = [](const string& value) {
+        return make_unique<StringConst>(value);
+    };
+    ASSERT(Compare<Equal>(number(2), number(2)) && !Compare<Equal>(number(2), number(3)));
+    ASSERT(Compare<NotEqual>(str("a"s), str("b"s)) && !Compare<NotEqual>(str("a"s), str("a"s)));
+    ASSERT(Compare<Less>(number(-1), number(0)) && !Compare<Less>(str("b"s), str("a"s)));
+    ASSERT(Compare<Greater>(str("b"s), str("a"s)) && !Compare<Greater>(number(0), number(0)));
+    ASSERT(Compare<LessOrEqual>(number(0), number(0))
+           && !Compare<LessOrEqual>(number(1), number(0)));
+    ASSERT(Compare<GreaterOrEqual>(str("ab"s), str("a"s))
+           && !Compare<GreaterOrEqual>(str(""s), str("a"s)));
+
+    // Values of other types are compared by the functions of runtime
+    ASSERT(Compare<Less>(make_unique<BoolConst>(false), make_unique<BoolConst>(true)));
+    ASSERT(Compare<Equal>(make_unique<None>(), make_unique<None>()));
+    ASSERT_THROWS(Compare<Equal>(number(1), str("1"s)), runtime_error);
+    ASSERT_THROWS(Compare<Less>(number(1), make_unique<None>()), runtime_error);
+
+    vector<runtime::Method> methods;
+    methods.push_back({"__eq__"s, {"other"s}, make_unique<BoolConst>(true)});
+    methods.push_back({"__lt__"s, {"other"s}, make_unique<BoolConst>(false)});
+    runtime::Class cls("Same"s, std::move(methods), nullptr);
+    auto instance = [&cls] {
+        return make_unique<NewInstance>(cls);
+    };
+    ASSERT(Compare<Equal>(instance(), instance()) && !Compare<NotEqual>(instance(), instance()));
+    ASSERT(!Compare<Less>(instance(), instance()) && !Compare<Greater>(instance(), instance()));
+    ASSERT(Compare<LessOrEqual>(instance(), instance())
+           && Compare<GreaterOrEqual>(instance(), instance()));
+
+    // The results are shared objects rather than new ones
+    Closure closure;
+    runtime::DummyContext context;
+    Less less(number(1), number(2));
+    ASSERT(less.Execute(closure, context).Get() == less.Execute(closure, context).Get());
+}
+
 }  // namespace
 
 void RunUnitTests(TestRunner& tr) {
@@ -476,6 +525,7 @@ void RunUnitTests(TestRunner& tr) {
     RUN_TEST(tr, ast::TestOr);
     RUN_TEST(tr, ast::TestAnd);
     RUN_TEST(tr, ast::TestNot);
+    RUN_TEST(tr, ast::TestComparisons);
 }
 
 }  // namespace ast
\ No newline at end of file
@@ -0,0 +1,102 @@
+#include "symbol.h"
+
+#include <array>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <ostream>
+#include <shared_mutex>
+#include <stdexcept>
+#include <unordered_map>
+
+using namespace std;
+
+namespace runtime {
+
+namespace {
+
+// Таблица символов процесса. Имена только добавляются, поэтому ссылки на них не устаревают
+class SymbolTable {
+public:
+    static SymbolTable& Instance() {
+        static SymbolTable table;
+        return table;
+    }
+
+    // Имена из кеша потока находятся без блокировки таблицы. Кеш не устаревает, потому что
+    // имена из таблицы не удаляются
+    uint32_t Intern(string_view name) {
+        thread_local array<CacheEntry, CACHE_SIZE> cache;
+        CacheEntry& entry = cache[hash<string_view>{}(name) % CACHE_SIZE];
+        if (entry.name != name) {
+            entry = FindOrAdd(name);
+        }
+        return entry.id;
+    }
+
+    const string& Name(uint32_t id) const {
+        shared_lock lock(mutex_);
+        return names_[id];
+    }
+
+private:
+    static constexpr size_t CACHE_SIZE = 1024;
+
+    // Пустое имя в пустой записи кеша совпадает с символом номер 0
+    struct CacheEntry {
+        string_view name;
+        uint32_t id = 0;
+    };
+
+    SymbolTable() {
+        FindOrAdd(""sv);
+    }
+
+    CacheEntry FindOrAdd(string_view name) {
+        {
+            shared_lock lock(mutex_);
+            if (auto it = ids_.find(name); it != ids_.end()) {
+                return {it->first, it->second};
+            }
+        }
+        unique_lock lock(mutex_);
+        if (auto it = ids_.find(name); it != ids_.end()) {
+            return {it->first, it->second};
+        }
+        if (names_.size() == numeric_limits<uint32_t>::max()) {
+            throw length_error("Too many names in the symbol table"s);
+        }
+        const auto id = static_cast<uint32_t>(names_.size());
+        const string& stored = names_.emplace_back(name);
+        ids_.emplace(stored, id);
+        return {stored, id};
+    }
+
+    mutable shared_mutex mutex_;
+    deque<string> names_;  // deque не перемещает элементы при добавлении
+    unordered_map<string_view, uint32_t> ids_;
+};
+
+}  // namespace
+
+Symbol::Symbol(string_view name)
+    : id_(SymbolTable::Instance().Intern(name)) {
+}
+
+Symbol::Symbol(const string& name)
+    : Symbol(string_view(name)) {
+}
+
+Symbol::Symbol(const char* name)
+    : Symbol(string_view(name)) {
+}
+
+const string& Symbol::Name() const {
+    return SymbolTable::Instance().Name(id_);
+}
+
+ostream& operator<<(ostream& os, Symbol symbol) {
+    return os << symbol.Name();
+}
+
+}  // namespace runtime
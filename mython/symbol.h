@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <string_view>
+
+namespace runtime {
+
+// Имя (идентификатор) в программе Mython.
+// Все имена хранятся в общей для процесса таблице символов, а Symbol содержит только 32-битный
+// номер имени в ней. Одинаковые имена получают одинаковые номера, поэтому имена сравниваются и
+// хешируются как целые числа. Таблица потокобезопасна
+class Symbol {
+public:
+    // Пустое имя
+    Symbol() = default;
+
+    // Регистрирует имя в таблице символов (если его там ещё нет)
+    Symbol(std::string_view name);  // NOLINT(google-explicit-constructor,hicpp-explicit-conversions)
+    Symbol(const std::string& name);  // NOLINT(google-explicit-constructor,hicpp-explicit-conversions)
+    Symbol(const char* name);  // NOLINT(google-explicit-constructor,hicpp-explicit-conversions)
+
+    // Возвращает символ с номером id, полученным от Symbol::Id
+    static Symbol FromId(uint32_t id) {
+        Symbol symbol;
+        symbol.id_ = id;
+        return symbol;
+    }
+
+    // Возвращает номер имени в таблице символов
+    [[nodiscard]] uint32_t Id() const {
+        return id_;
+    }
+
+    // Возвращает имя. Ссылка действительна до конца работы программы
+    [[nodiscard]] const std::string& Name() const;
+
+    bool operator==(Symbol rhs) const {
+        return id_ == rhs.id_;
+    }
+
+    bool operator!=(Symbol rhs) const {
+        return id_ != rhs.id_;
+    }
+
+    // Сравнения с обычными строками сравнивают имя, не добавляя строку в таблицу символов
+    bool operator==(std::string_view rhs) const {
+        return Name() == rhs;
+    }
+    bool operator==(const std::string& rhs) const {
+        return Name() == rhs;
+    }
+    bool operator==(const char* rhs) const {
+        return Name() == rhs;
+    }
+
+    template <typename T>
+    bool operator!=(const T& rhs) const {
+        return !(*this == rhs);
+    }
+
+private:
+    uint32_t id_ = 0;  // пустое имя всегда имеет номер 0
+};
+
+std::ostream& operator<<(std::ostream& os, Symbol symbol);
+
+}  // namespace runtime
+
+template <>
+struct std::hash<runtime::Symbol> {
+    size_t operator()(runtime::Symbol symbol) const noexcept {
+        return symbol.Id();
+    }
+};
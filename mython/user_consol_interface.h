@@ -16,11 +16,76 @@ using namespace std::literals;
 		} else if (mode == "-test"s || mode == "-t"s) {
 			local_tests::TestAll();
 			exit(EXIT_SUCCESS);
-		} 
+		} else if (!mode.empty() && mode.front() == '-') {
+			// a lone option has no script to apply to
+			ExitWithUsage(ParseOption(mode) ? "Missing the path of the script after "s + mode
+					: "Unknown option "s + mode);
+		} else {
+			script_path_ = mode;
+		}
+	} else if (argc > 2) {
+		// options go before the path of the script
+		for (int i = 1; i + 1 < argc; ++i) {
+			const std::string mode(argv[i]);
+			if (!ParseOption(mode)) {
+				ExitWithUsage("Unknown option "s + mode);
+			}
+		}
+		script_path_ = argv[argc - 1];
+		if (!script_path_.empty() && script_path_.front() == '-') {
+			ExitWithUsage("Missing the path of the script after "s + script_path_);
+		}
 	}
 }
 
+// Returns the path of the script passed in the command line or an empty string
+const std::string& GetScriptPath() const {
+	return script_path_;
+}
+
+// Returns true if memory statistics should be printed to stderr after the run
+bool PrintStats() const {
+	return print_stats_;
+}
+
+// Returns true if the program should be run over its flat representation
+bool Flat() const {
+	return flat_;
+}
+
+// Returns true if the parsed program may be loaded from and saved to a cache file next to the
+// script
+bool UseCache() const {
+	return use_cache_;
+}
+
 private:
+std::string script_path_;
+bool print_stats_ = false;
+bool flat_ = false;
+bool use_cache_ = true;
+
+// Sets the flag of an option that goes before the path of the script. Returns false if mode
+// is not such an option
+bool ParseOption(const std::string &mode) {
+	using namespace std::literals;
+	if (mode == "-stats"s || mode == "-s"s) {
+		print_stats_ = true;
+	} else if (mode == "-flat"s || mode == "-f"s) {
+		flat_ = true;
+	} else if (mode == "-no-cache"s || mode == "-n"s) {
+		use_cache_ = false;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+[[noreturn]] void ExitWithUsage(const std::string &error) {
+	std::cerr << error << std::endl;
+	PrintHelp();
+	exit(EXIT_FAILURE);
+}
 
 void PrintHelp(std::ostream &stream = std::cerr) {
 	std::string help =
@@ -31,6 +96,21 @@ ways to start mython:
                      after that, the program will output the 
                      response to stdout and terminate
 
+-with a path to a script: the program is read from the file,
+                     the parsed program is cached in a .myc file
+                     next to the script and the cache replaces
+                     parsing while the script does not change
+
+-with options before a path to a script:
+   -stats or -s    : after the run, memory statistics are printed
+                     to stderr
+   -flat or -f     : the program is run over its flat representation
+                     with nodes stored in contiguous arrays
+   -no-cache or -n : the script is parsed without reading or
+                     writing the .myc cache file; bodies of methods
+                     are parsed when they are called for the first
+                     time, as for a program passed to stdin
+
 -with -help or -h
  
 -with -test or -t : run all the tests and return 